@@ -0,0 +1,45 @@
+/**
+ * @file BufferPool.hpp
+ * @brief Header file for the BufferPool class, the receive buffers of an event
+ * loop.
+ */
+
+#ifndef BUFFERPOOL_HPP
+#define BUFFERPOOL_HPP
+
+#include "defines.hpp"
+
+/**
+ * @class BufferPool
+ * @brief Fixed-size receive buffers ('client_header_buffer_size'), handed to
+ * the connections of an event loop while they receive a request.
+ *
+ * A connection takes a buffer when data arrives, and gives it back once the
+ * request is handled and nothing else was received (idle keep-alive
+ * connection): only the connections in the middle of a request hold one.
+ * The buffers given back are kept for the next ones (at most
+ * BUFFER_POOL_KEEP), so the event loop doesn't allocate them again and again.
+ *
+ * Each event loop has its own pool (used by one thread only).
+ */
+class BufferPool
+{
+	private:
+			size_t					_bufferSize;
+			std::vector<char*>		_freeVector; ///< Buffers given back, ready to be handed again.
+			size_t					_nbUsed; ///< Buffers held by the connections.
+
+			BufferPool(BufferPool const &other);
+			BufferPool &operator=(BufferPool const &other);
+
+	public:
+			BufferPool();
+			~BufferPool();
+
+			void					setBufferSize(size_t bufferSize);
+			size_t					getBufferSize() const;
+			char					*acquire();
+			void					release(char *buffer);
+};
+
+#endif
@@ -12,6 +12,11 @@
 #include "defines.hpp"
 #include "Server.hpp"
 #include "utils.hpp"
+#include "OutputQueue.hpp"
+#include "RequestParser.hpp"
+#include "RequestBody.hpp"
+#include "ReceiveBuffer.hpp"
+#include "RequestTarget.hpp"
 
 /**
  * @class Client
@@ -23,25 +28,32 @@
 class Client
 {
 	private:
-		Server		_server; ///< The server associated with the client.
+		const Server	*_server; ///< The server associated with the client (owned by the Service, never copied).
 		int			_socket; ///< The socket descriptor for the client connection.
 		bool		_sentRequest; ///< Indicates whether a request has been sent.
-		time_t		_lastRequest; ///< Timestamp of the last request.
-		std::string	_request; ///< The raw request string from the client.
-		std::string	_resourcePath; ///< Path to the resource (e.g., ../site/page).
+		long		_requestStart; ///< Time (ms, cached clock of the Service) the current request started to arrive.
+		long		_lastActivity; ///< Time (ms, cached clock of the Service) of the last read or write on the connection.
+		ReceiveBuffer	_request; ///< The raw data received from the client: the current request, then the next pipelined ones (no buffer while idle).
+		RequestParser	_parser; ///< Parses the current request as it is received.
+		OutputQueue	_output; ///< Responses waiting to be sent (headers, bodies and files), drained on POLLOUT.
+		requestTarget_t	_target; ///< Decoded path and query of the request, parsed once when the request is routed.
 		std::string	_method; ///< The HTTP method (e.g., GET, POST, DELETE).
-		std::string	_requestPayload; ///< Payload of the request (body for POST)
-		std::map<std::string, std::string>	_headers; ///< HTTP headers of the request.
-		bool		_isChunked; ///< Indicates if the request uses chunked transfer encoding.
+		RequestBody	_body; ///< Body of the request, moved out of _request as it is received (in memory or in a temporary file).
+		const location_t	*_location; ///< Location the request is routed to, once its headers are received (NULL before).
+		const Server	*_defaultServer; ///< The server of the listening socket, used again for each new request.
+		bool		_keepAlive; ///< Indicates if the connection is kept open after the current response.
+		size_t		_nbRequests; ///< Number of requests received on the connection.
+		bool		_closing; ///< The server is shutting down: the next response closes the connection.
 
 			
-		void		handleGetRequest(const std::string& path); ///< Handles GET requests.
-		void		handlePostRequest(const std::string& path); ///< Handles POST requests.
-		void		handleDeleteRequest(const std::string& path); ///< Handles DELETE requests.
+		void		handleGetRequest(); ///< Handles GET requests.
+		void		handlePostRequest(); ///< Handles POST requests.
+		void		handleDeleteRequest(); ///< Handles DELETE requests.
 		std::string generateAutoindexPage(const std::string &directoryPath, const std::string &requestPath); ///< Generates an autoindex page
 		void		handleMultipartFormData(const std::string &path, const std::string &boundary);
 		
 		void		sendResponse(int statusCode, const std::string& statusMessage, const std::string& body); ///< Sends HTTP response
+		void		sendFileResponse(int statusCode, const std::string& statusMessage, int fd, off_t size); ///< Sends HTTP response with a file as body
 		void		sendRedirectResponse(int statusCode, const std::string &location); ///< Sends HTTP redirect response
 		void		sendErrorResponse(int statusCode, const std::string& statusMessage); ///< Sends HTTP error response
 		void		sendCgiResponse(const std::string &cgiOutput); ///< Sends CGI response
@@ -50,33 +62,42 @@ class Client
 		bool		fileExists(const std::string& path); ///< used for DELETE requests
 		void		uploadFile(const std::string &path); ///< Handles file uploads
 		std::string	executeCgi(const std::string &cgiPath, const std::string &method, const std::string &queryString, 
-								const std::string &body, const std::string &pathInfo, const std::string &scriptFileName);
-		bool		isUrlValid(const std::string &url) const; ///< Checks if a URL chars are valid
-		std::string decodeUrl(const std::string &url) const; ///< Decodes percent-encoded URLs (browsers encode invalid chars like '^' to '%5E').
+								const RequestBody &body, const std::string &pathInfo, const std::string &scriptFileName);
+		void		_processRequest();
+		void		_parseRequest();
+		void		_resetRequest();
+		bool		_wantsKeepAlive() const;
+		std::string	_getConnectionHeaders() const;
 		bool		_checkRequest();
-		bool		_checkFirstLine(std::stringstream &ss);
-		bool 		_checkAndGetHeaders(std::stringstream &ss);
-		bool		_checkAndGetPayload(std::stringstream &ss);
-		int			_checkLocation(std::string &root, std::string &resource, size_t loopCount);
-		long		_parseContentLength(const std::string &contentLengthStr) const;
-		bool		parseChunkedPayload(std::stringstream &ss);
-		bool		isChunkComplete() const;
+		bool		_checkRoute();
+		bool		_checkPostTarget();
+		bool		_isUploadType(const std::string &contentType) const;
+		std::string	_getUploadDirectory(const location_t &locationConfig) const;
 
 		Client();
 
 	public:
-		Client(Server server, int socket);
+		Client(const Server &server, int socket, long now, BufferPool &pool);
 		~Client();
 
-		void		appendRequest(char const *buffer, size_t size);
-		bool		isTimeout() const;
+		ssize_t		receiveRequest(Poller &poller, long now);
+		long		getDeadline() const;
 		bool		clientIsReadyToReceive() const;
+		bool		isWaitingForRoute() const;
+		void		routeRequest();
 		void		handleClientRequest();
+		bool		isKeepAlive() const;
+		bool		isIdle() const;
+		void		closeAfterResponse();
+		bool		hasPendingResponse() const;
+		bool		isOutputFull() const;
+		void		sendPendingResponse(long now);
 
 		//getters and setters
-		const std::string& 	getRequest() const;
+		const ReceiveBuffer&	getRequest() const;
+		std::string			getHeader(header_e id) const;
 		const Server& 		getServer() const;
-		void 				changeServer(Server server);
+		void 				changeServer(const Server &server);
 };
 
 #endif
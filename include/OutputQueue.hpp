@@ -0,0 +1,56 @@
+/**
+ * @file OutputQueue.hpp
+ * @brief Header file for the OutputQueue class, the data waiting to be sent
+ * on a client's connection.
+ */
+
+#ifndef OUTPUTQUEUE_HPP
+#define OUTPUTQUEUE_HPP
+
+#include "defines.hpp"
+
+/**
+ * @struct outputSegment_s
+ * @brief A part of a response: bytes in memory (headers, generated pages) or
+ * a range of an open file (fd >= 0), read only when the socket can take it.
+ */
+typedef struct outputSegment_s {
+	std::string		data; ///< Bytes to send (memory segment only).
+	int				fd; ///< File to send (-1 for a memory segment), closed once sent.
+	off_t			offset; ///< Position of the next byte to send (in data or in the file).
+	off_t			end; ///< Position after the last byte to send.
+} outputSegment_t;
+
+/**
+ * @class OutputQueue
+ * @brief Per-connection queue of the responses to send, drained when the
+ * socket is writable.
+ *
+ * A short write only moves the position in the first segment, the rest is
+ * sent at the next call. A file is never loaded in memory: at most
+ * OUTPUT_CHUNK_SIZE bytes of it are sent per system call.
+ */
+class OutputQueue
+{
+	private:
+			std::list<outputSegment_t>	_segmentList; ///< A list: an empty queue (idle connection) holds no memory.
+			off_t					_size; ///< Bytes still to send (memory and files).
+
+			ssize_t					_sendSegment(int socket, outputSegment_t &segment, bool hasMore);
+			void					_popSegment();
+
+			OutputQueue(OutputQueue const &other);
+			OutputQueue &operator=(OutputQueue const &other);
+
+	public:
+			OutputQueue();
+			~OutputQueue();
+
+			void					append(std::string const &data);
+			void					appendFile(int fd, off_t size);
+			bool					empty() const;
+			off_t					getSize() const;
+			ssize_t					drain(int socket);
+};
+
+#endif
@@ -42,6 +42,22 @@ struct Token
 	std::string value;
 };
 
+/**
+ * @struct globalConfig_s
+ * @brief Holds the directives written outside of any server block.
+ *
+ * These directives don't belong to a Server, they configure the whole Service.
+ */
+typedef struct globalConfig_s {
+	std::string		eventBackend; ///< Readiness backend: "auto", "poll" or "epoll".
+	size_t			workerThreads; ///< Number of event loops (threads), 1 means no worker mode.
+	size_t			workerProcesses; ///< Number of worker processes forked by the master, 0 means no master process.
+	size_t			maxConnections; ///< Maximum number of client connections of each event loop, 0 means no limit.
+	std::string		overloadAction; ///< What is done with a new connection over a limit: "stop" or "503".
+	size_t			shutdownTimeout; ///< Seconds to finish the requests in progress after SIGTERM or SIGQUIT.
+	size_t			headerBufferSize; ///< Bytes of the receive buffer of each connection (the pool's buffers).
+} globalConfig_t;
+
 typedef std::vector<Server> serverVector;
 class Server;
 
@@ -85,6 +101,8 @@ class Parser{
 			void	_checkMaxSize(std::string& dirValue);
 			void	_checkServerN(std::string& dirValue);
 			void	_checkErrorP(std::string& dirValue);
+			void	_checkRange(std::string const& dirName, std::string& dirValue, long min, long max);
+			void	_checkOnOff(std::string const& dirName, std::string& dirValue);
 
 			//Directives' Location checking functions:
 			void	_checkLocation(std::string& dirValue);
@@ -97,6 +115,14 @@ class Parser{
 			void 	_checkCgiP(std::string& dirValue, std::map<std::string, std::string>& locationConfigMap);
 			void	_checkCgiE(std::string& dirValue);
 
+			//Global directives checking functions:
+			void	_getGlobalParam();
+			void	_checkGlobalParam();
+			void	_checkEventBackend(std::string& dirValue);
+			void	_checkWorkers(std::string& dirValue);
+			void	_checkOverload(std::string& dirValue);
+			size_t	_getNbWorkers(std::string const& dirValue);
+
 			size_t												_nServer; ///< Number of servers parsed.
 			size_t												_nbLine; ///< Current line number in the configuration file.
 			std::string											_confFilePath; ///< Path to the configuration file.
@@ -109,11 +135,13 @@ class Parser{
 			std::vector<location_t>								_tempLocationVector; ///< Vector of temporary locations.
 			location_t											_tempLocation; ///< Temporary location structure.
 			std::string											_tempRootDirPath; ///< Temporary root directory path.
+			std::map<std::string, std::string>					_globalConfigMap; ///< Directives written outside of the server blocks.
 			
 	public:
 			Parser(int argc, char **argv);
 			~Parser();
 			std::vector<Server>& getServersVector();
+			globalConfig_t	getGlobalConfig();
 			std::set<std::string> getSupportedExtensions();
 };
 #endif
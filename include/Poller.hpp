@@ -0,0 +1,215 @@
+/**
+ * @file Poller.hpp
+ * @brief Header file for the Poller interface and its readiness backends.
+ *
+ * A Poller hides the system call used to survey the sockets (poll(), epoll or
+ * io_uring) from the Service. The Service registers the sockets it wants to
+ * survey and the Poller only hands back the sockets that reported an event.
+ * The Service accepts the connections and receives their data through the
+ * Poller too: a completion-based backend (io_uring) does it in the kernel
+ * beforehand, the others call accept() and recv().
+ */
+
+#ifndef POLLER_HPP
+#define POLLER_HPP
+
+#include "defines.hpp"
+
+/**
+ * @class Poller
+ * @brief Readiness backend used by the Service event loop.
+ *
+ * Events are always expressed with the poll() flags (POLLIN, POLLOUT, POLLERR,
+ * POLLHUP, POLLNVAL), whatever the backend, so the Service does not depend on
+ * the system call behind it.
+ */
+class Poller
+{
+	protected:
+			std::vector<pollfd>		_readyVector; ///< Sockets which reported an event during the last wait().
+
+	public:
+			virtual ~Poller();
+
+			virtual void			addFd(int fd, short events) = 0; ///< Starts surveying a socket.
+			virtual void			addListener(int fd); ///< Starts surveying a listening socket (POLLIN).
+			virtual void			addConnection(int fd, short events); ///< Starts surveying a client's connection.
+			virtual int				accept(int fd, sockaddr_in &address); ///< Takes a connection of a listening socket reported with POLLIN.
+			virtual ssize_t			receive(int fd, char *buffer, size_t size); ///< Takes the bytes received on a connection reported with POLLIN.
+			virtual void			modifyFd(int fd, short events) = 0; ///< Changes the events surveyed for a socket.
+			virtual void			removeFd(int fd) = 0; ///< Stops surveying a socket (call it before close()).
+			virtual int				wait(int timeout) = 0; ///< Waits for events, fills the ready vector and returns its size.
+			virtual std::string		getName() const = 0;
+
+			const std::vector<pollfd>&	getReadyVector() const;
+
+			static Poller*			create(std::string const &backend);
+};
+
+/**
+ * @class PollPoller
+ * @brief Portable backend based on poll().
+ *
+ * poll() still scans the whole list of registered sockets, it is kept as the
+ * fallback when epoll is not available (or not wanted).
+ */
+class PollPoller : public Poller
+{
+	private:
+			std::vector<pollfd>		_pollingFdVector; ///< Registered sockets, given as is to poll().
+			std::vector<int>		_indexByFd; ///< Position of each fd in _pollingFdVector (-1 if not registered).
+
+	public:
+			PollPoller();
+			~PollPoller();
+
+			void					addFd(int fd, short events);
+			void					modifyFd(int fd, short events);
+			void					removeFd(int fd);
+			int						wait(int timeout);
+			std::string				getName() const;
+};
+
+#ifdef __linux__
+/**
+ * @class EpollPoller
+ * @brief Linux backend based on epoll (level-triggered).
+ *
+ * The kernel keeps the list of registered sockets, so the cost of a wait()
+ * only depends on the number of sockets which are ready.
+ */
+class EpollPoller : public Poller
+{
+	private:
+			int							_epollFd;
+			std::vector<epoll_event>	_eventVector; ///< Buffer filled by epoll_wait().
+
+			static uint32_t			_toEpollEvents(short events);
+			static short			_toPollEvents(uint32_t events);
+
+	public:
+			EpollPoller();
+			~EpollPoller();
+
+			void					addFd(int fd, short events);
+			void					modifyFd(int fd, short events);
+			void					removeFd(int fd);
+			int						wait(int timeout);
+			std::string				getName() const;
+};
+#endif
+
+#ifdef HAS_IO_URING
+/**
+ * @class UringPoller
+ * @brief Linux backend based on io_uring (raw system calls, no library).
+ *
+ * Where the kernel has them (Linux >= 6.0), the backend does the I/O itself
+ * instead of reporting readiness: each listening socket has a multishot
+ * accept request, which accepts the connections as they arrive, and each
+ * connection has a multishot recv request, which receives into a ring of
+ * buffers shared with the kernel. The Service takes them with accept() and
+ * receive(): no accept4() or recv() call, and no wait for a socket to become
+ * readable first.
+ *
+ * The other sockets (the wake-up pipes, the sending side of the connections,
+ * and every socket on an older kernel) have one-shot poll requests, re-armed
+ * at the next wait(): the kernel checks the socket when a request is armed,
+ * so a socket still ready is reported again (level-triggered, like poll() and
+ * epoll). A socket whose accepted connections or received bytes were not all
+ * taken is reported again too. Every request queued during a loop iteration
+ * is submitted with the wait itself: a single io_uring_enter().
+ *
+ * Sending is out of scope: the responses (and the files they read) still go
+ * out with send() and sendfile() from the output queue once a poll request
+ * reports POLLOUT, no send or read request is submitted.
+ */
+class UringPoller : public Poller
+{
+	private:
+			enum mode_e { MODE_POLL, MODE_LISTENER, MODE_CONNECTION };
+			enum stream_e { STREAM_IDLE, STREAM_ARMED, STREAM_CANCELLING };
+
+			int						_ringFd;
+			void					*_sqRing; ///< Submission ring (shared with the kernel).
+			size_t					_sqRingSize;
+			void					*_cqRing; ///< Completion ring (the same mapping as _sqRing on recent kernels).
+			size_t					_cqRingSize;
+			io_uring_sqe			*_sqes; ///< Submission entries.
+			size_t					_sqesSize;
+			unsigned				*_sqHead;
+			unsigned				*_sqTail;
+			unsigned				_sqMask;
+			unsigned				*_sqArray;
+			unsigned				_sqEntries;
+			unsigned				_sqLocalTail; ///< Tail including the entries not yet published to the kernel.
+			unsigned				*_cqHead;
+			unsigned				*_cqTail;
+			unsigned				_cqMask;
+			io_uring_cqe			*_cqes;
+			bool					_hasMultishotAccept;
+			bool					_hasMultishotRecv; ///< The buffer ring is registered, and the kernel has multishot recv.
+			void					*_bufferRing; ///< Ring of free receive buffers (io_uring_buf entries, shared with the kernel).
+			unsigned short			_bufferTail; ///< Tail of the buffer ring: the buffers given back are added here.
+			std::vector<char>		_bufferVector; ///< Memory of the receive buffers.
+			std::vector<int>		_nextBuffer; ///< Next buffer received on the same connection (-1 for the last one).
+			std::vector<unsigned>	_bufferLength; ///< Bytes received in each buffer.
+			std::vector<unsigned>	_bufferOffset; ///< Bytes of each buffer already taken by the Service.
+			size_t					_nbFreeBuffers;
+			std::vector<short>		_eventsByFd; ///< Events surveyed for each fd (0 if not surveyed).
+			std::vector<char>		_modeByFd; ///< How each fd is surveyed (mode_e).
+			std::vector<bool>		_armedByFd; ///< A poll request is in flight for the fd.
+			std::vector<unsigned>	_generationByFd; ///< Incremented when the poll request of an fd is replaced: its older completions are ignored.
+			std::vector<char>		_streamByFd; ///< State of the multishot accept or recv request of each fd (stream_e).
+			std::vector<unsigned>	_streamGenerationByFd; ///< Incremented when an fd is removed: the completions for its previous socket are dropped.
+			std::vector<short>		_reventsByFd; ///< Events reported by the poll requests, not handed to the Service yet.
+			std::vector<bool>		_isListedByFd; ///< The fd is in _reportVector.
+			std::vector<int>		_firstBufferByFd; ///< Oldest buffer received on each connection (-1 if none).
+			std::vector<int>		_lastBufferByFd;
+			std::vector<int>		_nbBuffersByFd;
+			std::vector<int>		_recvEndByFd; ///< End of the bytes of each connection: 0 (not yet), URING_EOF or -errno.
+			std::map<int, std::deque<int> >	_acceptedByFd; ///< Connections accepted by each listening socket (-errno for a failure), not taken yet.
+			std::vector<int>		_rearmVector; ///< Sockets whose requests must be checked at the next wait().
+			std::vector<int>		_reportVector; ///< Sockets which may be ready, checked at the end of the wait().
+			std::vector<int>		_starvedVector; ///< Connections whose recv stopped for lack of free buffers.
+
+			void					_unmapRings();
+			void					_setupBufferRing();
+			void					_provideBuffer(int bufferID);
+			io_uring_sqe			*_getSqe();
+			void					_queuePoll(int fd);
+			void					_queueRemove(int fd);
+			void					_queueStream(int fd);
+			void					_queueCancel(int fd);
+			void					_arm(int fd);
+			int						_enter(unsigned minComplete, int timeout);
+			void					_submit();
+			unsigned				_reapCompletions();
+			void					_reapPoll(int fd, unsigned generation, int result);
+			void					_reapStream(int fd, unsigned kind, unsigned generation, int result, unsigned flags);
+			void					_listReport(int fd);
+			bool					_hasInput(int fd) const;
+			short					_pollEvents(int fd) const;
+			void					_dropInput(int fd);
+			void					_growFdTables(int fd);
+
+			UringPoller(UringPoller const &other);
+			UringPoller &operator=(UringPoller const &other);
+
+	public:
+			UringPoller();
+			~UringPoller();
+
+			void					addFd(int fd, short events);
+			void					addListener(int fd);
+			void					addConnection(int fd, short events);
+			void					modifyFd(int fd, short events);
+			void					removeFd(int fd);
+			int						accept(int fd, sockaddr_in &address);
+			ssize_t					receive(int fd, char *buffer, size_t size);
+			int						wait(int timeout);
+			std::string				getName() const;
+};
+#endif
+
+#endif
@@ -0,0 +1,53 @@
+/**
+ * @file ReceiveBuffer.hpp
+ * @brief Header file for the ReceiveBuffer class, the bytes received on a
+ * client's connection and not handled yet.
+ */
+
+#ifndef RECEIVEBUFFER_HPP
+#define RECEIVEBUFFER_HPP
+
+#include "defines.hpp"
+#include "BufferPool.hpp"
+#include "Poller.hpp"
+
+/**
+ * @class ReceiveBuffer
+ * @brief The receive buffer of a connection: a buffer of the event loop's
+ * pool, which recv() writes to directly (or the io_uring backend copies the
+ * bytes it received to).
+ *
+ * It holds the current request (its headers, the part of the body not parsed
+ * yet) and the next pipelined requests: the body is moved out as it is parsed
+ * (see RequestParser), so the headers of a request must fit in it.
+ *
+ * The buffer is only taken from the pool when data arrives, and given back as
+ * soon as the buffer is empty again (`clear()`, or `erase()` of its last
+ * bytes): an idle connection holds no buffer.
+ */
+class ReceiveBuffer
+{
+	private:
+			BufferPool				*_pool;
+			char					*_data; ///< Buffer of the pool (NULL while nothing is received).
+			size_t					_size; ///< Bytes received and not handled yet.
+
+			ReceiveBuffer(ReceiveBuffer const &other);
+			ReceiveBuffer &operator=(ReceiveBuffer const &other);
+
+	public:
+			ReceiveBuffer(BufferPool &pool);
+			~ReceiveBuffer();
+
+			ssize_t					receive(Poller &poller, int socket);
+			const char				*data() const;
+			size_t					size() const;
+			bool					empty() const;
+			bool					isFull() const;
+			char					operator[](size_t pos) const;
+			std::string				substr(size_t pos, size_t length) const;
+			void					erase(size_t pos, size_t length);
+			void					clear();
+};
+
+#endif
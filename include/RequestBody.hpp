@@ -0,0 +1,57 @@
+/**
+ * @file RequestBody.hpp
+ * @brief Header file for the RequestBody class, the body of the request being
+ * received on a client's connection.
+ */
+
+#ifndef REQUESTBODY_HPP
+#define REQUESTBODY_HPP
+
+#include "defines.hpp"
+
+/**
+ * @class RequestBody
+ * @brief Stores the body of a request as it is received: in memory while it
+ * is small, in a temporary file once it is larger than the server's
+ * 'client_body_buffer_size'.
+ *
+ * The bytes are moved here from the receive buffer as soon as they are
+ * parsed, so a connection holds at most 'client_body_buffer_size' bytes of
+ * body in memory, whatever the size of the upload. The temporary file is
+ * removed from the directory at once: it is only reachable through its fd,
+ * and disappears when it is closed (or if the server stops).
+ *
+ * The handlers read the body with `data()` (the file is mapped in memory, not
+ * read), or copy it with `writeTo()`. A CGI script reads the file as its
+ * standard input.
+ */
+class RequestBody
+{
+	private:
+			std::string				_data; ///< The body, while it is in memory.
+			int						_fd; ///< The temporary file (-1 while the body is in memory).
+			size_t					_size;
+			size_t					_bufferSize; ///< Bytes kept in memory at most ('client_body_buffer_size').
+			mutable void			*_map; ///< The file mapped by data() (NULL if not mapped).
+
+			bool					_spill();
+			static bool				_writeAll(int fd, const char *data, size_t size);
+			void					_unmap() const;
+
+			RequestBody(RequestBody const &other);
+			RequestBody &operator=(RequestBody const &other);
+
+	public:
+			RequestBody();
+			~RequestBody();
+
+			void					reset(size_t bufferSize);
+			bool					append(const char *data, size_t size);
+			size_t					size() const;
+			bool					isInFile() const;
+			int						getFd() const;
+			const char				*data() const;
+			bool					writeTo(int fd) const;
+};
+
+#endif
@@ -0,0 +1,148 @@
+/**
+ * @file RequestParser.hpp
+ * @brief Header file for the RequestParser class, the incremental parser of
+ * the HTTP requests received on a connection.
+ */
+
+#ifndef REQUESTPARSER_HPP
+#define REQUESTPARSER_HPP
+
+#include "defines.hpp"
+#include "RequestBody.hpp"
+#include "ReceiveBuffer.hpp"
+
+/**
+ * @enum header_e
+ * @brief The headers the server looks at, identified when they are parsed: no
+ * name comparison is needed to find them afterwards.
+ */
+enum header_e {
+	HEADER_HOST,
+	HEADER_CONTENT_LENGTH,
+	HEADER_TRANSFER_ENCODING,
+	HEADER_CONTENT_TYPE,
+	HEADER_CONNECTION,
+	HEADER_EXPECT,
+	HEADER_IF_NONE_MATCH,
+	HEADER_RANGE,
+	HEADER_ACCEPT_ENCODING,
+	HEADER_COUNT,
+	HEADER_OTHER = HEADER_COUNT
+};
+
+/**
+ * @struct headerField_s
+ * @brief A header of the request, as positions in the receive buffer (the
+ * name and the value are never copied).
+ */
+typedef struct headerField_s {
+	size_t		name; ///< Position of the name in the buffer.
+	size_t		nameLength;
+	size_t		value; ///< Position of the value (without the spaces around it).
+	size_t		valueLength;
+} headerField_t;
+
+/**
+ * @class RequestParser
+ * @brief State machine parsing a request (request line, headers, body) as its
+ * bytes are received.
+ *
+ * The parser works on the receive buffer of the Client and only remembers
+ * positions in it: each call resumes where the previous one stopped, so every
+ * byte is examined once, whatever the number of recv() the request takes.
+ * It stops at the end of the request, the bytes after it (the next pipelined
+ * requests) are left in the buffer.
+ *
+ * The parser stops at the end of the headers (PARSE_ROUTING): the Client
+ * routes the request with them, and either rejects it at once or lets the
+ * parser go on with the body, with the body size limit of the server the
+ * request is routed to. So a request is refused before its body is sent.
+ *
+ * The body is handed to a RequestBody as it is parsed: the data of each chunk
+ * of a chunked body goes there directly (the framing is never copied), then
+ * the parsed bytes are removed from the buffer. So the buffer only holds the
+ * headers and the bytes of the last recv() which are not parsed yet, and the
+ * body size is checked against 'client_max_body_size' as it grows.
+ *
+ * The headers stay in the buffer, until the next request: the parser keeps
+ * their positions, and the index of the known ones (see header_e) by ID. The
+ * other ones are found by a case-insensitive scan of the fields. The vector of
+ * fields keeps its capacity from one request to the next, so parsing the
+ * headers doesn't allocate memory.
+ */
+class RequestParser
+{
+	public:
+		enum state_e {
+			PARSE_REQUEST_LINE,
+			PARSE_HEADERS,
+			PARSE_ROUTING, ///< Headers complete: waits for `resume()` (or `reject()`) before reading the body.
+			PARSE_BODY, ///< Content-Length body.
+			PARSE_CHUNK_SIZE,
+			PARSE_CHUNK_DATA,
+			PARSE_CHUNK_END, ///< CRLF after the data of a chunk.
+			PARSE_TRAILERS,
+			PARSE_COMPLETE,
+			PARSE_ERROR
+		};
+
+	private:
+		state_e		_state;
+		state_e		_bodyState; ///< State `resume()` goes to: how the body is read (PARSE_COMPLETE if there is none).
+		size_t		_pos; ///< Position of the next byte to parse in the buffer.
+		size_t		_scanPos; ///< Position the search for the end of the current line resumes from.
+		size_t		_bodyStart; ///< End of the headers in the buffer (0 until they are all received).
+		size_t		_bodySize; ///< Bytes of the (decoded) body received so far.
+		size_t		_maxBodySize; ///< 'client_max_body_size' of the server the request is routed to.
+		size_t		_remaining; ///< Bytes left in the body, or in the current chunk.
+		bool		_isChunked;
+		bool		_hasContentLength;
+		std::string	_method;
+		std::string	_target;
+		std::vector<headerField_t>	_fieldVector; ///< The headers, in the order received.
+		int			_knownFields[HEADER_COUNT]; ///< Index of each known header in _fieldVector (-1 if absent; the last one if repeated).
+		int			_errorStatus;
+		std::string	_errorMessage;
+
+		bool		_findLine(ReceiveBuffer const &buffer, size_t &lineEnd);
+		void		_parseRequestLine(ReceiveBuffer const &buffer, size_t begin, size_t end);
+		void		_parseHeader(ReceiveBuffer const &buffer, size_t begin, size_t end);
+		void		_parseBuffer(ReceiveBuffer &buffer, RequestBody &body);
+		void		_dropBody(ReceiveBuffer &buffer);
+		void		_endHeaders();
+		void		_setFraming(ReceiveBuffer const &buffer, header_e id, headerField_t const &field);
+		int			_findField(ReceiveBuffer const &buffer, std::string const &name) const;
+		static header_e	_identify(const char *name, size_t length);
+		static bool	_equalsIgnoreCase(const char *s1, const char *s2, size_t length);
+		void		_parseChunkSize(ReceiveBuffer const &buffer, size_t begin, size_t end);
+		void		_fail(int status, std::string const &message);
+
+	public:
+		RequestParser();
+		~RequestParser();
+
+		void		reset();
+		void		release();
+		state_e		parse(ReceiveBuffer &buffer, RequestBody &body);
+		void		resume(size_t maxBodySize);
+		void		reject(int status, std::string const &message);
+
+		bool		isDone() const;
+		bool		hasHeaders() const;
+		bool		isWaitingForRoute() const;
+		bool		expectsBody() const;
+		bool		hasError() const;
+		size_t		getLength() const;
+		size_t		getBodySize() const;
+		int			getErrorStatus() const;
+		const std::string	&getErrorMessage() const;
+		const std::string	&getMethod() const;
+		const std::string	&getTarget() const;
+		bool		hasHeader(header_e id) const;
+		std::string	getHeader(ReceiveBuffer const &buffer, header_e id) const;
+		std::string	getHeader(ReceiveBuffer const &buffer, std::string const &name) const;
+		bool		headerEquals(ReceiveBuffer const &buffer, header_e id, const char *value) const;
+		bool		headerHasToken(ReceiveBuffer const &buffer, header_e id, const char *token) const;
+};
+
+#endif
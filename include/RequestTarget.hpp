@@ -0,0 +1,34 @@
+/**
+ * @file RequestTarget.hpp
+ * @brief Header file for the parser of the request target (the URL of the
+ * request line).
+ */
+
+#ifndef REQUESTTARGET_HPP
+#define REQUESTTARGET_HPP
+
+#include "defines.hpp"
+
+/**
+ * @enum targetStatus_e
+ * @brief Result of the parsing of a request target.
+ */
+enum targetStatus_e {
+	TARGET_OK,
+	TARGET_INVALID_CHARACTER, ///< A byte which can't be in a URL, or a target which doesn't start with '/'.
+	TARGET_INVALID_ENCODING, ///< A '%' not followed by two hex digits, or encoding a control character.
+	TARGET_OUTSIDE_ROOT ///< A ".." segment going above the root.
+};
+
+/**
+ * @struct requestTarget_s
+ * @brief The target of the request, split once and used by every handler.
+ */
+typedef struct requestTarget_s {
+	std::string		path; ///< Percent-decoded, without "." and ".." segments, starts with '/'.
+	std::string		query; ///< As received (still encoded, for the CGI scripts), without the '?'.
+} requestTarget_t;
+
+targetStatus_e	parseRequestTarget(std::string const &raw, requestTarget_t &target);
+
+#endif
@@ -0,0 +1,32 @@
+/**
+ * @file Scanner.hpp
+ * @brief Header file for the delimiter scans of the request parser, with their
+ * scalar and vectorized (SSE2, AVX2) implementations.
+ */
+
+#ifndef SCANNER_HPP
+#define SCANNER_HPP
+
+#include "defines.hpp"
+
+/**
+ * @struct scanner_s
+ * @brief An implementation of the scans. Each scan returns the position of
+ * the first byte it stops on, or `size` if there is none.
+ *
+ * Every implementation gives the same results as the scalar one, they only
+ * differ by the number of bytes examined per instruction.
+ */
+typedef struct scanner_s {
+	const char	*name;
+	size_t		(*findByte)(const char *data, size_t size, char c); ///< First byte equal to c (a line end, a colon...).
+	size_t		(*skipToken)(const char *data, size_t size); ///< First byte which is not a token character (RFC 9110, 5.6.2).
+	size_t		(*skipFieldValue)(const char *data, size_t size); ///< First control character other than HTAB (invalid in a header value).
+} scanner_t;
+
+const scanner_t	&getScanner();
+const scanner_t	&getScalarScanner();
+const scanner_t	*getSse2Scanner();
+const scanner_t	*getAvx2Scanner();
+
+#endif
@@ -33,6 +33,38 @@ typedef struct location_s {
 	std::string					      uploadTo; 
 } location_t;
 
+/**
+ * @struct tcpOptions_s
+ * @brief Socket options of the listening socket of a server, inherited by the sockets it accepts.
+ *
+ * A value of 0 keeps the system's default (or disables the feature).
+ */
+typedef struct tcpOptions_s {
+	bool		noDelay; ///< TCP_NODELAY: small writes are sent at once (no Nagle's algorithm).
+	size_t		deferAccept; ///< TCP_DEFER_ACCEPT: seconds a connection waits for its first data before being accepted.
+	size_t		fastOpen; ///< TCP_FASTOPEN: pending Fast Open requests (data in the SYN).
+	size_t		rcvBuf; ///< SO_RCVBUF: receive buffer (bytes).
+	size_t		sndBuf; ///< SO_SNDBUF: send buffer (bytes).
+	size_t		notSentLowat; ///< TCP_NOTSENT_LOWAT: unsent bytes in the send buffer before the socket is writable.
+	size_t		keepIdle; ///< TCP_KEEPIDLE: idle seconds before the first keepalive probe (0: no probes).
+	size_t		keepIntvl; ///< TCP_KEEPINTVL: seconds between two keepalive probes.
+	size_t		keepCnt; ///< TCP_KEEPCNT: unanswered probes before the connection is dropped.
+} tcpOptions_t;
+
+/**
+ * @struct locationNode_s
+ * @brief A node of the location trie of a server: one segment of the name of
+ * a location ("/cgi/bin" is the "cgi" node, then its "bin" child).
+ *
+ * A location holds the trie node at the end of its name; the nodes in between
+ * have no location. "/" is the "" child of the root, "/upload/" the ""
+ * child of "upload".
+ */
+typedef struct locationNode_s {
+	std::map<std::string, size_t>	childMap; ///< Index of the child node of each segment.
+	bool							hasLocation;
+	location_t						location;
+} locationNode_t;
 
 /**
  * @class Server
@@ -49,17 +81,29 @@ class Server{
 			std::string 						      _root;
 			std::string 						      _index;
 			long								          _clientMaxBodySize;
+			size_t								_clientBodyBufferSize; ///< Bytes of a request's body kept in memory, the rest goes to a temporary file.
+			size_t								_keepaliveTimeout; ///< Seconds an idle keep-alive connection is kept open (0: no keep-alive).
+			size_t								_keepaliveRequests; ///< Maximum number of requests served on one connection.
+			size_t								_headerTimeout; ///< Seconds to receive the headers of a request.
+			size_t								_bodyTimeout; ///< Seconds between two reads of a request's body.
+			size_t								_sendTimeout; ///< Seconds between two writes of a response.
+			size_t								_listenBacklog; ///< Maximum number of pending connections of its listening socket.
+			tcpOptions_t						_tcpOptions;
+			size_t								_maxConnections; ///< Maximum number of connections to its listening socket (0: no limit).
+			size_t								_maxConnectionsPerIp; ///< Maximum number of connections of a client's address (0: no limit).
 			std::string 						      _errorResponse;
 			std::vector<location_t>				_tempLocationVector;
 			bool								          _isPrimary;
-			int									          _socket;
       std::map<std::string, std::string>	_errorPages;
 
       bool								_checkPrimaryServer(std::vector<Server>& _serversVector);
 			long 								_getConvertedMaxSize(std::string& maxSizeStr);
+			size_t								_getNumberParam(std::string const& dirName, size_t defaultValue);
+			void								_fillTcpOptions();
 			void								_fillServerNameVector(std::string& serverNames);
 			void								_fillErrorPageMap();
 	    location_t          _getDefaultLocation() const;
+			location_t							_defaultLocation; ///< Location of the paths matching no location block.
 			// std::vector<Server>								_serversVector;
 			std::map<std::string, std::string>					_ServerConfigMap;
 
@@ -68,25 +112,37 @@ class Server{
 			std::vector<std::map<std::string, std::string> >	_LocationMapVector; //for parsing
 			std::map<std::string, location_t>					_LocationMap; //to use
 			void												_getLocationStruct();
+			std::vector<locationNode_t>							_locationTrie; ///< `_LocationMap` by path segment, for the lookups (the root is node 0).
+			void												_buildLocationTrie();
+			size_t												_findPartialChild(size_t node, std::string segment) const;
 
 	public:
 			Server(std::vector<Server>&	_serversVector, std::map<std::string, std::string> tempServerConfigMap, std::vector<std::map<std::string, std::string> > tempLocationMapVector);
 			~Server();
-			void	createSocket();
 
 			//getters
-			bool							getIsPrimary();
+			bool							getIsPrimary() const;
 			const std::string& 				getHost() const;
 			const std::string& 				getPort() const;
-			int								getSocket() const;
-			std::vector<std::string>		getServerNameVector() const;
+			const std::vector<std::string>&	getServerNameVector() const;
 			const std::string&				getRoot() const;
 			const std::string&				getIndex() const;
 			std::map<std::string, std::string>				getErrorPage() const;
 			const std::string&				getErrorResponse() const;
 			size_t							getClientMaxBodySize() const;
+			size_t							getClientBodyBufferSize() const;
+			size_t							getKeepaliveTimeout() const;
+			size_t							getKeepaliveRequests() const;
+			size_t							getHeaderTimeout() const;
+			size_t							getBodyTimeout() const;
+			size_t							getSendTimeout() const;
+			size_t							getListenBacklog() const;
+			const tcpOptions_t&				getTcpOptions() const;
+			size_t							getMaxConnections() const;
+			size_t							getMaxConnectionsPerIp() const;
 			const std::map<std::string, location_t>& getLocations() const;  // Jannetta's function
-			location_t getLocationConfig(const std::string &path) const; // Jannetta's function
+			const location_t& getLocationConfig(const std::string &path) const; // Jannetta's function
+			const location_t*				findLocation(const std::string &path, bool wholeSegments) const;
 			
 			//utils
 			void 							printServers();
@@ -12,6 +12,9 @@
 #include "defines.hpp"
 #include "Parser.hpp"
 #include "Client.hpp"
+#include "Poller.hpp"
+#include "TimerWheel.hpp"
+#include "BufferPool.hpp"
 
 
 /**
@@ -28,15 +31,45 @@ struct serviceInfo
 	std::string	host;
 	std::string	port;
 	int			listeningSocketFd; //to listen - for server
-	int			clientID; 
+	int			clientID; //slot of the client in the client table (= its socket fd)
 	int			serverID;
 	int			connectionSocketFd; //to connect - for client
-	int			pollID;
 	short		mode;
 	bool		launch;
 };
 
 
+/**
+ * @struct listener_s
+ * @brief A listening socket created during the setup.
+ *
+ * In worker mode, each worker (event loop) gets its own listening socket for
+ * each primary server, all bound to the same address with SO_REUSEPORT.
+ */
+typedef struct listener_s {
+	int			fd;
+	int			serverID; ///< Index of its (primary) server in the servers vector.
+	size_t		workerID; ///< Index of the event loop surveying it.
+	std::string	host; ///< Address it is bound to, to keep it open across a configuration reload.
+	std::string	port;
+} listener_t;
+
+/**
+ * @struct configGeneration_s
+ * @brief A configuration loaded by a reload (SIGHUP), parsed and checked
+ * once, then adopted by each event loop.
+ *
+ * It is shared read-only by the worker threads: the one which published it
+ * and each event loop which uses it (for its new connections, or for the ones
+ * it accepted with it) hold a reference, the last one released deletes it.
+ */
+typedef struct configGeneration_s {
+	std::vector<Server>		servers;
+	globalConfig_t			globalConfig;
+	std::vector<listener_t>	listenerVector; ///< Listening sockets of every event loop, kept ones and new ones.
+	int						nbReferences; ///< Changed with atomics.
+	int						nbAdopted; ///< Number of event loops which adopted it, changed with atomics.
+} configGeneration_t;
 
 /**
  * @note
@@ -62,38 +95,166 @@ struct serviceInfo
  *
  * The Service class is responsible for initializing services, managing
  * connections, and handling client requests.
+ *
+ * In worker mode ('worker_threads' directive), the Service created by main
+ * (the master) only parses and sets up the listening sockets. Each thread then
+ * runs the event loop of its own worker Service, which shares the master's
+ * servers vector (read-only) but has its own sockets, clients and backend.
+ *
+ * With the 'worker_processes' directive, the Service created by main becomes
+ * a master process: it forks the worker processes after setup(), restarts
+ * the ones which crash and forwards SIGINT/SIGTERM to them. Each worker
+ * process inherits the listening sockets and runs the event loop(s) above.
+ *
+ * The connection limits ('max_connections', 'max_connections_per_ip') are
+ * counted by each event loop (see Service_4_admission.cpp).
+ *
+ * SIGTERM and SIGQUIT stop the Service gracefully: each event loop closes its
+ * listening sockets and finishes its connections first (see
+ * Service_5_shutdown.cpp). SIGINT stops it at once.
+ *
+ * SIGHUP reloads the configuration without closing the listening sockets
+ * which didn't change (see Service_6_reload.cpp). SIGUSR2 starts the new
+ * binary with the listening sockets (see Service_7_upgrade.cpp).
  */
 class Service
 {
 	private:
-			std::vector<Server>		_serversVector;
-			std::vector<Client>		_clientVector;
-			std::vector<pollfd>		_pollingFdVector;
-			size_t					_nbPrimaryServers;
+			std::vector<Server>		_serversVector; ///< Servers parsed by the master (empty in a worker).
+			const std::vector<Server>	*_servers; ///< Servers used by the event loop for the new connections: the master's vector (shared read-only) or the last reloaded one.
+			std::vector<configGeneration_t*>	_generationVector; ///< Reloaded configurations held by the event loop: the current one and the ones its clients were accepted with.
+			std::vector<const std::vector<Server>*>	_generationByFd; ///< Servers the connection of each client was accepted with, indexed by fd.
+			std::map<const std::vector<Server>*, size_t>	_nbClientsByGeneration; ///< Number of clients using each servers vector.
+			std::vector<Client*>	_clientTable; ///< Clients indexed by their socket's fd (NULL if the slot is free).
+			std::vector<int>		_serverIndexByFd; ///< Server index of each listening socket, indexed by fd (-1 if not a listening socket).
+			std::vector<short>		_eventsByFd; ///< Events surveyed for each socket (listening or client), indexed by fd.
+			std::vector<int>		_clientServerByFd; ///< Server index of the listening socket of each client, indexed by fd.
+			std::vector<in_addr_t>	_clientAddressByFd; ///< IPv4 address of each client, indexed by fd.
+			std::vector<int>		_listeningFdVector; ///< Listening sockets surveyed by this event loop.
+			std::vector<size_t>		_nbClientsByServer; ///< Number of clients of each listening socket's server.
+			std::map<in_addr_t, size_t>	_nbClientsByAddress; ///< Number of clients of each address (only the ones with clients).
+			size_t					_nbClients;
+			Poller					*_poller; ///< Readiness backend (poll() or epoll).
+			long					_now; ///< Cached clock (ms, monotonic), updated once per loop iteration.
+			TimerWheel				_timerWheel; ///< Timeout of each client's connection.
+			BufferPool				_bufferPool; ///< Receive buffers of the clients ('client_header_buffer_size').
+			size_t					_nbWakeups; ///< Number of waits which returned (event loop statistics).
+			size_t					_nbEvents; ///< Number of events handled (event loop statistics).
+			int						_acceptPauseFd; ///< Listening socket holding the timer of the accept pause (-1: not paused).
+			long					_drainDeadline; ///< End of the graceful shutdown (ms, monotonic clock), 0 if not shutting down.
+			int						_wakeupPipe[2]; ///< Written by the signal handler to wake the thread up (worker threads and their main thread only, -1 otherwise).
+			size_t					_wakeupSlot; ///< Index of the wake-up pipe in `g_wakeupFds`.
+			Service					*_master; ///< Service publishing the reloaded configurations (and counting the event loops ready): the main thread's in worker mode, this one otherwise.
+			configGeneration_t		*_publishedGeneration; ///< Last reloaded configuration published to the worker threads (master only, NULL if none).
+			unsigned				_publishedCount; ///< Number of configurations published (master only, read with atomics).
+			unsigned				_adoptedCount; ///< Master's `_publishedCount` when this event loop last adopted a configuration.
+			pthread_mutex_t			_publishMutex; ///< Protects `_publishedGeneration` (master only).
+			pthread_t				_parseThread; ///< Thread parsing the reloaded configuration of a single event loop.
+			bool					_isParsing; ///< `_parseThread` is running (or not joined yet).
+			int						_isParsed; ///< Set by `_parseThread` once done, read with atomics.
+			configGeneration_t		*_parsedGeneration; ///< Result of `_parseThread` (NULL if the configuration is invalid).
+			sig_atomic_t			_reloadCount; ///< Value of `g_reload` at the last reload.
+			sig_atomic_t			_upgradeCount; ///< Value of `g_upgrade` at the last binary upgrade.
+			pid_t					_upgradePid; ///< Pid of the new binary until it is ready (-1 if none).
+			pid_t					_previousPid; ///< Previous binary, stopped once the event loops are ready (-1 if none).
+			int						_nbReady; ///< Number of worker threads (or processes) whose event loop is ready, changed with atomics.
+			int						_readyPipe[2]; ///< Written once by each worker process when its event loops are ready (after a binary upgrade only, -1 otherwise).
+			std::vector<listener_t>	_inheritedListenerVector; ///< Listening sockets passed by the previous binary, not adopted yet (setup only).
+			int						_argc; ///< Arguments of the program, to parse the configuration file again.
+			char					**_argv;
+			globalConfig_t			_globalConfig;
 			serviceInfo				_tmpServiceInfo;
+			bool					_isWorker;
+			size_t					_workerID;
+			std::vector<listener_t>	_listenerVector; ///< Listening sockets created by setup() (master only).
+			std::vector<Service*>	_workerVector; ///< Worker event loops (worker mode only).
+			std::vector<pid_t>		_workerPidVector; ///< Pid of each worker process (master process only).
+			std::vector<time_t>		_workerStartVector; ///< Start time of each worker process (master process only).
+			std::vector<pid_t>		_retiredPidVector; ///< Pid of the worker processes replaced by a reload, finishing their connections (master process only).
+
+			Service(Service &master, size_t workerID);
 
 			void					_initTmpServiceInfo();
-			void					_getSetupInfo(std::vector<Server>::iterator server);
+			listener_t				_createListener(Server const &server, int serverID, size_t workerID);
+			bool					_getSetupInfo(Server const &server, int serverID);
 			void					_setReuseableAddress();
+			void					_setTcpOptions(Server const &server);
+			void					_setSocketOption(int level, int name, int value, char const *directive);
 			void					_resetTmpServiceInfo();
 			void					_convertHostToAddress();
 			void					_bindAddressToSocket();
-			void					_setSocketListening();
+			void					_setSocketListening(int backlog);
 			void					_addSocketToPollSockVec();
+			void					_registerListeners(size_t workerID);
+			void					_setupEventLoops();
+			void					_setupWorkers();
+			void					_launchEventLoops();
+			void					_launchWorkers();
+			void					_launchProcesses();
+			pid_t					_spawnWorkerProcess(size_t slot);
+			bool					_replaceWorkerProcesses();
+			void					_stopWorkerProcesses();
+			void					_clearWakeups();
+			void					_openWakeupPipe(size_t slot);
+			void					_superviseWorkers();
+			static void				*_workerRoutine(void *worker);
 			void					_launch();
 			void					_initPollingVector();
 			void					_pollingManager();
-			void					_getLaunchInfo(int const i);
+			bool					_getLaunchInfo(pollfd const &ready);
 			int						_getServerIndex();
 			bool					_hasDataToRead();
 			bool					_isServerSocket();
 			void					_acceptConnection();
+			bool					_acceptOneConnection();
 			void					_readDataFromClient();
 			void					_closeConnection(std::string const &msg);
 			bool					_hasBadRequest();
 			void					_sendDataToClient();
 			void					_checkRequestedServer();
-			size_t					_countPrimaryServers();
+			void					_routeRequest();
+			void					_updateTimer();
+			void					_updateInterest();
+			void					_printLoopStats(long start, long cpuStart);
+			bool					_reportsSignals() const;
+			void					_expireTimers();
+			void					_growFdTables(int fd);
+			bool					_isOverloaded(int serverID) const;
+			bool					_admitConnection(int fd, in_addr_t address);
+			void					_rejectConnection(int fd);
+			void					_releaseConnection(int fd);
+			void					_updateListeners();
+			void					_pauseAccept();
+			void					_resumeAccept();
+			void					_startDrain();
+			bool					_isDrained();
+			void					_closeListeners();
+			bool					_reload();
+			configGeneration_t		*_parseGeneration() const;
+			static void				*_parseRoutine(void *service);
+			bool					_startParsing();
+			void					_stopParsing();
+			void					_checkReload();
+			void					_checkPublished();
+			bool					_isAdopted() const;
+			void					_publishGeneration(configGeneration_t *generation);
+			void					_adoptGeneration(configGeneration_t *generation);
+			static void				_dropGeneration(configGeneration_t *generation);
+			bool					_reloadListeners(configGeneration_t &generation);
+			size_t					_closeUnusedListeners(std::vector<listener_t> const &listenerVector);
+			int						_findListener(std::string const &host, std::string const &port, size_t workerID, std::vector<bool> const &keptVector) const;
+			void					_keepGlobalConfig(globalConfig_t &config) const;
+			void					_releaseGeneration(int fd);
+			void					_freeGeneration(const std::vector<Server> *servers);
+			void					_startUpgrade();
+			void					_checkUpgrade();
+			void					_getInheritedListeners();
+			int						_adoptListener(std::string const &host, std::string const &port);
+			void					_finishInheritance();
+			void					_reportReady();
+			void					_notifyReady();
+			void					_waitWorkersReady();
+			Client&					_getClient();
 
 
 	public:
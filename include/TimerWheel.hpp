@@ -0,0 +1,59 @@
+/**
+ * @file TimerWheel.hpp
+ * @brief Header file for the TimerWheel class, the connection timeouts of an
+ * event loop.
+ */
+
+#ifndef TIMERWHEEL_HPP
+#define TIMERWHEEL_HPP
+
+#include "defines.hpp"
+
+/**
+ * @struct wheelTimer_s
+ * @brief The timer of a connection (one per socket, indexed by its fd).
+ *
+ * The timers of a slot are linked together by their fd, so a timer is moved
+ * or removed without any search.
+ */
+typedef struct wheelTimer_s {
+	long		deadline; ///< Expiry time (ms, monotonic clock).
+	int			slot; ///< Slot holding the timer (-1 if not armed).
+	int			prev; ///< Previous timer in the slot (fd, -1 for the first one).
+	int			next; ///< Next timer in the slot (fd, -1 for the last one).
+} wheelTimer_t;
+
+/**
+ * @class TimerWheel
+ * @brief Hierarchical timer wheel: a connection's deadline is armed, moved and
+ * cancelled in O(1), whatever the number of connections.
+ *
+ * The first wheel has TIMER_SLOTS slots of TIMER_TICK ms each. The second
+ * wheel has TIMER_SLOTS slots of one turn of the first wheel each. Its timers
+ * are cascaded down to the first wheel when their turn comes.
+ * Only the slots reached by the clock are looked at.
+ */
+class TimerWheel
+{
+	private:
+			std::vector<wheelTimer_t>	_timerVector; ///< Timers indexed by fd.
+			std::vector<int>		_slotHead; ///< First timer (fd) of each slot, both wheels (-1 if empty).
+			long					_currentTick; ///< Last tick processed by advance().
+			size_t					_nbTimers; ///< Number of armed timers.
+
+			void					_insert(int fd, long firstTick);
+			void					_unlink(int fd);
+			void					_cascade();
+
+	public:
+			TimerWheel(long now);
+			~TimerWheel();
+
+			void					schedule(int fd, long deadline);
+			void					cancel(int fd);
+			void					advance(long now, std::vector<int> &expiredVector);
+			int						getTimeout(long now, int maxTimeout) const;
+			size_t					getNbTimers() const;
+};
+
+#endif
@@ -14,13 +14,14 @@
 #define CGI_HPP
 
 #include "defines.hpp"
+#include "RequestBody.hpp"
 
 class CGI {
 private:
     std::string _scriptPath;      ///< Path to Python interpreter 
     std::string _method;          ///< HTTP request method (e.g., GET, POST)
     std::string _queryString;     ///< Query string for GET requests
-    std::string _requestBody;     ///< Request payload (POST body)
+    const RequestBody &_requestBody; ///< Request payload (POST body), in memory or in a temporary file
     std::string _pathInfo;        ///< Additional path information (everything after scriptname.py)
     std::string _scriptFileName;  ///< Full path to script file (root + /cgi/*.py)
     std::vector<std::string> _environmentVars; ///< CGI environment variables
@@ -32,7 +33,7 @@ private:
 public:
 
     CGI(const std::string &scriptPath, const std::string &method, 
-        const std::string &queryString, const std::string &requestBody,
+        const std::string &queryString, const RequestBody &requestBody,
         const std::string &pathInfo, const std::string &scriptFileName);
     ~CGI();
 
@@ -11,9 +11,11 @@
 #include <ctime>
 #include <exception>
 #include <map>
+#include <list>
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <deque>
 //#include <regex>
 #include <fcntl.h>
 #include <stdexcept>
@@ -27,20 +29,101 @@
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <limits>
 #include <algorithm>
 #include <sys/wait.h>
+#include <pthread.h>
+#ifdef __linux__
+# include <sys/epoll.h>
+# include <sys/prctl.h>
+# include <sys/sendfile.h>
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# if defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#   include <linux/io_uring.h>
+#   ifdef IORING_FEAT_EXT_ARG // kernel headers >= 5.11
+#    define HAS_IO_URING
+#    ifdef IORING_RECV_MULTISHOT // kernel headers >= 6.0
+#     define HAS_URING_MULTISHOT
+#    endif
+#   endif
+#  endif
+# endif
+#endif
 
 
 // Global variables
-extern bool	g_shutdown;
+extern volatile sig_atomic_t	g_shutdown; // read by every event loop (worker threads included)
+extern volatile sig_atomic_t	g_drain; // graceful shutdown (SIGTERM, SIGQUIT): the requests in progress are finished
+extern volatile sig_atomic_t	g_wakeupFds[]; // wake-up pipe of each worker thread (and of their main thread), written by the signal handler (-1 if none)
+extern volatile sig_atomic_t	g_signal; // last shutdown signal received, forwarded to the worker processes
+extern volatile sig_atomic_t	g_reload; // number of SIGHUP received: each event loop (or the master process) reloads the configuration once per new one
+extern volatile sig_atomic_t	g_upgrade; // number of SIGUSR2 received: the new binary is started once per new one
 
 //Defaut settings
 
-#define POLL_TIME_OUT		200		// 200ms
-#define MAX_PENDING			10		// Maximum number of pending connections
+#define POLL_TIME_OUT		1000	// 1s, maximum wait of an event loop when no timer is due (to check g_shutdown)
+#define DEFAULT_LISTEN_BACKLOG		511		// Maximum number of pending connections (capped by net.core.somaxconn)
+#define MAX_LISTEN_BACKLOG			65535
+#define ACCEPT_BATCH				64		// connections accepted per listening socket and per loop iteration at most
+#define MAX_SOCKET_BUFFER			67108864	// 64MB, for 'so_rcvbuf', 'so_sndbuf' and 'tcp_notsent_lowat'
+#define MAX_TCP_FASTOPEN			65535	// pending Fast Open requests
+#define MAX_TCP_KEEPALIVE			32767	// seconds, for 'tcp_keepidle' and 'tcp_keepintvl'
+#define MAX_TCP_KEEPCNT				127		// keepalive probes
 #define BUFFER_SIZE			2048	// 2KB
-#define SENT_TIMEOUT		60		// 60s
+#define DEFAULT_HEADER_TIMEOUT		60		// 60s to receive the headers of a request
+#define DEFAULT_BODY_TIMEOUT		60		// 60s between two reads of a request's body
+#define DEFAULT_SEND_TIMEOUT		60		// 60s between two writes of a response
+#define MAX_CLIENT_TIMEOUT			3600	// 1h
+#define TIMER_TICK					100		// 100ms, resolution of the timer wheel
+#define TIMER_SLOTS					256		// slots of each wheel of the timer wheel
+#define OUTPUT_CHUNK_SIZE			65536	// 64KB, bytes of a file sent per system call
+#define OUTPUT_HIGH_WATERMARK		65536	// 64KB queued: no new pipelined request is handled before it is sent
+#define OUTPUT_DRAIN_BUDGET			262144	// 256KB sent per connection and per loop iteration at most
+#define DEFAULT_BODY_BUFFER_SIZE	16384	// 16KB of a request's body kept in memory, the rest goes to a temporary file
+#define MAX_BODY_BUFFER_SIZE		67108864	// 64MB, for 'client_body_buffer_size'
+#define DEFAULT_HEADER_BUFFER_SIZE	16384	// 16KB receive buffer of a connection: the headers of a request must fit in it
+#define MIN_HEADER_BUFFER_SIZE		1024	// 1KB, for 'client_header_buffer_size'
+#define MAX_HEADER_BUFFER_SIZE		1048576	// 1MB
+#define BUFFER_POOL_KEEP			256		// free receive buffers kept by the pool of an event loop
+#define BODY_TEMP_FILE				"/tmp/webserv_body_XXXXXX"	// template of the temporary files of the request bodies (mkstemp())
+#define DEFAULT_KEEPALIVE_TIMEOUT	75		// 75s, 0 disables keep-alive
+#define DEFAULT_KEEPALIVE_REQUESTS	1000	// requests served on a connection before closing it
+#define MAX_KEEPALIVE_TIMEOUT		3600	// 1h
+#define MAX_KEEPALIVE_REQUESTS		1000000
+#define EPOLL_MAX_EVENTS	256		// Initial size of the epoll_wait() events buffer
+#define URING_SQ_ENTRIES	1024	// Submission queue of the io_uring backend (requests queued per wait before a submission)
+#define URING_CQ_ENTRIES	8192	// Completion queue of the io_uring backend
+#define URING_RECV_BUFFERS	512		// Receive buffers of the io_uring backend (a power of 2), shared by the connections of an event loop
+#define URING_RECV_BUFFER_SIZE	4096	// Size of each receive buffer of the io_uring backend
+#define URING_RECV_MAX_BUFFERS	16		// Receive buffers held by a connection before its recv request is stopped
+#define MAX_WORKERS			256		// Maximum number of worker threads (or processes)
+#define MASTER_WAKEUP		MAX_WORKERS	// Slot of the main thread's wake-up pipe in g_wakeupFds (worker threads only)
+#define RELOAD_POLL_TIME_OUT	10		// Timeout (ms) of a loop waiting for a reload to be parsed or adopted
+#define WORKERS_AUTO		"auto"	// one worker per core
+#define RESPAWN_DELAY		1		// 1s, minimum lifetime of a worker process before it is restarted at once
+#define MAX_CONNECTIONS		1000000	// Maximum value of 'max_connections' and 'max_connections_per_ip'
+#define DEFAULT_SHUTDOWN_TIMEOUT	30	// 30s to finish the requests in progress after SIGTERM or SIGQUIT
+#define MAX_SHUTDOWN_TIMEOUT	3600	// 1h
+#define UPGRADE_ENV			"WEBSERV_LISTENERS"	// listening sockets passed to the new binary: "fd;fd;..."
+#define ACCEPT_RETRY_DELAY	500		// 500ms without accepting after accept() ran out of fds (EMFILE...)
+
+// Overload actions ('overload_action' directive)
+#define OVERLOAD_STOP		"stop"	// the listening sockets stop accepting until a connection is closed
+#define OVERLOAD_503		"503"	// the new connections get OVERLOAD_RESPONSE (retry in 5s), then are closed
+#define OVERLOAD_RESPONSE	"HTTP/1.1 503 Service Unavailable\r\nRetry-After: 5\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"
+
+// Event backends (see Poller::create())
+#define BACKEND_AUTO		"auto"
+#define BACKEND_POLL		"poll"
+#define BACKEND_EPOLL		"epoll"
+#define BACKEND_URING		"io_uring"
+#ifndef DEFAULT_EVENT_BACKEND
+# define DEFAULT_EVENT_BACKEND	BACKEND_AUTO	// can be set at build time: make EVENT_BACKEND=poll
+#endif
 
 // Charset 	
 #define REQUEST_END			"\r\n\r\n"
@@ -58,6 +141,20 @@ extern bool	g_shutdown;
 #define START_MSG						"Webserv is starting..."
 #define END_MSG							"Webserv shutdowned"
 #define SHUTDOWN_MSG					"Webserv is shutting down..."
+#define DRAIN_MSG						"Webserv is finishing the requests in progress..."
+#define DRAIN_START_MSG(id, nb)			"Event loop " + to_string(id) + ": listening sockets closed, " + to_string(nb) + " connections to finish"
+#define DRAIN_TIMEOUT_MSG(id, nb)		"Event loop " + to_string(id) + ": shutdown timeout, " + to_string(nb) + " connections cut"
+#define RELOAD_MSG						"Webserv is reloading its configuration..."
+#define RELOAD_DONE_MSG(id, kept, opened, closed)	"Event loop " + to_string(id) + ": configuration reloaded, listening sockets: " + to_string(kept) + " kept, " + to_string(opened) + " opened, " + to_string(closed) + " closed"
+#define RELOAD_KEPT_MSG(directive)		"'" + std::string(directive) + "' can't change without a restart, the previous value is kept"
+#define ERR_RELOAD(what)				"Configuration not reloaded, the previous one is kept: " + std::string(what)
+#define UPGRADE_MSG						"Webserv is starting its new binary..."
+#define UPGRADE_START_MSG(pid, nb)		"New binary started (pid " + to_string(pid) + ") with " + to_string(nb) + " listening sockets"
+#define UPGRADE_FAIL_MSG(pid)			"New binary (pid " + to_string(pid) + ") stopped before being ready, this process keeps running"
+#define UPGRADE_INHERIT_MSG(nb)			"Listening sockets inherited from the previous process: " + to_string(nb)
+#define UPGRADE_READY_MSG(pid)			"Event loops ready, the previous process (pid " + to_string(pid) + ") stops gracefully"
+#define UPGRADE_NOT_READY_MSG(pid)		"A worker process stopped before being ready, the previous process (pid " + to_string(pid) + ") keeps running"
+#define ERR_EXEC						"execve() failed: "
 #define SET_SERVER_MSG(host, port)		"Server " + host + ":" + port + " setup complete"
 #define LAUNCH_MSG						"Launching servers..."
 #define EMPTY_MSG						""
@@ -72,6 +169,7 @@ extern bool	g_shutdown;
 #define ERR_FILE_CONF(confFile)			"'"+ confFile + "' is a invalid file\n\tFile must have a name and must be .conf"
 #define ERR_OPEN						"Couldn't open file "
 #define ERR_NO_SERVER_CONFIG			"There is no bloc server in the configuration file "
+#define ERR_GLOBAL_FORBIDDEN_DIRECTIVE(directive)	"Directive '" + directive + "' is not allowed outside a Server block"
 
 //Parser token error
 #define ERR_INVALID_KEY(line)						"Invalid keyword on line: '" + line + "'"
@@ -98,6 +196,8 @@ extern bool	g_shutdown;
 #define ERR_MAX_SIZE_CONVERSION(size)			"'" + size + "' is not a valid number."
 #define ERR_MAX_SIZE_CONVERSION_LONG(size)		"'" + size + "' is a number too large for long."
 #define ERR_INVALID_SERVER_NAME(server)			"'"+ server + "' is not a valid server name, only alphanumeric, hyphens, and periods are allowed "
+#define ERR_NUMBER_RANGE(directive, value, min, max)	"'" + value + "' is not a valid value for '" + directive + "'. Use a number between " + to_string(min) + " and " + to_string(max)
+#define ERR_ON_OFF(directive, value)			"'" + value + "' is not a valid value for '" + directive + "'. Use 'on' or 'off'"
 
 //Bloc Location Error
 #define ERR_LOCATION(path)						"Location's path needs to begin with a '/' "
@@ -106,12 +206,18 @@ extern bool	g_shutdown;
 #define ERR_ERR_CGI_DOT(extension)				"Extension '" + extension + "' must start with a point (.)" 
 #define ERR_ERR_CGI_EXT(extension)				"Unsupported CGI extension: '" + extension + "'" 
 
+//Global directives Error
+#define ERR_BACKEND(backend)					"'" + backend + "' is not a valid event backend. Use 'auto', 'poll', 'epoll' or 'io_uring' (Linux only)"
+#define ERR_OVERLOAD(value)						"'" + value + "' is not a valid overload action. Use 'stop' or '503'"
+#define ERR_WORKERS(value)						"'" + value + "' is not a valid number of workers. Use 'auto' or a number between 1 and " + to_string(MAX_WORKERS)
+
 // Maximum Limits
-#define MAX_LOOP_COUNT 10  // Define the maximum allowed loop iterations for location checks
 #define MAX_URI_LENGTH 2048 // adjust as needed
 
 //Setup Error
 #define ERR_SOCKET(server)						"failed to create network socket for server " + server
+#define ERR_REUSEPORT							"SO_REUSEPORT is not available: worker mode can't be used on this system"
+#define ERR_SOCKET_OPTION(directive)			"'" + std::string(directive) + "' is not available on this system"
 
 // Service setServersAddress errors
 #define ERR_SET_SOCKET					"setsockopt() failed: "
@@ -125,6 +231,28 @@ extern bool	g_shutdown;
 // Service launch errors
 #define ERR_POLL_FAIL					"poll() failed"
 #define ERR_ACCEPT_SOCKET				"accept() failed"
+#define ERR_EPOLL_CREATE				"epoll_create1() failed: "
+#define ERR_EPOLL_CTL					"epoll_ctl() failed: "
+#define ERR_BODY_TEMP_FILE				"can't create the temporary file of a request body: "
+#define ERR_BODY_WRITE					"can't write a request body: "
+#define ERR_BODY_MAP					"can't map the temporary file of a request body: "
+#define ERR_URING_SETUP					"io_uring_setup() failed: "
+#define ERR_URING_FEATURES				"io_uring lacks features (Linux >= 5.11 needed)"
+#define ERR_URING_MMAP					"io_uring mmap() failed: "
+#define ERR_URING_ENTER					"io_uring_enter() failed: "
+#define ERR_URING_FULL					"io_uring submission queue full, the kernel takes no entry"
+#define URING_FALLBACK_MSG(what)		"io_uring unavailable (" + std::string(what) + "), using epoll"
+#define BACKEND_MSG(name)				"Event backend: " + name
+#define ERR_THREAD						"pthread_create() failed: "
+#define ERR_PIPE						"pipe() failed: "
+#define WORKERS_MSG(nb)					"Starting " + to_string(nb) + " worker threads..."
+#define ERR_WORKER(id, what)			"Worker " + to_string(id) + " stopped: " + what
+#define ERR_FORK						"fork() failed: "
+#define PROCESSES_MSG(nb)				"Starting " + to_string(nb) + " worker processes..."
+#define WORKER_EXIT_MSG(pid, how)		"Worker process " + to_string(pid) + " " + how + ", restarting it..."
+#define ACCEPT_PAUSE_MSG(error)			"accept() failed: " + std::string(error) + ", new connections are paused"
+#define OVERLOAD_MSG					"Connection refused. Overload"
+#define LOOP_STATS_MSG(id, seconds, wakeups, events, cpu)	"Event loop " + to_string(id) + ": " + to_string(wakeups) + " wakeups (" + to_string(wakeups / seconds) + "/s), " + to_string(events) + " events, " + to_string(cpu) + " ms CPU in " + to_string(seconds) + " s"
 
 // Server parameters
 #define SERVER		"server"
@@ -132,8 +260,26 @@ extern bool	g_shutdown;
 #define	HOST		"listen_host"
 #define INDEX		"index"
 #define MAX_SIZE	"client_max_body_size"
+#define BODY_BUF	"client_body_buffer_size"
 #define SERVER_N	"server_name"
 #define ERROR_P		"error_page"
+#define KEEPALIVE_T	"keepalive_timeout"
+#define KEEPALIVE_R	"keepalive_requests"
+#define HEADER_T	"client_header_timeout"
+#define BODY_T		"client_body_timeout"
+#define SEND_T		"send_timeout"
+#define BACKLOG		"listen_backlog"
+#define TCP_ND		"tcp_nodelay"
+#define TCP_DA		"tcp_defer_accept"
+#define TCP_FO		"tcp_fastopen"
+#define SO_RB		"so_rcvbuf"
+#define SO_SB		"so_sndbuf"
+#define TCP_NL		"tcp_notsent_lowat"
+#define TCP_KI		"tcp_keepidle"
+#define TCP_KV		"tcp_keepintvl"
+#define TCP_KC		"tcp_keepcnt"
+#define MAX_CONN	"max_connections" // in a server bloc or outside (global)
+#define MAX_CONN_IP	"max_connections_per_ip"
 
 // Servers'Location parameters
 #define LOCATION	"location"
@@ -147,4 +293,12 @@ extern bool	g_shutdown;
 #define CGI_E		"cgi_ext"
 #define HAS_CGI		"hasCgi"
 
+// Global parameters (outside of any server bloc)
+#define EVENT_BACKEND	"event_backend"
+#define WORKER_T		"worker_threads"
+#define WORKER_P		"worker_processes"
+#define OVERLOAD		"overload_action"
+#define SHUTDOWN_T		"shutdown_timeout"
+#define HEADER_BUF		"client_header_buffer_size"
+
 #endif
@@ -12,9 +12,13 @@
 
 /* === Time === */
 std::string getTime();
+long getMonotonicTime();
+long getThreadCpuTime();
 
 /* === Signal === */
 void signalHandler(int signum);
+void setSignalHandler(int signum, void (*handler)(int));
+void wakeUpEventLoops();
 
 /* === PrintInfo === */
 void printMap(const std::map<std::string, std::string> &mapToPrint);
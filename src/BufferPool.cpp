@@ -0,0 +1,58 @@
+/**
+ * @file BufferPool.cpp
+ * @brief Implementation of the receive buffers pool of an event loop.
+ */
+
+#include "BufferPool.hpp"
+
+BufferPool::BufferPool() : _bufferSize(DEFAULT_HEADER_BUFFER_SIZE), _nbUsed(0) {}
+
+BufferPool::~BufferPool() {
+  for (size_t i = 0; i < this->_freeVector.size(); i++)
+    delete[] this->_freeVector[i];
+}
+
+/**
+ * @brief Sets the size of the buffers, before any of them is handed (the free
+ * ones of the previous size are deleted).
+ */
+void BufferPool::setBufferSize(size_t bufferSize) {
+  if (this->_nbUsed > 0 || bufferSize == this->_bufferSize)
+    return;
+  for (size_t i = 0; i < this->_freeVector.size(); i++)
+    delete[] this->_freeVector[i];
+  this->_freeVector.clear();
+  this->_bufferSize = bufferSize;
+}
+
+size_t BufferPool::getBufferSize() const { return (this->_bufferSize); }
+
+/**
+ * @brief Hands a buffer of `getBufferSize()` bytes (not initialized).
+ */
+char *BufferPool::acquire() {
+  char *buffer;
+
+  if (this->_freeVector.empty())
+    buffer = new char[this->_bufferSize];
+  else {
+    buffer = this->_freeVector.back();
+    this->_freeVector.pop_back();
+  }
+  this->_nbUsed++;
+  return buffer;
+}
+
+/**
+ * @brief Takes a buffer back: it is kept for the next connections, or deleted
+ * if the pool already holds BUFFER_POOL_KEEP free ones.
+ */
+void BufferPool::release(char *buffer) {
+  if (buffer == NULL)
+    return;
+  this->_nbUsed--;
+  if (this->_freeVector.size() < BUFFER_POOL_KEEP)
+    this->_freeVector.push_back(buffer);
+  else
+    delete[] buffer;
+}
@@ -14,65 +14,124 @@
 
 // *** Constructor and destructor 
 //Client::Client(Server server, int socket) : _server(server), _socket(socket), _sentRequest(false), _lastRequest(std::time(NULL)){}
-Client::Client(Server server, int socket)
-    : _server(server),
+Client::Client(const Server &server, int socket, long now, BufferPool &pool)
+    : _server(&server),
       _socket(socket),
       _sentRequest(false),
-      _lastRequest(std::time(NULL)), // _lastRequest comes before _request
-      _request(""),
-      _resourcePath(""),
+      _requestStart(now), // the first request's headers are awaited since the connection
+      _lastActivity(now),
+      _request(pool),
+      _parser(),
+      _output(),
+      _target(),
       _method(""),
-      _requestPayload(""),
-      _headers(),
-      _isChunked(false) {}
+      _body(),
+      _location(NULL),
+      _defaultServer(&server),
+      _keepAlive(true), // the connection stays open until a response closes it
+      _nbRequests(0),
+      _closing(false)
+{
+    this->_body.reset(server.getClientBodyBufferSize());
+}
 
 Client::~Client(){}
 
 // *** Getters and Setters
-const std::string& Client::getRequest() const{return (this->_request);}
-const	Server& Client::getServer() const{return (this->_server);}
-void	Client::changeServer(Server server){this->_server = server;}
+const ReceiveBuffer& Client::getRequest() const{return (this->_request);}
+/**
+ * @brief Getter for a header of the current request (empty if absent), until the request is handled.
+ */
+std::string Client::getHeader(header_e id) const{return (this->_parser.getHeader(this->_request, id));}
+const	Server& Client::getServer() const{return (*this->_server);}
+void	Client::changeServer(const Server &server){this->_server = &server;}
+bool	Client::isKeepAlive() const{return (this->_keepAlive);}
+
+/**
+ * @brief Checks if the connection is between two requests: nothing received and nothing to send.
+ *
+ * A new connection is not idle: its first request may already be on the way.
+ */
+bool	Client::isIdle() const{return (this->_nbRequests > 0 && this->_request.empty() && this->_output.empty());}
+
+/**
+ * @brief The response to the request in progress (if any) is the last one: it announces `Connection: close`.
+ *
+ * Without a request in progress, the connection is closed once the queued responses are sent.
+ */
+void	Client::closeAfterResponse()
+{
+	this->_closing = true;
+	if (this->_request.empty())
+		this->_keepAlive = false;
+}
 
 
 /**
- * @brief If the buffer is not empty (there is still bytes read by the recv()), its content is append to the Client's _request variable.
+ * @brief Reads the bytes waiting on the client's socket into the receive buffer (taken from the pool of the event
+ * loop if the connection had none), then parses them.
  * 
  * This function is public and called from a Service instance.
  * 
- * @param buffer variable with data to append to the request
- * @param size size of the buffer
+ * @param poller backend of the event loop, which receives the bytes (recv(), or already received by the kernel)
+ * @param now cached clock of the Service (ms)
+ * @return ssize_t the result of recv(): bytes read, 0 if the client closed the connection, -1 on error.
  */
-void	Client::appendRequest(char const *buffer, size_t size)
+ssize_t	Client::receiveRequest(Poller &poller, long now)
 {
-	this->_lastRequest = std::time(NULL);
-	this->_sentRequest = false;
+	bool	isNewRequest = this->_request.empty();
+	ssize_t	bytes = this->_request.receive(poller, this->_socket);
 
-	// Debug log the raw buffer content
-    std::cerr << "[DEBUG] Raw buffer content: " << std::string(buffer, size) << std::endl;
-
-	// Append the buffer content to the request
-	this->_request.append(buffer, size);
+	if (bytes <= 0)
+		return (bytes);
+	if (isNewRequest)
+		this->_requestStart = now;
+	this->_lastActivity = now;
+	this->_sentRequest = false;
+	this->_parseRequest();
+	return (bytes);
 }
 
 /**
- * @brief The function checks if there is no timeout between the time the server receive the request and time to respond
- * (= if the connection and the server are fast enough)
+ * @brief The function gives the time the connection is closed if nothing happens (= if the client or the network
+ * is too slow), the timeout depends on what the connection is waiting for:
+ * - a response is being sent: 'send_timeout' since the last write.
+ * - idle between two requests (keep-alive): 'keepalive_timeout' since the last response.
+ * - the headers of a request: 'client_header_timeout' since the request started to arrive.
+ * - the body of a request: 'client_body_timeout' since the last read.
+ *
+ * The timeouts are the ones of the server of the listening socket.
+ * @return long the deadline (ms, same clock as `now`)
  */
-bool	Client::isTimeout() const
+long	Client::getDeadline() const
 {
-	return (std::time(NULL) - this->_lastRequest > SENT_TIMEOUT);
+	const Server &server = *this->_defaultServer;
+
+	if (!this->_output.empty())
+		return (this->_lastActivity + server.getSendTimeout() * 1000);
+	if (this->_request.empty() && this->_nbRequests > 0)
+		return (this->_lastActivity + server.getKeepaliveTimeout() * 1000);
+	if (!this->_parser.hasHeaders())
+		return (this->_requestStart + server.getHeaderTimeout() * 1000);
+	return (this->_lastActivity + server.getBodyTimeout() * 1000);
 }
 
 /**
  * @brief The function checks if the client has finished to send a request, so he's ready to receive.
- * The client is ready if 
- * a) "sentRequest = true" 
- * OR 
- * b) the request ends by the sequence (REQUEST_END) "\r\n\r\n"
+ * The client is ready when the parser reached the end of the current request: its headers and its whole body, or
+ * the error which rejects it (see `RequestParser`).
  */
 bool	Client::clientIsReadyToReceive() const
 {
-	
-	return (this->_sentRequest == true || this->_request.find(REQUEST_END) != std::string::npos);
+	return (this->_parser.isDone());
+}
+
+/**
+ * @brief Checks if the headers of the current request are received, and the request waits for `routeRequest()`
+ * before its body is read.
+ */
+bool	Client::isWaitingForRoute() const
+{
+	return (this->_parser.isWaitingForRoute());
 }
 
@@ -28,22 +28,15 @@
 
 bool Client::isCgiPath(const std::string& filePath, const location_t& locationConfig) const
 {
-    std::cout << "Checking CGI path: " << filePath << std::endl;
-    std::cout << "Has CGI: " << locationConfig.hasCGI << ", CGI Extension: " << locationConfig.cgiExtension << std::endl;
     // Ensure CGI is enabled for the location
     if (!locationConfig.hasCGI)
-    {
-        std::cout << "CGI is not enabled for this location." << std::endl;
         return false;
-    }
 
     // Check if the file path ends with the CGI extension
     if (filePath.size() >= locationConfig.cgiExtension.size() &&
         filePath.compare(filePath.size() - locationConfig.cgiExtension.size(), locationConfig.cgiExtension.size(), locationConfig.cgiExtension) == 0) {
         return true;
     }
-
-    std::cout << "Path does not match CGI extension: " << locationConfig.cgiExtension << std::endl;
     return false;
 }
 
@@ -60,18 +53,10 @@ bool Client::isCgiPath(const std::string& filePath, const location_t& locationCo
  */
 
 std::string Client::executeCgi(const std::string &cgiPath, const std::string &method, 
-                        const std::string &queryString, const std::string &body, 
+                        const std::string &queryString, const RequestBody &body, 
                         const std::string &pathInfo, const std::string &scriptFileName)
 {
     CGI cgi(cgiPath, method, queryString, body, pathInfo, scriptFileName);
-    
-     // Debug CGI execution details
-    std::cout << "Debug: Executing CGI script with:" << std::endl;
-    std::cout << "Debug: cgiPath: " << cgiPath << std::endl;
-    std::cout << "Debug: method: " << method << std::endl;
-    std::cout << "Debug: queryString: " << queryString << std::endl;
-    std::cout << "Debug: pathInfo: " << pathInfo << std::endl;
-    std::cout << "Debug: scriptFileName: " << scriptFileName << std::endl;
     std::string cgiOutput = cgi.execute(); // Execute CGI and capture the output.
     return cgiOutput; // Return the output to the caller.
 }
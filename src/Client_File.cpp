@@ -21,28 +21,26 @@
  * - Handles directory requests with autoindex generation if enabled.
  * - Sends the file content if the file exists, or an error response otherwise.
  * 
- * @param [in] path The requested resource path.
+ * The path and the query are the ones of `_target`, decoded when the request was routed.
  */
-void Client::handleGetRequest(const std::string& path)
+void Client::handleGetRequest()
 {
-    // Extract path without query string
-    size_t queryPos = path.find('?');
-    std::string cleanPath = (queryPos != std::string::npos) ? path.substr(0, queryPos) : path;
-    std::string queryString = (queryPos != std::string::npos) ? path.substr(queryPos + 1) : "";
-    
+    const std::string &cleanPath = _target.path;
+    const std::string &queryString = _target.query;
+
     // Construct the full file path
-    std::string filePath = this->_server.getRoot() + cleanPath;
+    std::string filePath = this->_server->getRoot() + cleanPath;
 
     // If the path is "/", serve the default index file
     if (cleanPath == "/")
-        filePath = this->_server.getRoot() + "/index.html";
+        filePath = this->_server->getRoot() + "/index.html";
     
     // Check if the path is a CGI script
-    location_t locationConfig = _server.getLocationConfig(cleanPath);
+    const location_t &locationConfig = _server->getLocationConfig(cleanPath);
     // Check for the try_file directive
     if (!locationConfig.tryFile.empty())
     {
-        std::string tryFilePath = this->_server.getRoot() + cleanPath + "/" + locationConfig.tryFile;
+        std::string tryFilePath = this->_server->getRoot() + cleanPath + "/" + locationConfig.tryFile;
         if (fileExists(tryFilePath))
             filePath = tryFilePath; // Serve the try_file if it exists
         else
@@ -52,7 +50,7 @@ void Client::handleGetRequest(const std::string& path)
         }
     }
     // Check if the requested method is allowed in the location block
-    for (std::vector<std::string>::iterator it = locationConfig.methods.begin(); it != locationConfig.methods.end(); ++it)
+    for (std::vector<std::string>::const_iterator it = locationConfig.methods.begin(); it != locationConfig.methods.end(); ++it)
     {
         if (*it == "GET") // The "GET" method is allowed, exit the loop.
             break;
@@ -64,9 +62,6 @@ void Client::handleGetRequest(const std::string& path)
             return;
         }
     }
-    std::cout << "Debug: cleanPath: " << cleanPath << std::endl;
-    std::cout << "Debug: CGI Path: " << locationConfig.cgiPath << std::endl;
-    
     if (isCgiPath(cleanPath, locationConfig))
     {
         // Validate and calculate pathInfo
@@ -80,13 +75,14 @@ void Client::handleGetRequest(const std::string& path)
                 pathInfo = cleanPath; // Fallback for debugging
             }
             // Script file to be executed
-            std::string scriptFileName = this->_server.getRoot() + cleanPath;
+            std::string scriptFileName = this->_server->getRoot() + cleanPath;
 
             // Python interpreter path
             std::string scriptPath = getPythonPath(); // Get the Python interpreter path
 
             // Execute CGI and capture output
-            std::string result = executeCgi(scriptPath, "GET", queryString, "", pathInfo, scriptFileName);
+            RequestBody noBody;
+            std::string result = executeCgi(scriptPath, "GET", queryString, noBody, pathInfo, scriptFileName);
 
             // Send the CGI output as the HTTP response
             if (!result.empty())
@@ -107,7 +103,7 @@ void Client::handleGetRequest(const std::string& path)
         else
         {
             // Check if autoindex is enabled
-            location_t locationConfig = _server.getLocationConfig(cleanPath);
+            const location_t &locationConfig = _server->getLocationConfig(cleanPath);
             if (locationConfig.autoindex)
             {
                 // Generate the autoindex page
@@ -123,17 +119,19 @@ void Client::handleGetRequest(const std::string& path)
         }
     }
     // Attempt to open the file
-    std::ifstream file(filePath.c_str());
-    if (file.is_open())
+    int fileFd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat fileStat;
+    if (fileFd >= 0 && fstat(fileFd, &fileStat) == 0 && S_ISREG(fileStat.st_mode))
     {
-        // Read file contents
-        std::string fileContents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-        file.close();
-        // Send the file contents as the response
-        sendResponse(200, "OK", fileContents);
+        // Send the file as the response: it is streamed from the disk by the output queue
+        sendFileResponse(200, "OK", fileFd, fileStat.st_size);
     }
     else
+    {
+        if (fileFd >= 0)
+            close(fileFd);
         sendErrorResponse(404, "Not Found");
+    }
 }
 
 
@@ -182,20 +180,18 @@ std::string Client::generateAutoindexPage(const std::string &directoryPath, cons
  * - Handles multipart form data uploads or file uploads based on Content-Type.
  * - Executes CGI scripts if applicable.
  * 
- * @param [in] path The path where the resource will be uploaded or processed.
+ * The path (where the resource is uploaded or processed) and the query are the ones of `_target`.
  */
-void Client::handlePostRequest(const std::string &path)
- {
-    // Extract path without query string
-    size_t queryPos = path.find('?');
-    std::string cleanPath = (queryPos != std::string::npos) ? path.substr(0, queryPos) : path;
-    std::string queryString = (queryPos != std::string::npos) ? path.substr(queryPos + 1) : "";
-    
+void Client::handlePostRequest()
+{
+    const std::string &cleanPath = _target.path;
+    const std::string &queryString = _target.query;
+
     // Retrieve location configuration for this request
-    location_t locationConfig = _server.getLocationConfig(cleanPath);
+    const location_t &locationConfig = _server->getLocationConfig(cleanPath);
 
     // Check if the requested method is allowed in the location block
-    for (std::vector<std::string>::iterator it = locationConfig.methods.begin(); it != locationConfig.methods.end(); ++it)
+    for (std::vector<std::string>::const_iterator it = locationConfig.methods.begin(); it != locationConfig.methods.end(); ++it)
     {
         if (*it == "POST") // The "POST" method is allowed, exit the loop.
             break;
@@ -209,10 +205,9 @@ void Client::handlePostRequest(const std::string &path)
     }
 
     // Validate Content-Type header
-    std::map<std::string, std::string>::iterator it = _headers.find("Content-Type");
-
-    std::string contentType = (it != _headers.end()) ? it->second : "text/plain";
-    stringTrim(contentType);
+    std::string contentType = this->getHeader(HEADER_CONTENT_TYPE);
+    if (contentType.empty())
+        contentType = "text/plain";
     
     if (isCgiPath(cleanPath, locationConfig))
     {
@@ -238,11 +233,11 @@ void Client::handlePostRequest(const std::string &path)
         }
 
         // Script file to be executed
-        std::string scriptFileName = this->_server.getRoot() + cleanPath;
+        std::string scriptFileName = this->_server->getRoot() + cleanPath;
 
         // Python interpreter path
         std::string scriptPath = getPythonPath(); // Get the Python interpreter path
-        std::string result = executeCgi(scriptPath, "POST", queryString, _requestPayload, pathInfo, scriptFileName);
+        std::string result = executeCgi(scriptPath, "POST", queryString, _body, pathInfo, scriptFileName);
         if (!result.empty())
             sendCgiResponse(result);
         else
@@ -252,10 +247,9 @@ void Client::handlePostRequest(const std::string &path)
     // Handle file uploads if allowed
     if (!locationConfig.uploadTo.empty())
     {
-        if (contentType == "application/json" || contentType == "text/plain" || contentType == "application/octet-stream" ||
-            contentType == "application/pdf" || contentType.find("image/") == 0 || contentType == "application/x-www-form-urlencoded")
+        if (_isUploadType(contentType))
         {
-            uploadFile(path);
+            uploadFile(cleanPath);
             return;
         }
         // Check for multipart form data - maybe we'll remove if not needed
@@ -268,7 +262,7 @@ void Client::handlePostRequest(const std::string &path)
                 return;
             }
             std::string boundary = contentType.substr(boundaryPos + 9); // Extract boundary
-            handleMultipartFormData(path, boundary); // Handle multipart parsing
+            handleMultipartFormData(cleanPath, boundary); // Handle multipart parsing
         }
         else
         {
@@ -281,22 +275,77 @@ void Client::handlePostRequest(const std::string &path)
 }
 
 
+/**
+ * @brief Checks if a `Content-Type` is uploaded as a file (the body is saved as it is).
+ */
+bool Client::_isUploadType(const std::string &contentType) const
+{
+    return (contentType == "application/json" || contentType == "text/plain" ||
+            contentType == "application/octet-stream" || contentType == "application/pdf" ||
+            contentType.find("image/") == 0 || contentType == "application/x-www-form-urlencoded");
+}
+
+/**
+ * @brief Gets the directory the files are uploaded to: 'upload_to' of the location, in the root of the server.
+ * @return std::string the directory, ending with a '/'.
+ */
+std::string Client::_getUploadDirectory(const location_t &locationConfig) const
+{
+    std::string uploadDirectory = _server->getRoot();
+    if (!locationConfig.uploadTo.empty())
+    {
+        if (front(locationConfig.uploadTo) != '/')
+            uploadDirectory += "/";
+        uploadDirectory += locationConfig.uploadTo;
+    }
+
+    // Ensure the upload directory ends with a '/'
+    if (back(uploadDirectory) != '/')
+        uploadDirectory += "/";
+    return uploadDirectory;
+}
+
+/**
+ * @brief Finds a string in the body, from a position.
+ * @return size_t its position, std::string::npos if it is not found.
+ */
+static size_t findInBody(const char *body, size_t size, const std::string &needle, size_t from)
+{
+    if (from >= size)
+        return std::string::npos;
+    const char *found = std::search(body + from, body + size, needle.begin(), needle.end());
+    return (found == body + size) ? std::string::npos : found - body;
+}
+
+/**
+ * @brief Saves the files of a `multipart/form-data` body in the upload directory.
+ *
+ * @details The parts are read where they are in the body (a large body is mapped from its temporary file), only
+ * their headers are copied.
+ */
 void Client::handleMultipartFormData(const std::string &path, const std::string &boundary)
 {
     (void)path;
 
     // Derive the upload directory
-    std::string uploadDirectory = _server.getRoot() + "/upload/";
-    if (uploadDirectory.back() != '/')
+    std::string uploadDirectory = _server->getRoot() + "/upload/";
+    if (back(uploadDirectory) != '/')
         uploadDirectory += "/";
 
     std::string boundaryMarker = "--" + boundary;
     std::string closingBoundary = boundaryMarker + "--";
 
+    const char *payload = _body.data();
+    size_t payloadSize = _body.size();
     size_t currentPos = 0;
 
+    if (payload == NULL)
+    {
+        sendErrorResponse(500, "Internal Server Error: Unable to read the request body");
+        return;
+    }
     // Check if the first boundary is correct
-    if (_requestPayload.find(boundaryMarker) != 0)
+    if (findInBody(payload, payloadSize, boundaryMarker, 0) != 0)
     {
         sendErrorResponse(400, "Malformed multipart body: Missing or invalid initial boundary");
         return;
@@ -306,7 +355,7 @@ void Client::handleMultipartFormData(const std::string &path, const std::string
     while (true)
     {
         // Find the next boundary
-        size_t boundaryStart = _requestPayload.find(boundaryMarker, currentPos);
+        size_t boundaryStart = findInBody(payload, payloadSize, boundaryMarker, currentPos);
         if (boundaryStart == std::string::npos)
         {
             sendErrorResponse(400, "Malformed multipart body: Missing boundary");
@@ -314,11 +363,12 @@ void Client::handleMultipartFormData(const std::string &path, const std::string
         }
 
         // Check for closing boundary
-        if (_requestPayload.substr(boundaryStart, closingBoundary.size()) == closingBoundary)
+        if (payloadSize - boundaryStart >= closingBoundary.size() &&
+            closingBoundary.compare(0, closingBoundary.size(), payload + boundaryStart, closingBoundary.size()) == 0)
             break; // End of parts
 
         size_t partStart = boundaryStart + boundaryMarker.size() + 2; // Skip boundary and \r\n
-        size_t boundaryEnd = _requestPayload.find(boundaryMarker, partStart);
+        size_t boundaryEnd = findInBody(payload, payloadSize, boundaryMarker, partStart);
 
         if (boundaryEnd == std::string::npos)
         {
@@ -326,19 +376,19 @@ void Client::handleMultipartFormData(const std::string &path, const std::string
             return;
         }
 
-        // Extract the part content
-        std::string part = _requestPayload.substr(partStart, boundaryEnd - partStart);
-
         // Extract headers and content
-        size_t headerEnd = part.find("\r\n\r\n");
+        size_t headerEnd = findInBody(payload, boundaryEnd, "\r\n\r\n", partStart);
         if (headerEnd == std::string::npos)
         {
             sendErrorResponse(400, "Malformed multipart body: Missing headers");
             return;
         }
 
-        std::string headers = part.substr(0, headerEnd);
-        std::string content = part.substr(headerEnd + 4); // Skip \r\n\r\n
+        std::string headers(payload + partStart, headerEnd - partStart);
+        const char *content = payload + headerEnd + 4; // Skip \r\n\r\n
+        size_t contentSize = boundaryEnd - (headerEnd + 4);
+        if (contentSize >= 2 && content[contentSize - 2] == '\r' && content[contentSize - 1] == '\n')
+            contentSize -= 2; // the CRLF before the boundary is part of the delimiter
 
         // Parse headers for filename
         std::string filename;
@@ -366,7 +416,7 @@ void Client::handleMultipartFormData(const std::string &path, const std::string
             sendErrorResponse(500, "Internal Server Error: Unable to open file for writing");
             return;
         }
-        outFile.write(content.c_str(), content.size());
+        outFile.write(content, contentSize);
         outFile.close();
 
         // Move to the next boundary
@@ -388,23 +438,10 @@ void Client::handleMultipartFormData(const std::string &path, const std::string
 void Client::uploadFile(const std::string &path)
 {
     // Retrieve location configuration
-    location_t locationConfig = _server.getLocationConfig(path);
-    
-    // Debugging to ensure `uploadTo` is used - remove later
-    std::cout << "Using uploadTo: " << locationConfig.uploadTo << std::endl;
+    const location_t &locationConfig = _server->getLocationConfig(path);
 
     // Determine upload directory
-    std::string uploadDirectory = _server.getRoot();
-    if (!locationConfig.uploadTo.empty())
-    {
-        if (front(locationConfig.uploadTo) != '/')
-            uploadDirectory += "/";
-        uploadDirectory += locationConfig.uploadTo;
-    }
-
-    // Ensure the upload directory ends with a '/'
-    if (back(uploadDirectory) != '/')
-        uploadDirectory += "/";
+    std::string uploadDirectory = _getUploadDirectory(locationConfig);
 
     // Derive the full file path
     std::string fileName = path.substr(path.find_last_of('/') + 1);
@@ -412,20 +449,22 @@ void Client::uploadFile(const std::string &path)
         fileName = "default_upload.txt"; // Default name
     std::string filePath = uploadDirectory + fileName;
 
-    // Debugging resolved path
-    std::cout << "Resolved upload path: " << filePath << std::endl;
-
     // Open a file to write the payload
-    std::ofstream outFile(filePath.c_str(), std::ios::binary);
-    if (!outFile.is_open())
+    int fileFd = open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fileFd < 0)
     {
         sendErrorResponse(500, "Internal Server Error: Unable to open file for writing");
         return;
     }
 
-    // Write the request payload to the file 
-    outFile.write(_requestPayload.c_str(), _requestPayload.size());
-    outFile.close();
+    // Write the request payload to the file (copied from the temporary file if it is a large one)
+    bool written = _body.writeTo(fileFd);
+    close(fileFd);
+    if (!written)
+    {
+        sendErrorResponse(500, "Internal Server Error: Unable to write the file");
+        return;
+    }
     sendResponse(200, "OK", "File uploaded successfully");
 }
 
@@ -437,19 +476,20 @@ void Client::uploadFile(const std::string &path)
  * - Attempts to delete the file.
  * - Sends appropriate responses based on success or failure.
  * 
- * @param [in] path The path to the file to be deleted.
+ * The path of the file to be deleted is the one of `_target`.
  */
-void Client::handleDeleteRequest(const std::string &path)
+void Client::handleDeleteRequest()
 {
-   
+    const std::string &path = _target.path;
+
     // Check if the request path starts with "/upload"
     std::string fullPath;
     if (path.find("/upload/") == 0)
     {
-        location_t locationConfig = _server.getLocationConfig(std::string("/upload"));
+        const location_t &locationConfig = _server->getLocationConfig(std::string("/upload"));
         
         // Check if the requested method is allowed in the location block
-        for (std::vector<std::string>::iterator it = locationConfig.methods.begin(); it != locationConfig.methods.end(); ++it)
+        for (std::vector<std::string>::const_iterator it = locationConfig.methods.begin(); it != locationConfig.methods.end(); ++it)
         {
             if (*it == "DELETE")
             {
@@ -464,14 +504,14 @@ void Client::handleDeleteRequest(const std::string &path)
                 return;
             }
         }
-        fullPath = this->_server.getRoot() + "/upload/" + path.substr(8); // Construct the path for files in the upload directory
+        fullPath = this->_server->getRoot() + "/upload/" + path.substr(8); // Construct the path for files in the upload directory
     }
     else
     {
-        location_t locationConfig = _server.getLocationConfig(std::string("/"));
+        const location_t &locationConfig = _server->getLocationConfig(std::string("/"));
         
         // Check if the requested method is allowed in the location block
-        for (std::vector<std::string>::iterator it = locationConfig.methods.begin(); it != locationConfig.methods.end(); ++it)
+        for (std::vector<std::string>::const_iterator it = locationConfig.methods.begin(); it != locationConfig.methods.end(); ++it)
         {
             if (*it == "DELETE")
             {
@@ -486,7 +526,7 @@ void Client::handleDeleteRequest(const std::string &path)
                 return;
             }
         }
-        fullPath = this->_server.getRoot() + path; // Construct the path for files in the root directory
+        fullPath = this->_server->getRoot() + path; // Construct the path for files in the root directory
     }
 
     // Check if the file exists
@@ -11,437 +11,222 @@
 /* ************************************************************************** */
 
 #include "Client.hpp"
-#include <cstdlib>
 
 /**
- * @brief Handles the client's request by validating, routing, and processing it.
- * 
- * This function performs the following steps:
- * - Validates the client's HTTP request.
- * - Determines the resource path and root directory.
- * - Matches the request with server locations or handles redirects.
- * - Routes the request to the appropriate handler based on the HTTP method.
- * 
- * Supported methods:
- * - GET
- * - POST
- * - DELETE
+ * @brief Handles the request the parser completed (or rejected), then gets the Client ready for the next request of
+ * the connection.
+ *
+ * Only this request is consumed: the bytes received after it (the next pipelined requests) are kept, and parsed
+ * at once. If there are none, the receive buffer goes back to the pool of the event loop until the next request.
+ * The response is queued, see `sendPendingResponse()`.
+ *
+ * The connection is closed by default: it is only kept alive if the request is valid and
+ * `_wantsKeepAlive()` allows it (see `isKeepAlive()`).
  */
 void Client::handleClientRequest()
 {
-    // Set response as "sent" and record the request time
-    this->_sentRequest = true;
-    this->_lastRequest = std::time(NULL);
-    
-    if (!_checkRequest())
-    {
-        sendErrorResponse(400, "Bad Request: Invalid request format");
-        std::cerr << "[ERROR] Invalid request format received." << std::endl;
-        return;
-    }
-
-    // Prepare root and resource paths
-    std::string root = _server.getRoot();
-    std::string resource = _resourcePath;
+    this->_nbRequests++;
+    this->_keepAlive = false;
 
-    // Validate the requested location or handle a redirect
-	int locationStatus = _checkLocation(root, resource, 0);
-    if (locationStatus == -1) // Location not found
-    {
-        sendErrorResponse(404, "Not Found: Invalid resource location");
-        std::cerr << "[ERROR] Resource location not found: " << resource << std::endl;
-        return;
-    }
-    if (locationStatus == 1) // Redirect handled
-    {
-        std::cout << "[DEBUG] Redirect handled for resource: " << resource << std::endl;
-        return;
-    }
-    // Route the request based on the HTTP method
-    if (_method == "GET")
-        handleGetRequest(resource);
-    else if (_method == "POST")
-        handlePostRequest(resource);
-    else if (_method == "DELETE")
-        handleDeleteRequest(resource);
+    this->_processRequest();
+    if (this->_keepAlive) // the connection is closed after this response otherwise
+        this->_request.erase(0, this->_parser.getLength());
     else
-        sendErrorResponse(501, "Not Implemented");
-        
-    // Clear request and payload after processing
-    this->_request.clear();
-    this->_requestPayload.clear();
-    this->_sentRequest = false;
+        this->_request.clear();
+    this->_resetRequest();
 }
 
 /**
- * @brief Validates the client's HTTP request format and content.
- * 
- * @details Checks the following:
- * - Request line (method, path, and version).
- * - Headers (e.g., Host, Content-Type).
- * - Payload for POST requests.
- * 
- * @return true if the request is valid, false otherwise.
+ * @brief Parses the bytes received since the last call, until the end of the current request.
+ *
+ * The parser stops at the end of the headers, until the request is routed (see `routeRequest()`). The body is then
+ * moved to `_body` as it is parsed, which keeps it in memory up to the 'client_body_buffer_size' of the server, in a
+ * temporary file beyond.
  */
-bool Client::_checkRequest()
+void Client::_parseRequest()
 {
-    std::stringstream ss(_request);
-    std::cerr << "DEBUG: Raw request:\n" << _request << std::endl; // Debug remove later
-    _headers.clear();
-    _requestPayload.clear();
-
-    if (!_checkFirstLine(ss) || !_checkAndGetHeaders(ss) || !_checkAndGetPayload(ss))
-        return false;
-    return true;
-}
-
-/**
- * @brief Validates the first line of the HTTP request.
- * 
- * @details Extracts the method, resource path, and HTTP version from the request line.
- * Validates the following:
- * - Supported HTTP versions (only HTTP/1.1 is allowed).
- * - Supported methods (GET, POST, DELETE).
- * - Valid URL path characters.
- * 
- * @param [in] ss String stream containing the HTTP request.
- * @return true if the first line is valid, false otherwise.
- */
-bool Client::_checkFirstLine(std::stringstream &ss)
-{
-    std::string line;
-    std::getline(ss, line);
-
-    std::istringstream lineStream(line);
-    std::vector<std::string> tokens;
-    std::string token;
-    while (lineStream >> token)
-        tokens.push_back(token);
-    if (tokens.size() != 3)
-    {
-        sendErrorResponse(400, "Bad Request: Invalid Request Line");
-        return false;
-    }
-    _method = tokens[0];
-    _resourcePath = tokens[1];
-    std::string version = tokens[2];
-    
-    // Validate the HTTP version
-    if (version != "HTTP/1.1")
+    if (this->_request.empty())
+        return;
+    this->_parser.parse(this->_request, this->_body);
+    // the receive buffer is full of a request the parser can't go on with: its headers don't fit in it
+    if (this->_request.isFull() && !this->_parser.isDone() && !this->_parser.isWaitingForRoute())
     {
-        if (version == "HTTP/1.0") // Specific check for HTTP/1.0
-            sendErrorResponse(505, "HTTP Version Not Supported: Use HTTP/1.1");
+        if (this->_parser.hasHeaders())
+            this->_parser.reject(400, "Bad Request: Line Too Long");
         else
-            sendErrorResponse(400, "Bad Request: Invalid HTTP Version");
-        return false;
-    }
-    // Validate the method
-    if (_method != "GET" && _method != "POST" && _method != "DELETE")
-    {
-        sendErrorResponse(501, "Not Implemented");
-        return false;
-    }
-    // Validate the url path characters
-    if (!isUrlValid(_resourcePath))
-    {
-        sendErrorResponse(400, "Bad Request: Invalid Character in URL");
-        return false;
+            this->_parser.reject(431, "Request Header Fields Too Large");
     }
-    return true;
 }
 
 /**
- * @brief Checks if a given URL is valid.
- * 
- * @details A valid URL contains only the following characters:
- * - Alphanumeric characters
- * - `-._~:/?#[]@!$&'()*+,;=%`
- * 
- * @param [in] url The URL to validate.
- * @return true if the URL is valid, false otherwise.
+ * @brief Routes the request as soon as its headers are received, before its body is read.
+ *
+ * The server is the one of the `Host` header (chosen by the Service before). A request which can't succeed
+ * (unknown method, no location, method not allowed, body larger than the 'client_max_body_size' of the server, no
+ * upload target...) is rejected at once: its error response is sent without receiving the body, and the connection
+ * is closed. Otherwise the parser goes on with the body, and a client waiting for it (`Expect: 100-continue`) is
+ * told to send it.
  */
-bool Client::isUrlValid(const std::string &url) const
+void Client::routeRequest()
 {
-    const std::string allowedChars = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-                                      "abcdefghijklmnopqrstuvwxyz"
-                                      "0123456789-._~:/?#[]@!$&'()*+,;=%";
-    std::string decodedUrl = decodeUrl(url); // Decode the URL first
-    for (std::string::const_iterator it = decodedUrl.begin(); it != decodedUrl.end(); ++it)
-    {
-        if (allowedChars.find(*it) == std::string::npos)
-            return false; // Invalid character found
-    }
-    return true; // All characters are valid
+    if (!this->_parser.isWaitingForRoute())
+        return;
+    this->_method = this->_parser.getMethod();
+    if (!this->_checkRoute())
+        return;
+    this->_parser.resume(this->_server->getClientMaxBodySize());
+    if (this->_parser.hasError())
+        return;
+    // the interim response, only if the client waits for it: nothing of the body is received yet
+    if (this->_parser.expectsBody() && this->_request.size() == this->_parser.getLength() &&
+        this->_parser.headerEquals(this->_request, HEADER_EXPECT, "100-continue"))
+        this->_output.append("HTTP/1.1 100 Continue\r\n\r\n");
+    this->_parseRequest();
 }
-
 /**
- * @brief Decodes percent-encoded characters in a URL.
- * 
- * @details Converts URL-encoded sequences (e.g., "%20") back to their 
- * original characters (e.g., space). This is necessary because browsers 
- * automatically encode invalid characters in URLs, and the server needs 
- * to decode them to validate and process the URL correctly.
- * 
- * @param [in] url The URL to decode.
- * @return A decoded URL with all percent-encoded characters replaced by their original values.
+ * @brief Resets the request's state between two requests of a keep-alive connection.
+ *
+ * The server can be changed by the `Host` header of a request, so the next request starts again
+ * with the server of the listening socket. The next request may already be (partly) received.
  */
-std::string Client::decodeUrl(const std::string &url) const
+void Client::_resetRequest()
 {
-    std::string decoded;
-    for (size_t i = 0; i < url.length(); ++i)
-    {
-        if (url[i] == '%' && i + 2 < url.length())
-        {
-            // Convert percent-encoded sequence to character
-            char hex[3] = {url[i + 1], url[i + 2], '\0'};
-            decoded += static_cast<char>(strtol(hex, NULL, 16));
-            i += 2; // Skip the next two characters
-        }
-        else
-            decoded += url[i];
-    }
-    return decoded;
+    this->_target.path.clear();
+    this->_target.query.clear();
+    this->_method.clear();
+    this->_location = NULL;
+    this->_body.reset(this->_defaultServer->getClientBodyBufferSize());
+    this->_sentRequest = false;
+    this->_requestStart = this->_lastActivity; // a pipelined request was received with this one
+    this->_server = this->_defaultServer;
+    this->_parser.reset();
+    if (this->_request.empty()) // idle: its receive buffer is back in the pool, nothing else is kept
+        this->_parser.release();
+    this->_parseRequest();
 }
 
-
 /**
- * @brief Parses and validates the headers from the HTTP request.
- * 
- * @details Validates the following:
- * - Presence of mandatory headers like Host.
- * - Content-Type for POST requests.
- * - Malformed headers.
- * 
- * @param [in] ss String stream containing the HTTP request.
- * @return true if the headers are valid, false otherwise.
+ * @brief Checks if the connection can be kept open after the response.
+ *
+ * HTTP/1.1 connections are persistent unless the client sends `Connection: close`, the server
+ * disables keep-alive ('keepalive_timeout 0') or the connection reached 'keepalive_requests'.
  */
-bool Client::_checkAndGetHeaders(std::stringstream &ss)
+bool Client::_wantsKeepAlive() const
 {
-    std::string line;
-    bool hostHeaderFound = false;
-
-    while (std::getline(ss, line))
-    {
-        stringTrim(line); // Trim whitespace around the line
-        if (line == "\r" || line.empty())
-            break; // End of headers
-
-        // Find the colon for key-value separation
-        size_t colon = line.find(':');
-        if (colon == std::string::npos)
-        {
-            sendErrorResponse(400, "Bad Request: Malformed Header");
-            return false;
-        }
-        // Extract key and value
-        std::string key = line.substr(0, colon);
-        std::string value = line.substr(colon + 1);
-        stringTrim(key);
-        stringTrim(value);
-        // Validate header key and value
-        if (key.empty() || value.empty())
-        {
-            sendErrorResponse(400, "Bad Request: Empty Header Key or Value");
-            return false;
-        }
-        // Store the header in the map
-        _headers[key] = value;
-        if (key == "Host")
-        {
-            hostHeaderFound = true;
-            // Validate the Host header
-            if (value.empty())
-            {
-                sendErrorResponse(400, "Bad Request: Empty Host Header");
-                return false;
-            }
-        }
-        if (key == "Expect" && value == "100-continue")
-        {
-            std::cout << "[INFO] Received Expect: 100-continue" << std::endl;
-            sendResponse(100, "Continue", "");
-        }
-    }
-    // Ensure Host header is present
-    if (!hostHeaderFound)
-    {
-        std::cerr << "DEBUG: Host header is missing!" << std::endl; // Debug remove later
-        sendErrorResponse(400, "Bad Request: Missing Host Header");
+    if (this->_closing || this->_server->getKeepaliveTimeout() == 0 ||
+        this->_nbRequests >= this->_server->getKeepaliveRequests())
         return false;
-    }
-    return true;
+
+    return (!this->_parser.headerHasToken(this->_request, HEADER_CONNECTION, "close"));
 }
 
 /**
- * @brief Parses and validates the payload for POST requests.
+ * @brief Handles the client's request, routed when its headers were received (see `routeRequest()`).
  * 
- * @details Validates the payload based on the following:
- * - Transfer-Encoding: chunked.
- * - Content-Length header.
+ * This function performs the following steps:
+ * - Sends the error response of a rejected request.
+ * - Handles the redirect of the location.
+ * - Routes the request to the appropriate handler based on the HTTP method.
  * 
- * @param [in] ss String stream containing the HTTP request.
- * @return true if the payload is valid, false otherwise.
+ * Supported methods:
+ * - GET
+ * - POST
+ * - DELETE
  */
-bool Client::_checkAndGetPayload(std::stringstream &ss)
+void Client::_processRequest()
 {
-    if (this->_method != "POST")
-        return true;
-
-    // Check for Transfer-Encoding: chunked
-    std::map<std::string, std::string>::iterator it = _headers.find("Transfer-Encoding");
-    if (it != _headers.end() && it->second == "chunked")
+    // Set response as "sent"
+    this->_sentRequest = true;
+    
+    if (!_checkRequest())
     {
-        _isChunked = true;
+        std::cerr << "[ERROR] Invalid request format received." << std::endl;
+        return;
     }
+    // The request is complete and valid: the next one can be read on the same connection
+    this->_keepAlive = this->_wantsKeepAlive();
 
-    if (_isChunked)
+    // Handle a redirect
+    const location_t &loc = *this->_location;
+    if (!loc.redirect_path.empty())
     {
-        return parseChunkedPayload(ss);
+        sendRedirectResponse(ft_stoll(loc.redirect_err), loc.redirect_path);
+        return;
     }
+    // Route the request based on the HTTP method
+    if (_method == "GET")
+        handleGetRequest();
+    else if (_method == "POST")
+        handlePostRequest();
     else
-    {
-        // Original logic for Content-Length based payloads
-        it = _headers.find("Content-Length");
-        if (it == _headers.end())
-        {
-            sendErrorResponse(411, "Length Required");
-            return false;
-        }
-
-        long contentLength = -1;
-        try
-        {
-            contentLength = std::strtol(it->second.c_str(), NULL, 10);
-            if (contentLength < 0)
-            {
-                sendErrorResponse(400, "Bad Request: Invalid Content-Length");
-                return false;
-            }
-        }
-        catch (const std::exception &)
-        {
-            sendErrorResponse(400, "Bad Request: Invalid Content-Length");
-            return false;
-        }
-       if (contentLength > static_cast<long>(_server.getClientMaxBodySize())) {
-            sendErrorResponse(413, "Payload Too Large");
-            return false;
-        }
-        // Read the content into _requestPayload
-        _requestPayload.resize(contentLength);
-        ss.read(&_requestPayload[0], contentLength);
-
-        if (ss.gcount() != contentLength)
-        {
-            sendErrorResponse(400, "Bad Request: Incomplete Payload");
-            return false;
-        }
-
-        return true;
-    }
+        handleDeleteRequest();
 }
 
 /**
- * @brief Parses and validates the payload for chunked transfer encoding.
- * 
- * @details Reads and appends the chunked data to the request payload.
+ * @brief Checks that the request received by the parser is valid.
  * 
- * @param [in] ss String stream containing the HTTP request.
- * @return true if the payload is valid, false otherwise.
+ * @details The syntax (request line, headers, body) is checked by the parser, the method, the URL and the location
+ * by `_checkRoute()`: both reject the request with the status of the error. The error response is sent here.
+ * @return true if the request is valid, false otherwise.
  */
-bool Client::parseChunkedPayload(std::stringstream &ss)
+bool Client::_checkRequest()
 {
-    std::string line;
-    while (std::getline(ss, line))
+    if (this->_parser.hasError())
     {
-        // Strip CRLF
-        stringTrim(line);
-
-        // Read chunk size (in hex)
-        long chunkSize = strtol(line.c_str(), NULL, 16);
-        if (chunkSize < 0)
-        {
-            sendErrorResponse(400, "Bad Request: Invalid Chunk Size");
-            return false;
-        }
-
-        if (chunkSize == 0) // End of chunks
-        {
-            std::getline(ss, line); // Consume trailing CRLF
-            break;
-        }
-
-        // Read chunk data
-        char *buffer = new char[chunkSize];
-        ss.read(buffer, chunkSize);
-        if (ss.gcount() != chunkSize)
-        {
-            delete[] buffer;
-            sendErrorResponse(400, "Bad Request: Incomplete Chunk");
-            return false;
-        }
-
-        _requestPayload.append(buffer, chunkSize);
-        delete[] buffer;
-
-        std::getline(ss, line); // Consume trailing CRLF after chunk
+        sendErrorResponse(this->_parser.getErrorStatus(), this->_parser.getErrorMessage());
+        return false;
     }
     return true;
 }
 
-
 /**
- * @brief Matches a resource path to a server's location block.
- * 
- * Searches for the best matching location block based on a longest-prefix match.
- * Handles redirects, validates HTTP methods, and updates the root directory if applicable.
- * 
- * @param root [in, out] Reference to the root directory path, updated if a new root is specified.
- * @param resource [in, out] Reference to the requested resource path, may be modified for redirects.
- * @param loopCount [in] Counter to prevent infinite redirects.
+ * @brief Checks the request with its headers only, and finds its location.
  * 
- * @return 
- * - `0` if a location block is matched.
- * - `1` if a redirect is handled.
- * - `-1` if no location matches or an error occurs.
+ * @details Checks the following:
+ * - Supported methods (GET, POST, DELETE).
+ * - Valid URL (see `parseRequestTarget()`): its path is decoded and normalized in `_target`.
+ * - A location matches the path (a redirect location accepts every method).
+ * - The method is allowed in the location.
+ * - `Expect`: only `100-continue` is supported.
+ * - A POST can be handled: see `_checkPostTarget()`.
  * 
- * @details Sends error responses for invalid methods or unmatched locations. 
- * Validates allowed methods and handles redirections where applicable.
+ * The request is rejected by the parser, its error response is sent when it is handled.
+ * @return true if the request can go on, false otherwise.
  */
-int Client::_checkLocation(std::string &root, std::string &resource, size_t loopCount)
+bool Client::_checkRoute()
 {
-    if (loopCount > MAX_LOOP_COUNT)
-        return -1;
-
-    const std::map<std::string, location_t> &locations = _server.getLocations();
-    std::map<std::string, location_t>::const_iterator matchedLocation = locations.end();
-    size_t matchedPrefixLength = 0;
-
-    // Find the best matching location
-    for (std::map<std::string, location_t>::const_iterator it = locations.begin(); it != locations.end(); ++it)
+    // Validate the method
+    if (_method != "GET" && _method != "POST" && _method != "DELETE")
     {
-        if (resource.find(it->first) == 0 && it->first.size() > matchedPrefixLength)
-        {
-            matchedLocation = it;
-            matchedPrefixLength = it->first.size();
-        }
+        this->_parser.reject(501, "Not Implemented");
+        return false;
     }
-    if (matchedLocation == locations.end())
+    // Validate the url, then split and decode it
+    switch (parseRequestTarget(this->_parser.getTarget(), this->_target))
     {
-        std::map<std::string, location_t>::const_iterator defaultLocation = locations.find("/");
-        if (defaultLocation != locations.end())
-            matchedLocation = defaultLocation;
-        else
-            return -1; // No matching location found and no default "/" location
+        case TARGET_OK:
+            break;
+        case TARGET_INVALID_CHARACTER:
+            this->_parser.reject(400, "Bad Request: Invalid Character in URL");
+            return false;
+        case TARGET_INVALID_ENCODING:
+            this->_parser.reject(400, "Bad Request: Invalid Percent-Encoding in URL");
+            return false;
+        case TARGET_OUTSIDE_ROOT:
+            this->_parser.reject(400, "Bad Request: Path Outside of the Root");
+            return false;
     }
-    const location_t &loc = matchedLocation->second;
-
-    // Handle redirects
-    if (!loc.redirect_path.empty())
+    // Longest location that begins the path (the "/" location begins any path)
+    this->_location = this->_server->findLocation(_target.path, false);
+    if (this->_location == NULL)
     {
-        sendRedirectResponse(ft_stoll(loc.redirect_err), loc.redirect_path);
-        return 1; // Redirect handled
+        std::cerr << "[ERROR] Resource location not found: " << _target.path << std::endl;
+        this->_parser.reject(404, "Not Found: Invalid resource location");
+        return false;
     }
+    const location_t &loc = *this->_location;
+    if (!loc.redirect_path.empty())
+        return true;
 
     // Check if the method is allowed
     if (std::find(loc.methods.begin(), loc.methods.end(), _method) == loc.methods.end())
@@ -454,17 +239,56 @@ int Client::_checkLocation(std::string &root, std::string &resource, size_t loop
                 allowedMethods += ", ";
             allowedMethods += *it;
         }
-
-        // Send error response with allowed methods
-        std::string errorMessage = "Method Not Allowed. Allowed methods: " + allowedMethods;
-        sendErrorResponse(405, errorMessage);
         std::cerr << "[ERROR] Method not allowed. Allowed methods: " << allowedMethods << std::endl;
-        return -1; // Return an error code
+        this->_parser.reject(405, "Method Not Allowed. Allowed methods: " + allowedMethods);
+        return false;
+    }
+    if (!this->getHeader(HEADER_EXPECT).empty() &&
+        !this->_parser.headerEquals(this->_request, HEADER_EXPECT, "100-continue"))
+    {
+        this->_parser.reject(417, "Expectation Failed");
+        return false;
     }
+    return (_method != "POST" || this->_checkPostTarget());
+}
 
-    // Update the root if specified
-    if (!loc.root.empty())
-        root = loc.root;
+/**
+ * @brief Checks that a POST can be handled before its body is received: it runs a CGI script, or uploads a file of
+ * a supported type to an existing upload directory (same rules as `handlePostRequest()`).
+ * @return true if the request can go on, false if it is rejected.
+ */
+bool Client::_checkPostTarget()
+{
+    const location_t &locationConfig = _server->getLocationConfig(_target.path);
+
+    if (isCgiPath(_target.path, locationConfig))
+        return true;
+    if (locationConfig.uploadTo.empty())
+    {
+        this->_parser.reject(415, "Unsupported Media Type");
+        return false;
+    }
+    std::string contentType = this->getHeader(HEADER_CONTENT_TYPE);
+    if (contentType.empty())
+        contentType = "text/plain";
 
-    return 0; // Successfully matched a location
+    if (_isUploadType(contentType))
+    {
+        if (access(_getUploadDirectory(locationConfig).c_str(), W_OK) != 0)
+        {
+            this->_parser.reject(500, "Internal Server Error: Unable to open file for writing");
+            return false;
+        }
+    }
+    else if (contentType.find("multipart/form-data") == std::string::npos)
+    {
+        this->_parser.reject(415, "Unsupported Media Type for file upload");
+        return false;
+    }
+    else if (contentType.find("boundary=") == std::string::npos)
+    {
+        this->_parser.reject(400, "Missing boundary parameter in Content-Type");
+        return false;
+    }
+    return true;
 }
@@ -18,6 +18,56 @@
 // void Client::sendErrorResponse(int statusCode, const std::string &statusMessage) { /* ... */ }
 
 
+/**
+ * @brief Checks if some responses are still waiting to be sent.
+ */
+bool Client::hasPendingResponse() const
+{
+    return (!this->_output.empty());
+}
+
+/**
+ * @brief Checks if the output queue holds enough data: no new request is handled before it is sent (backpressure).
+ */
+bool Client::isOutputFull() const
+{
+    return (this->_output.getSize() >= OUTPUT_HIGH_WATERMARK);
+}
+
+/**
+ * @brief Sends the queued responses.
+ *
+ * The responses of the pipelined requests handled in a row are coalesced in the output queue. The socket is
+ * non-blocking, so the kernel may take only a part of them: the rest stays queued for the next call (next POLLOUT).
+ * @param now cached clock of the Service (ms), the 'send_timeout' starts again after each write.
+ */
+void Client::sendPendingResponse(long now)
+{
+    ssize_t bytesSent = this->_output.drain(_socket);
+
+    if (bytesSent < 0)
+        throw std::runtime_error("Send failed in sendPendingResponse");
+    if (bytesSent > 0)
+        this->_lastActivity = now;
+}
+
+/**
+ * @brief Builds the headers announcing if the connection is kept open after the response.
+ *
+ * @return "Connection: keep-alive" with the server's limits in a "Keep-Alive" header, or "Connection: close".
+ */
+std::string Client::_getConnectionHeaders() const
+{
+    std::ostringstream headers;
+
+    if (!this->_keepAlive)
+        return "Connection: close\r\n";
+    headers << "Connection: keep-alive\r\n";
+    headers << "Keep-Alive: timeout=" << this->_server->getKeepaliveTimeout()
+            << ", max=" << this->_server->getKeepaliveRequests() - this->_nbRequests << "\r\n";
+    return headers.str();
+}
+
 /**
  * @brief Sends a standard HTTP response to the client.
  * 
@@ -32,14 +82,33 @@ void Client::sendResponse(int statusCode, const std::string &statusMessage, cons
 {
     std::ostringstream response;
     response << "HTTP/1.1 " << statusCode << " " << statusMessage << "\r\n";
+    response << _getConnectionHeaders();
     response << "Content-Length: " << body.size() << "\r\n\r\n" << body;
-    //send(_socket, response.str().c_str(), response.str().size(), 0);
 
-    ssize_t bytesSent = send(_socket, response.str().c_str(), response.str().size(), 0);
-    if (bytesSent < 0) {
-        throw std::runtime_error("Send failed in sendRedirectResponse");
-    }
+    // queued, sent by sendPendingResponse() with the other pipelined responses
+    this->_output.append(response.str());
+}
 
+/**
+ * @brief Sends an HTTP response whose body is a file.
+ *
+ * @details The file is not read here: the output queue sends it by chunks when the socket is writable, so a large
+ * file never sits in memory.
+ *
+ * @param [in] statusCode The HTTP status code.
+ * @param [in] statusMessage The HTTP status message.
+ * @param [in] fd The open file (the output queue closes it).
+ * @param [in] size The size of the file.
+ */
+void Client::sendFileResponse(int statusCode, const std::string &statusMessage, int fd, off_t size)
+{
+    std::ostringstream response;
+    response << "HTTP/1.1 " << statusCode << " " << statusMessage << "\r\n";
+    response << _getConnectionHeaders();
+    response << "Content-Length: " << size << "\r\n\r\n";
+
+    this->_output.append(response.str());
+    this->_output.appendFile(fd, size);
 }
 
 /**
@@ -53,18 +122,14 @@ void Client::sendResponse(int statusCode, const std::string &statusMessage, cons
  */
 void Client::sendRedirectResponse(int statusCode, const std::string &location)
 {
-    std::cerr << "Ressource location found: " << statusCode << "  " << location << std::endl;
     std::ostringstream response;
     response << "HTTP/1.1 " << statusCode << " Found\r\n";
     response << "Location: " << location << "\r\n";
+    response << _getConnectionHeaders();
     response << "Content-Length: 0\r\n\r\n";
-    
-    //send(_socket, response.str().c_str(), response.str().size(), 0);
 
-    ssize_t bytesSent = send(_socket, response.str().c_str(), response.str().size(), 0);
-    if (bytesSent < 0) {
-        throw std::runtime_error("Send failed in sendRedirectResponse");
-    }
+    // queued, sent by sendPendingResponse() with the other pipelined responses
+    this->_output.append(response.str());
 }
 
 /**
@@ -112,9 +177,9 @@ void Client::sendErrorResponse(int statusCode, const std::string &statusMessage)
     // Find the custom error page path or use a default
     std::map<int, std::string>::iterator it = errorPagePaths.find(statusCode);
     if (it != errorPagePaths.end())
-        customErrorPagePath = this->_server.getRoot() + it->second;
+        customErrorPagePath = this->_server->getRoot() + it->second;
     else
-        customErrorPagePath = this->_server.getRoot() + "/error_pages/error.html";
+        customErrorPagePath = this->_server->getRoot() + "/error_pages/error.html";
 
     errorPageFile.open(customErrorPagePath.c_str());
     if (errorPageFile.is_open())
@@ -128,8 +193,6 @@ void Client::sendErrorResponse(int statusCode, const std::string &statusMessage)
     // Fallback for other status codes or missing custom error pages
     std::ostringstream defaultErrorBody;
     defaultErrorBody << "<html><body><h1>" << statusCode << " " << statusMessage << "</h1></body></html>";
-    // Debug: Sending fallback response
-    std::cout << "Debug: Sending fallback error response for status code: " << statusCode << std::endl;
     sendResponse(statusCode, statusMessage, defaultErrorBody.str());
 } 
 
@@ -166,12 +229,10 @@ void Client::sendCgiResponse(const std::string &cgiOutput)
     std::ostringstream response;
     response << "HTTP/1.1 200 OK\r\n";
     response << "Content-Type: " << contentType << "\r\n";
+    response << _getConnectionHeaders();
     response << "Content-Length: " << body.size() << "\r\n\r\n";
     response << body;
-   
-    ssize_t bytesSent = send(_socket, response.str().c_str(), response.str().size(), 0);
-    if (bytesSent < 0) {
-        throw std::runtime_error("Send failed in sendRedirectResponse");
-    }
-    
+
+    // queued, sent by sendPendingResponse() with the other pipelined responses
+    this->_output.append(response.str());
 }
@@ -0,0 +1,158 @@
+/**
+ * @file OutputQueue.cpp
+ * @brief Implementation of the per-connection output queue.
+ */
+
+#include "OutputQueue.hpp"
+
+OutputQueue::OutputQueue() : _size(0) {}
+
+/**
+ * @brief Closes the files which were not (completely) sent.
+ */
+OutputQueue::~OutputQueue() {
+  while (!this->_segmentList.empty())
+    this->_popSegment();
+}
+
+/**
+ * @brief Queues bytes to send.
+ *
+ * They are added to the last segment if it is in memory too, so the
+ * responses of pipelined requests go out with the same send().
+ */
+void OutputQueue::append(std::string const &data) {
+  if (data.empty())
+    return;
+  if (!this->_segmentList.empty() && this->_segmentList.back().fd < 0) {
+    outputSegment_t &last = this->_segmentList.back();
+
+    last.data.append(data);
+    last.end = last.data.size();
+  } else {
+    outputSegment_t segment;
+
+    segment.data = data;
+    segment.fd = -1;
+    segment.offset = 0;
+    segment.end = data.size();
+    this->_segmentList.push_back(segment);
+  }
+  this->_size += data.size();
+}
+
+/**
+ * @brief Queues the content of an open file (the queue closes it once sent).
+ *
+ * @param fd The file, read from its beginning.
+ * @param size Number of bytes to send.
+ */
+void OutputQueue::appendFile(int fd, off_t size) {
+  if (size <= 0) {
+    close(fd);
+    return;
+  }
+  outputSegment_t segment;
+
+  segment.fd = fd;
+  segment.offset = 0;
+  segment.end = size;
+  this->_segmentList.push_back(segment);
+  this->_size += size;
+}
+
+bool OutputQueue::empty() const { return (this->_segmentList.empty()); }
+
+/**
+ * @brief Getter for the number of bytes still to send, used as backpressure:
+ * no new response is produced while the queue holds OUTPUT_HIGH_WATERMARK.
+ */
+off_t OutputQueue::getSize() const { return (this->_size); }
+
+/**
+ * @brief Sends as much as the socket takes, up to OUTPUT_DRAIN_BUDGET bytes
+ * (so a fast client doesn't keep the event loop from the others).
+ *
+ * @param socket The client's socket (non-blocking).
+ * @return ssize_t the number of bytes sent, or -1 on error (not EAGAIN).
+ */
+ssize_t OutputQueue::drain(int socket) {
+  ssize_t total = 0;
+
+  while (!this->_segmentList.empty() && total < OUTPUT_DRAIN_BUDGET) {
+    outputSegment_t &segment = this->_segmentList.front();
+    off_t wanted = segment.end - segment.offset;
+    if (segment.fd >= 0)
+      wanted = std::min(wanted, static_cast<off_t>(OUTPUT_CHUNK_SIZE));
+    ssize_t sent = this->_sendSegment(socket, segment,
+                                      &segment != &this->_segmentList.back());
+
+    if (sent < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break; // the socket is full: next POLLOUT
+      return -1;
+    }
+    segment.offset += sent;
+    this->_size -= sent;
+    total += sent;
+    if (segment.offset == segment.end)
+      this->_popSegment();
+    else if (sent < wanted)
+      break; // short write: the socket is full
+  }
+  return total;
+}
+
+/**
+ * @brief Sends the next bytes of a segment with one system call.
+ *
+ * The bytes of a file go from the page cache to the socket with sendfile()
+ * (Linux), or are read by chunks elsewhere.
+ * @param hasMore Another segment follows: the kernel can wait for it before
+ * sending a small packet (MSG_MORE).
+ */
+ssize_t OutputQueue::_sendSegment(int socket, outputSegment_t &segment,
+                                  bool hasMore) {
+  size_t length = segment.end - segment.offset;
+  int flags = 0;
+
+#ifdef MSG_MORE
+  if (hasMore)
+    flags = MSG_MORE;
+#else
+  (void)hasMore;
+#endif
+  if (segment.fd < 0)
+    return send(socket, segment.data.data() + segment.offset, length, flags);
+
+  length = std::min(length, static_cast<size_t>(OUTPUT_CHUNK_SIZE));
+#ifdef __linux__
+  off_t offset = segment.offset;
+  ssize_t sent = sendfile(socket, segment.fd, &offset, length);
+
+  if (sent == 0)
+    errno = EIO; // the file was truncated meanwhile
+  return (sent == 0 ? -1 : sent);
+#else
+  char buffer[OUTPUT_CHUNK_SIZE];
+  ssize_t nbRead = pread(segment.fd, buffer, length, segment.offset);
+
+  if (nbRead <= 0) {
+    errno = EIO; // the file was truncated meanwhile
+    return -1;
+  }
+  return send(socket, buffer, nbRead, flags);
+#endif
+}
+
+/**
+ * @brief Removes the first segment (and closes its file).
+ */
+void OutputQueue::_popSegment() {
+  outputSegment_t &segment = this->_segmentList.front();
+
+  this->_size -= segment.end - segment.offset;
+  if (segment.fd >= 0)
+    close(segment.fd);
+  this->_segmentList.pop_front();
+}
@@ -180,6 +180,10 @@ void Parser::_getConfigAndInitServers() {
       this->_tempServerConfigMap.clear();
       this->_tempRootDirPath.clear();
       this->_nServer++;
+    } else if (this->_tokensVector[this->_nbLine].type == TK_TOKEN) {
+      // a directive outside of any server bloc is a global directive
+      this->_getGlobalParam();
+      this->_nbLine++;
     } else {
       this->_nbLine++;
     }
@@ -188,4 +192,6 @@ void Parser::_getConfigAndInitServers() {
   }
   if (this->_nServer++ == 0)
     throw std::runtime_error(ERR_NO_SERVER_CONFIG);
+
+  this->_checkGlobalParam();
 }
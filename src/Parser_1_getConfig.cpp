@@ -69,9 +69,10 @@ void Parser::_getConfigFromTokens(){
 			this->_tempLocationMapVector.push_back(this->_tempLocationConfigMap);
 			this->_tempLocationConfigMap.clear();
 		}
-		else if (this->_tokensVector[this->_nbLine].type == TK_SERVER)
+		else if (this->_tokensVector[this->_nbLine].type == TK_SERVER
+			|| this->_tokensVector[this->_nbLine].type == TK_CLOSE_BRACKET)
 		{
-			return;//end of server bloc
+			return;//end of server bloc (the directives after it are global ones)
 		}
 	}
 }
@@ -143,7 +144,7 @@ bool Parser::_isNumber(const std::string& str) {
  * and its corresponding value (`dirValue`). It verifies the directive name is valid and stores it in either
  * `_tempServerConfigMap` or `_tempLocationConfigMap`, depending on the `enumToken` type.
  *
- * @param enumToken Indicates the type of configuration expected (e.g., TK_SERVER or TK_LOCATION),
+ * @param enumToken Indicates the type of configuration expected (TK_SERVER, TK_LOCATION or TK_TOKEN for a global directive),
  *                  determining the target map for storage.
  *
  * Main steps:
@@ -179,9 +180,16 @@ void Parser::_getParamFromToken(int enumToken){
 
 	//check each directives'name
 	if (dirName != ALLOW_M && dirName != AUTOID && dirName != CGI_E && dirName != CGI_P &&
-	dirName != MAX_SIZE && dirName != ERROR_P && dirName != HOST && dirName != INDEX &&
+	dirName != MAX_SIZE && dirName != BODY_BUF && dirName != ERROR_P && dirName != HOST && dirName != INDEX &&
 	dirName != LISTEN && dirName != LOCATION && dirName != RETURN && dirName != ROOT_LOC &&
-	dirName != SERVER_N && dirName != TRY && dirName != UPLOAD && dirName != SERVER)
+	dirName != SERVER_N && dirName != TRY && dirName != UPLOAD && dirName != SERVER &&
+	dirName != EVENT_BACKEND && dirName != WORKER_T && dirName != WORKER_P &&
+	dirName != KEEPALIVE_T && dirName != KEEPALIVE_R && dirName != HEADER_T &&
+	dirName != BODY_T && dirName != SEND_T && dirName != BACKLOG &&
+	dirName != TCP_ND && dirName != TCP_DA && dirName != TCP_FO && dirName != SO_RB &&
+	dirName != SO_SB && dirName != TCP_NL && dirName != TCP_KI && dirName != TCP_KV &&
+	dirName != TCP_KC && dirName != MAX_CONN && dirName != MAX_CONN_IP && dirName != OVERLOAD &&
+	dirName != SHUTDOWN_T && dirName != HEADER_BUF)
 	{
 		throw std::runtime_error(ERR_INVALID_KEY(line));
 	}
@@ -200,6 +208,8 @@ void Parser::_getParamFromToken(int enumToken){
 	else if (enumToken == TK_LOCATION){
 		this->_tempLocationConfigMap[dirName] = dirValue;
 	}
+	else if (enumToken == TK_TOKEN)
+		this->_globalConfigMap[dirName] = dirValue;
 	dirName.clear();
 	dirValue.clear();
 }
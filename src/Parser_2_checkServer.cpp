@@ -30,7 +30,8 @@ void	Parser::_checkServerParam(){
  */
 void	Parser::_checkDirectiveName(){
 	std::string const mandatoryParam[] = {LISTEN, HOST, ROOT_LOC, INDEX, MAX_SIZE};
-	std::string const forbiddenParam[] = {ALLOW_M, AUTOID, CGI_E, CGI_P, TRY, UPLOAD};
+	std::string const forbiddenParam[] = {ALLOW_M, AUTOID, CGI_E, CGI_P, TRY, UPLOAD, EVENT_BACKEND, WORKER_T, WORKER_P, OVERLOAD, SHUTDOWN_T, HEADER_BUF};
+	size_t const nbForbiddenParam = sizeof(forbiddenParam) / sizeof(forbiddenParam[0]);
 
 	for (int i = 0; i < 5; i++)
 	{
@@ -39,7 +40,7 @@ void	Parser::_checkDirectiveName(){
 			throw std::runtime_error(ERR_SERV_DIRECTIVE_MISSING(mandatoryParam[i]));
 	}
 
-	for (int i = 0; i < 6; i++)
+	for (size_t i = 0; i < nbForbiddenParam; i++)
 	{
 		if (this->_tempServerConfigMap.find(forbiddenParam[i]) != this->_tempServerConfigMap.end())
 			throw std::runtime_error(ERR_SERV_FORBIDDEN_DIRECTIVE(forbiddenParam[i]));
@@ -84,15 +85,75 @@ void	Parser::_checkDirectiveValue(){
 		else if (it->first == MAX_SIZE) {
 			this->_checkMaxSize(it->second);
 		}
+		else if (it->first == BODY_BUF) {
+			this->_checkRange(it->first, it->second, 0, MAX_BODY_BUFFER_SIZE);
+		}
 		else if (it->first == SERVER_N) {
 			this->_checkServerN(it->second);
 		}
 		else if (it->first.find(ERROR_P) == 0) {
 			this->_checkErrorP(it->second);
 		}
+		else if (it->first == KEEPALIVE_T) {
+			this->_checkRange(it->first, it->second, 0, MAX_KEEPALIVE_TIMEOUT);
+		}
+		else if (it->first == KEEPALIVE_R) {
+			this->_checkRange(it->first, it->second, 1, MAX_KEEPALIVE_REQUESTS);
+		}
+		else if (it->first == HEADER_T || it->first == BODY_T || it->first == SEND_T) {
+			this->_checkRange(it->first, it->second, 1, MAX_CLIENT_TIMEOUT);
+		}
+		else if (it->first == BACKLOG) {
+			this->_checkRange(it->first, it->second, 1, MAX_LISTEN_BACKLOG);
+		}
+		else if (it->first == TCP_ND) {
+			this->_checkOnOff(it->first, it->second);
+		}
+		else if (it->first == TCP_DA) {
+			this->_checkRange(it->first, it->second, 0, MAX_CLIENT_TIMEOUT);
+		}
+		else if (it->first == TCP_FO) {
+			this->_checkRange(it->first, it->second, 0, MAX_TCP_FASTOPEN);
+		}
+		else if (it->first == SO_RB || it->first == SO_SB || it->first == TCP_NL) {
+			this->_checkRange(it->first, it->second, 0, MAX_SOCKET_BUFFER);
+		}
+		else if (it->first == TCP_KI || it->first == TCP_KV) {
+			this->_checkRange(it->first, it->second, 0, MAX_TCP_KEEPALIVE);
+		}
+		else if (it->first == TCP_KC) {
+			this->_checkRange(it->first, it->second, 0, MAX_TCP_KEEPCNT);
+		}
+		else if (it->first == MAX_CONN || it->first == MAX_CONN_IP) {
+			this->_checkRange(it->first, it->second, 0, MAX_CONNECTIONS);
+		}
 	}	
 }
 
+/**
+ * The function `_checkRange` checks that the value of a numeric directive is a number between
+ * `min` and `max`.
+ */
+void Parser::_checkRange(std::string const& dirName, std::string& dirValue, long min, long max) {
+	this->_delEndSemiColon(dirValue);
+
+	if (dirValue.empty() || dirValue.size() > 10 || !this->_isNumber(dirValue) ||
+		ft_stoll(dirValue) < min || ft_stoll(dirValue) > max)
+		throw std::runtime_error(ERR_NUMBER_RANGE(dirName, dirValue, min, max));
+}
+
+/**
+ * The function `_checkOnOff` checks that the value of a switch directive is "on" or "off" (in any case).
+ */
+void Parser::_checkOnOff(std::string const& dirName, std::string& dirValue) {
+	this->_delEndSemiColon(dirValue);
+
+	for (std::string::iterator it = dirValue.begin(); it != dirValue.end(); it++)
+		*it = ::tolower(*it);
+	if (dirValue != "on" && dirValue != "off")
+		throw std::runtime_error(ERR_ON_OFF(dirName, dirValue));
+}
+
 /**
  * The function `_checkRoot` removes the trailing semicolon from a string and checks if it is a valid
  * path.
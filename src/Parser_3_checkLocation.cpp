@@ -34,9 +34,17 @@ void Parser::_checkLocDirName() {
 
     // forbiden = Location parameter
     std::string const forbiddenParam[] = {LISTEN,   HOST,     ROOT_LOC, INDEX,
-                                          MAX_SIZE, SERVER_N, ERROR_P};
-
-    for (int i = 0; i < 7; i++) {
+                                          MAX_SIZE, BODY_BUF, SERVER_N, ERROR_P,
+                                          KEEPALIVE_T, KEEPALIVE_R, HEADER_T,
+                                          BODY_T, SEND_T, BACKLOG,
+                                          TCP_ND, TCP_DA, TCP_FO, SO_RB, SO_SB,
+                                          TCP_NL, TCP_KI, TCP_KV, TCP_KC,
+                                          MAX_CONN, MAX_CONN_IP, OVERLOAD, SHUTDOWN_T,
+                                          EVENT_BACKEND, WORKER_T, WORKER_P, HEADER_BUF};
+    size_t const nbForbiddenParam =
+        sizeof(forbiddenParam) / sizeof(forbiddenParam[0]);
+
+    for (size_t i = 0; i < nbForbiddenParam; i++) {
       if (this->_tempLocationConfigMap.find(forbiddenParam[i]) !=
           this->_tempLocationConfigMap.end())
         throw std::runtime_error(
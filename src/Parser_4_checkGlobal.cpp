@@ -0,0 +1,141 @@
+/**
+ * @file Parser_4_checkGlobal.cpp
+ * @brief This file containes the functions used to get and check the global
+ * directives (written outside of any 'Server' block).
+ */
+
+#include "Parser.hpp"
+
+/**
+ * The function `_getGlobalParam` puts the directive of the current token in
+ * the `_globalConfigMap`.
+ */
+void Parser::_getGlobalParam() { this->_getParamFromToken(TK_TOKEN); }
+
+/**
+ * The function `_checkGlobalParam` ensures that only global directives are
+ * written outside of the server blocks, then checks their values.
+ */
+void Parser::_checkGlobalParam() {
+  std::string const globalParam[] = {EVENT_BACKEND, WORKER_T,   WORKER_P,
+                                     MAX_CONN,      OVERLOAD,   SHUTDOWN_T,
+                                     HEADER_BUF};
+  size_t const nbGlobalParam = sizeof(globalParam) / sizeof(globalParam[0]);
+
+  for (std::map<std::string, std::string>::iterator it =
+           this->_globalConfigMap.begin();
+       it != this->_globalConfigMap.end(); ++it) {
+    if (std::find(globalParam, globalParam + nbGlobalParam, it->first) ==
+        globalParam + nbGlobalParam)
+      throw std::runtime_error(ERR_GLOBAL_FORBIDDEN_DIRECTIVE(it->first));
+
+    if (it->first == EVENT_BACKEND)
+      this->_checkEventBackend(it->second);
+    else if (it->first == WORKER_T || it->first == WORKER_P)
+      this->_checkWorkers(it->second);
+    else if (it->first == MAX_CONN)
+      this->_checkRange(it->first, it->second, 0, MAX_CONNECTIONS);
+    else if (it->first == OVERLOAD)
+      this->_checkOverload(it->second);
+    else if (it->first == SHUTDOWN_T)
+      this->_checkRange(it->first, it->second, 0, MAX_SHUTDOWN_TIMEOUT);
+    else if (it->first == HEADER_BUF)
+      this->_checkRange(it->first, it->second, MIN_HEADER_BUFFER_SIZE,
+                        MAX_HEADER_BUFFER_SIZE);
+  }
+}
+
+/**
+ * The function `_checkEventBackend` checks the name of the readiness backend
+ * used by the Service to survey the sockets.
+ */
+void Parser::_checkEventBackend(std::string &dirValue) {
+  this->_delEndSemiColon(dirValue);
+
+#ifdef __linux__
+  if (dirValue != BACKEND_AUTO && dirValue != BACKEND_POLL &&
+      dirValue != BACKEND_EPOLL && dirValue != BACKEND_URING)
+#else
+  if (dirValue != BACKEND_AUTO && dirValue != BACKEND_POLL)
+#endif
+    throw std::runtime_error(ERR_BACKEND(dirValue));
+}
+
+/**
+ * The function `_checkWorkers` checks the number of workers (threads or
+ * processes): 'auto' or a number between 1 and MAX_WORKERS.
+ */
+void Parser::_checkWorkers(std::string &dirValue) {
+  this->_delEndSemiColon(dirValue);
+
+  if (dirValue == WORKERS_AUTO)
+    return;
+  if (dirValue.empty() || dirValue.size() > 4 || !this->_isNumber(dirValue) ||
+      ft_stoll(dirValue) < 1 || ft_stoll(dirValue) > MAX_WORKERS)
+    throw std::runtime_error(ERR_WORKERS(dirValue));
+}
+
+/**
+ * The function `_checkOverload` checks what is done with the new connections
+ * once a 'max_connections' is reached: 'stop' or '503'.
+ */
+void Parser::_checkOverload(std::string &dirValue) {
+  this->_delEndSemiColon(dirValue);
+
+  if (dirValue != OVERLOAD_STOP && dirValue != OVERLOAD_503)
+    throw std::runtime_error(ERR_OVERLOAD(dirValue));
+}
+
+/**
+ * The function `_getNbWorkers` converts a checked number of workers, 'auto'
+ * means one worker per online core.
+ */
+size_t Parser::_getNbWorkers(std::string const &dirValue) {
+  if (dirValue != WORKERS_AUTO)
+    return ft_stoll(dirValue);
+
+  long nbCores = sysconf(_SC_NPROCESSORS_ONLN);
+  if (nbCores < 1)
+    return 1;
+  return std::min(nbCores, static_cast<long>(MAX_WORKERS));
+}
+
+/**
+ * @brief Getter for the global configuration.
+ *
+ * The directives which are not written in the configuration file get their
+ * default value.
+ * @return globalConfig_t
+ */
+globalConfig_t Parser::getGlobalConfig() {
+  globalConfig_t config;
+
+  config.eventBackend = DEFAULT_EVENT_BACKEND;
+  if (this->_globalConfigMap.find(EVENT_BACKEND) != this->_globalConfigMap.end())
+    config.eventBackend = this->_globalConfigMap[EVENT_BACKEND];
+
+  config.workerThreads = 1;
+  if (this->_globalConfigMap.find(WORKER_T) != this->_globalConfigMap.end())
+    config.workerThreads = this->_getNbWorkers(this->_globalConfigMap[WORKER_T]);
+
+  config.workerProcesses = 0;
+  if (this->_globalConfigMap.find(WORKER_P) != this->_globalConfigMap.end())
+    config.workerProcesses = this->_getNbWorkers(this->_globalConfigMap[WORKER_P]);
+
+  config.maxConnections = 0;
+  if (this->_globalConfigMap.find(MAX_CONN) != this->_globalConfigMap.end())
+    config.maxConnections = ft_stoll(this->_globalConfigMap[MAX_CONN]);
+
+  config.overloadAction = OVERLOAD_STOP;
+  if (this->_globalConfigMap.find(OVERLOAD) != this->_globalConfigMap.end())
+    config.overloadAction = this->_globalConfigMap[OVERLOAD];
+
+  config.shutdownTimeout = DEFAULT_SHUTDOWN_TIMEOUT;
+  if (this->_globalConfigMap.find(SHUTDOWN_T) != this->_globalConfigMap.end())
+    config.shutdownTimeout = ft_stoll(this->_globalConfigMap[SHUTDOWN_T]);
+
+  config.headerBufferSize = DEFAULT_HEADER_BUFFER_SIZE;
+  if (this->_globalConfigMap.find(HEADER_BUF) != this->_globalConfigMap.end())
+    config.headerBufferSize = ft_stoll(this->_globalConfigMap[HEADER_BUF]);
+  return config;
+}
@@ -0,0 +1,157 @@
+/**
+ * @file Poller.cpp
+ * @brief Implementation of the Poller interface, its factory and the poll() backend.
+ */
+
+#include "Poller.hpp"
+#include "utils.hpp"
+
+Poller::~Poller() {}
+
+/**
+ * @brief Getter for the sockets which reported an event during the last wait().
+ *
+ * Each entry holds the socket's fd and its events in 'revents'.
+ */
+const std::vector<pollfd> &Poller::getReadyVector() const {
+  return (this->_readyVector);
+}
+
+/**
+ * @brief The backends which only report readiness survey a listening socket
+ * as any other one.
+ */
+void Poller::addListener(int fd) { this->addFd(fd, POLLIN); }
+
+void Poller::addConnection(int fd, short events) { this->addFd(fd, events); }
+
+/**
+ * @brief Accepts a pending connection with accept().
+ * @param address Filled with the address of the client.
+ * @return int the new (non-blocking on Linux) socket, or -1 with errno
+ * (EAGAIN: no connection left).
+ */
+int Poller::accept(int fd, sockaddr_in &address) {
+  socklen_t addressLength = sizeof(address);
+
+  std::memset(&address, 0, sizeof(address));
+#ifdef __linux__
+  // the new socket is non-blocking and not inherited by the CGI processes
+  return accept4(fd, reinterpret_cast<sockaddr *>(&address), &addressLength,
+                 SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+  return ::accept(fd, reinterpret_cast<sockaddr *>(&address), &addressLength);
+#endif
+}
+
+/**
+ * @brief Reads the bytes waiting on a connection with recv().
+ * @return ssize_t the result of recv().
+ */
+ssize_t Poller::receive(int fd, char *buffer, size_t size) {
+  return recv(fd, buffer, size, 0);
+}
+
+/**
+ * @brief Instantiates the readiness backend requested by the configuration.
+ *
+ * @param backend "poll", "epoll", "io_uring" or "auto" (epoll when the system
+ * has it, poll() otherwise). io_uring falls back to epoll when the kernel (or
+ * the build) doesn't support it.
+ * @return Poller* a new backend, to delete by the caller.
+ */
+Poller *Poller::create(std::string const &backend) {
+  if (backend == BACKEND_POLL)
+    return new PollPoller();
+#ifdef __linux__
+  if (backend == BACKEND_URING) {
+# ifdef HAS_IO_URING
+    try {
+      return new UringPoller();
+    } catch (const std::exception &e) {
+      printInfo(URING_FALLBACK_MSG(e.what()), RED);
+    }
+# else
+    printInfo(URING_FALLBACK_MSG("not in the kernel headers of the build"), RED);
+# endif
+    return new EpollPoller();
+  }
+  if (backend == BACKEND_EPOLL || backend == BACKEND_AUTO)
+    return new EpollPoller();
+#else
+  if (backend == BACKEND_AUTO)
+    return new PollPoller();
+#endif
+  throw std::runtime_error(ERR_BACKEND(backend));
+}
+
+/* ************************************************************************** */
+/*                                  PollPoller                                */
+/* ************************************************************************** */
+
+PollPoller::PollPoller() {}
+
+PollPoller::~PollPoller() {}
+
+/**
+ * @brief Adds a socket at the end of the polling vector and remembers its
+ * position to find it back without a scan.
+ */
+void PollPoller::addFd(int fd, short events) {
+  pollfd pollSocket;
+
+  pollSocket.fd = fd;
+  pollSocket.events = events;
+  pollSocket.revents = 0;
+  this->_pollingFdVector.push_back(pollSocket);
+
+  if (static_cast<size_t>(fd) >= this->_indexByFd.size())
+    this->_indexByFd.resize(fd + 1, -1);
+  this->_indexByFd[fd] = this->_pollingFdVector.size() - 1;
+}
+
+void PollPoller::modifyFd(int fd, short events) {
+  if (fd < 0 || static_cast<size_t>(fd) >= this->_indexByFd.size() ||
+      this->_indexByFd[fd] < 0)
+    return;
+  this->_pollingFdVector[this->_indexByFd[fd]].events = events;
+}
+
+/**
+ * @brief Removes a socket from the polling vector.
+ *
+ * The last entry is moved in the hole, so the removal doesn't shift the vector.
+ */
+void PollPoller::removeFd(int fd) {
+  if (fd < 0 || static_cast<size_t>(fd) >= this->_indexByFd.size() ||
+      this->_indexByFd[fd] < 0)
+    return;
+
+  int index = this->_indexByFd[fd];
+  pollfd last = this->_pollingFdVector.back();
+
+  this->_pollingFdVector[index] = last;
+  this->_indexByFd[last.fd] = index;
+  this->_pollingFdVector.pop_back();
+  this->_indexByFd[fd] = -1;
+}
+
+/**
+ * @brief poll() on every registered socket, then keeps the ones with an event.
+ */
+int PollPoller::wait(int timeout) {
+  this->_readyVector.clear();
+
+  int nbReady = poll(this->_pollingFdVector.data(),
+                     this->_pollingFdVector.size(), timeout);
+  if (nbReady <= 0)
+    return nbReady;
+
+  for (size_t i = 0; i < this->_pollingFdVector.size(); i++) {
+    if (this->_pollingFdVector[i].revents)
+      this->_readyVector.push_back(this->_pollingFdVector[i]);
+  }
+  return this->_readyVector.size();
+}
+
+std::string PollPoller::getName() const { return BACKEND_POLL; }
@@ -0,0 +1,106 @@
+/**
+ * @file Poller_epoll.cpp
+ * @brief Implementation of the epoll() readiness backend (Linux only).
+ *
+ * epoll is used in level-triggered mode, so a socket which still has data to
+ * read (or room to write) is reported again at the next wait(), exactly like
+ * with poll().
+ */
+
+#include "Poller.hpp"
+
+#ifdef __linux__
+
+EpollPoller::EpollPoller() : _epollFd(epoll_create1(EPOLL_CLOEXEC)) {
+  if (this->_epollFd < 0)
+    throw std::runtime_error(ERR_EPOLL_CREATE + std::string(std::strerror(errno)));
+  this->_eventVector.resize(EPOLL_MAX_EVENTS);
+}
+
+EpollPoller::~EpollPoller() { close(this->_epollFd); }
+
+uint32_t EpollPoller::_toEpollEvents(short events) {
+  uint32_t epollEvents = 0;
+
+  if (events & POLLIN)
+    epollEvents |= EPOLLIN;
+  if (events & POLLOUT)
+    epollEvents |= EPOLLOUT;
+  return epollEvents;
+}
+
+short EpollPoller::_toPollEvents(uint32_t events) {
+  short pollEvents = 0;
+
+  if (events & EPOLLIN)
+    pollEvents |= POLLIN;
+  if (events & EPOLLOUT)
+    pollEvents |= POLLOUT;
+  if (events & EPOLLERR)
+    pollEvents |= POLLERR;
+  if (events & EPOLLHUP)
+    pollEvents |= POLLHUP;
+  return pollEvents;
+}
+
+void EpollPoller::addFd(int fd, short events) {
+  epoll_event event;
+
+  std::memset(&event, 0, sizeof(event));
+  event.events = _toEpollEvents(events);
+  event.data.fd = fd;
+  if (epoll_ctl(this->_epollFd, EPOLL_CTL_ADD, fd, &event) < 0)
+    throw std::runtime_error(ERR_EPOLL_CTL + std::string(std::strerror(errno)));
+}
+
+void EpollPoller::modifyFd(int fd, short events) {
+  epoll_event event;
+
+  std::memset(&event, 0, sizeof(event));
+  event.events = _toEpollEvents(events);
+  event.data.fd = fd;
+  if (epoll_ctl(this->_epollFd, EPOLL_CTL_MOD, fd, &event) < 0)
+    throw std::runtime_error(ERR_EPOLL_CTL + std::string(std::strerror(errno)));
+}
+
+/**
+ * @note The error is ignored: the socket may already be closed, which removes
+ * it from the epoll set anyway.
+ */
+void EpollPoller::removeFd(int fd) {
+  epoll_event event;
+
+  std::memset(&event, 0, sizeof(event));
+  epoll_ctl(this->_epollFd, EPOLL_CTL_DEL, fd, &event);
+}
+
+/**
+ * @brief epoll_wait() only returns the sockets which are ready, they are
+ * converted to pollfd entries for the Service.
+ *
+ * If the event buffer was full, it is doubled for the next call.
+ */
+int EpollPoller::wait(int timeout) {
+  this->_readyVector.clear();
+
+  int nbReady = epoll_wait(this->_epollFd, this->_eventVector.data(),
+                           this->_eventVector.size(), timeout);
+  if (nbReady <= 0)
+    return nbReady;
+
+  for (int i = 0; i < nbReady; i++) {
+    pollfd ready;
+
+    ready.fd = this->_eventVector[i].data.fd;
+    ready.events = 0;
+    ready.revents = _toPollEvents(this->_eventVector[i].events);
+    this->_readyVector.push_back(ready);
+  }
+  if (static_cast<size_t>(nbReady) == this->_eventVector.size())
+    this->_eventVector.resize(this->_eventVector.size() * 2);
+  return nbReady;
+}
+
+std::string EpollPoller::getName() const { return BACKEND_EPOLL; }
+
+#endif
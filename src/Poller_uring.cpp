@@ -0,0 +1,812 @@
+/**
+ * @file Poller_uring.cpp
+ * @brief Implementation of the io_uring backend (Linux >= 5.11, multishot
+ * accept and recv with Linux >= 6.0).
+ *
+ * The rings are set up with the raw system calls (no liburing): the
+ * submission ring, the completion ring and the submission entries are shared
+ * with the kernel through mmap(). The heads and tails are read and written
+ * with acquire / release atomics, as the kernel expects.
+ *
+ * Each request is tagged with `fd | kind << 32 | generation << 40`, the kind
+ * being a poll, an accept or a recv request:
+ * - a socket surveyed by poll has one IORING_OP_POLL_ADD request in flight.
+ *   When its events change, the request is cancelled (IORING_OP_POLL_REMOVE)
+ *   and its generation incremented, so a completion of the previous request
+ *   is recognised and ignored.
+ * - a listening socket has one multishot IORING_OP_ACCEPT request, which
+ *   completes once per accepted connection. The connections wait in a queue
+ *   until the Service takes them with accept().
+ * - a connection has one multishot IORING_OP_RECV request, which completes
+ *   once per buffer received: the kernel takes the buffers from a ring
+ *   registered at setup (IORING_REGISTER_PBUF_RING), they are given back once
+ *   the Service took their bytes with receive(). The request is stopped
+ *   (IORING_OP_ASYNC_CANCEL) when the Service no longer reads the connection,
+ *   or holds too many buffers, and submitted again afterwards.
+ * The generation of these accept and recv requests only changes when the
+ * socket is removed: a late completion for a closed socket is dropped (its
+ * buffer given back, its accepted connection closed).
+ *
+ * The completions are only recorded when they are reaped: the requests are
+ * queued when the sockets are armed again, at the beginning of the next
+ * wait().
+ */
+
+#include "Poller.hpp"
+
+#ifdef HAS_IO_URING
+
+#define URING_IGNORED	(~static_cast<uint64_t>(0)) ///< user_data of the requests whose completion is ignored.
+#define URING_POLL		0 ///< Kind of a poll request.
+#define URING_ACCEPT	1 ///< Kind of a multishot accept request.
+#define URING_RECV		2 ///< Kind of a multishot recv request.
+#define URING_EOF		1 ///< End of the bytes of a connection closed by the client.
+
+/**
+ * @brief Tags a request with its socket, its kind and its generation (24
+ * bits, enough to tell the request in flight from the previous ones).
+ */
+static uint64_t _userData(int fd, unsigned kind, unsigned generation) {
+  return static_cast<uint64_t>(static_cast<unsigned>(fd)) |
+         (static_cast<uint64_t>(kind) << 32) |
+         (static_cast<uint64_t>(generation & 0xffffffU) << 40);
+}
+
+UringPoller::UringPoller()
+    : _ringFd(-1), _sqRing(MAP_FAILED), _sqRingSize(0), _cqRing(MAP_FAILED),
+      _cqRingSize(0), _sqes(static_cast<io_uring_sqe *>(MAP_FAILED)),
+      _sqesSize(0), _sqLocalTail(0), _hasMultishotAccept(false),
+      _hasMultishotRecv(false), _bufferRing(NULL), _bufferTail(0),
+      _nbFreeBuffers(0) {
+  io_uring_params params;
+
+  std::memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+  params.cq_entries = URING_CQ_ENTRIES;
+  this->_ringFd = static_cast<int>(
+      syscall(__NR_io_uring_setup, URING_SQ_ENTRIES, &params));
+  if (this->_ringFd < 0)
+    throw std::runtime_error(ERR_URING_SETUP + std::string(std::strerror(errno)));
+  if (!(params.features & IORING_FEAT_EXT_ARG) ||
+      !(params.features & IORING_FEAT_NODROP)) {
+    close(this->_ringFd);
+    throw std::runtime_error(ERR_URING_FEATURES);
+  }
+
+  this->_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  this->_cqRingSize =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+    this->_sqRingSize = this->_cqRingSize =
+        std::max(this->_sqRingSize, this->_cqRingSize);
+  this->_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+  this->_sqRing = mmap(NULL, this->_sqRingSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, this->_ringFd,
+                       IORING_OFF_SQ_RING);
+  if (this->_sqRing != MAP_FAILED) {
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+      this->_cqRing = this->_sqRing;
+    else
+      this->_cqRing = mmap(NULL, this->_cqRingSize, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, this->_ringFd,
+                           IORING_OFF_CQ_RING);
+  }
+  if (this->_cqRing != MAP_FAILED)
+    this->_sqes = static_cast<io_uring_sqe *>(
+        mmap(NULL, this->_sqesSize, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, this->_ringFd, IORING_OFF_SQES));
+  if (this->_sqes == MAP_FAILED) {
+    int error = errno;
+
+    this->_unmapRings();
+    close(this->_ringFd);
+    throw std::runtime_error(ERR_URING_MMAP + std::string(std::strerror(error)));
+  }
+
+  char *sq = static_cast<char *>(this->_sqRing);
+  char *cq = static_cast<char *>(this->_cqRing);
+
+  this->_sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  this->_sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  this->_sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  this->_sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  this->_sqEntries = params.sq_entries;
+  this->_sqLocalTail = *this->_sqTail;
+  this->_cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  this->_cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  this->_cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  this->_cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+  this->_setupBufferRing();
+}
+
+/**
+ * @note Closing the ring cancels the requests still in flight (and releases
+ * the buffer ring). The connections accepted but not taken are closed.
+ */
+UringPoller::~UringPoller() {
+  for (std::map<int, std::deque<int> >::iterator it =
+           this->_acceptedByFd.begin();
+       it != this->_acceptedByFd.end(); ++it)
+    for (size_t i = 0; i < it->second.size(); i++)
+      if (it->second[i] >= 0)
+        close(it->second[i]);
+  this->_unmapRings();
+  close(this->_ringFd);
+  if (this->_bufferRing != NULL)
+    munmap(this->_bufferRing, URING_RECV_BUFFERS * sizeof(io_uring_buf));
+}
+
+void UringPoller::_unmapRings() {
+  if (this->_sqes != MAP_FAILED)
+    munmap(this->_sqes, this->_sqesSize);
+  if (this->_cqRing != MAP_FAILED && this->_cqRing != this->_sqRing)
+    munmap(this->_cqRing, this->_cqRingSize);
+  if (this->_sqRing != MAP_FAILED)
+    munmap(this->_sqRing, this->_sqRingSize);
+}
+
+/**
+ * @brief Registers the ring of receive buffers, and gives it every buffer.
+ *
+ * The kernels which have it (Linux >= 5.19) also have the multishot accept.
+ * Without it (or without multishot recv, Linux >= 6.0, see _reapStream()),
+ * the sockets are surveyed by poll requests only.
+ */
+void UringPoller::_setupBufferRing() {
+#ifdef HAS_URING_MULTISHOT
+  size_t ringSize = URING_RECV_BUFFERS * sizeof(io_uring_buf);
+  void *ring = mmap(NULL, ringSize, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (ring == MAP_FAILED)
+    return;
+
+  io_uring_buf_reg registration;
+
+  std::memset(&registration, 0, sizeof(registration));
+  registration.ring_addr = reinterpret_cast<uint64_t>(ring);
+  registration.ring_entries = URING_RECV_BUFFERS;
+  registration.bgid = 0;
+  if (syscall(__NR_io_uring_register, this->_ringFd,
+              IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+    munmap(ring, ringSize);
+    return;
+  }
+  this->_bufferRing = ring;
+  this->_hasMultishotAccept = true;
+  this->_hasMultishotRecv = true;
+  this->_bufferVector.resize(URING_RECV_BUFFERS * URING_RECV_BUFFER_SIZE);
+  this->_nextBuffer.resize(URING_RECV_BUFFERS, -1);
+  this->_bufferLength.resize(URING_RECV_BUFFERS, 0);
+  this->_bufferOffset.resize(URING_RECV_BUFFERS, 0);
+  for (int bufferID = 0; bufferID < URING_RECV_BUFFERS; bufferID++)
+    this->_provideBuffer(bufferID);
+#endif
+}
+
+/**
+ * @brief Gives a buffer (back) to the kernel, at the tail of the buffer ring.
+ */
+void UringPoller::_provideBuffer(int bufferID) {
+#ifdef HAS_URING_MULTISHOT
+  io_uring_buf *ring = static_cast<io_uring_buf *>(this->_bufferRing);
+  io_uring_buf &entry = ring[this->_bufferTail & (URING_RECV_BUFFERS - 1)];
+
+  entry.addr = reinterpret_cast<uint64_t>(
+      &this->_bufferVector[bufferID * URING_RECV_BUFFER_SIZE]);
+  entry.len = URING_RECV_BUFFER_SIZE;
+  entry.bid = static_cast<unsigned short>(bufferID);
+  this->_nextBuffer[bufferID] = -1;
+  this->_bufferLength[bufferID] = 0;
+  this->_bufferOffset[bufferID] = 0;
+  this->_bufferTail++;
+  // the tail of the ring overlays the last field of its first entry
+  __atomic_store_n(&ring[0].resv, this->_bufferTail, __ATOMIC_RELEASE);
+  this->_nbFreeBuffers++;
+#else
+  (void)bufferID;
+#endif
+}
+
+/**
+ * @brief Takes a free submission entry. When the ring is full, the queued
+ * entries are submitted first (the completions are reaped if the kernel asks
+ * for it): an entry the kernel did not take is never handed out again.
+ * @return io_uring_sqe* a zeroed entry, published by the next io_uring_enter().
+ * @throws std::runtime_error if the kernel takes no entry at all.
+ */
+io_uring_sqe *UringPoller::_getSqe() {
+  while (this->_sqLocalTail -
+             __atomic_load_n(this->_sqHead, __ATOMIC_ACQUIRE) >=
+         this->_sqEntries) {
+    unsigned head = __atomic_load_n(this->_sqHead, __ATOMIC_ACQUIRE);
+
+    this->_submit();
+    if (__atomic_load_n(this->_sqHead, __ATOMIC_ACQUIRE) == head)
+      throw std::runtime_error(ERR_URING_FULL);
+  }
+
+  unsigned index = this->_sqLocalTail & this->_sqMask;
+  io_uring_sqe *sqe = &this->_sqes[index];
+
+  std::memset(sqe, 0, sizeof(*sqe));
+  this->_sqArray[index] = index;
+  this->_sqLocalTail++;
+  return sqe;
+}
+
+/**
+ * @brief Queues the poll request of a socket, with its surveyed events.
+ */
+void UringPoller::_queuePoll(int fd) {
+  io_uring_sqe *sqe = this->_getSqe();
+
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = static_cast<unsigned short>(this->_pollEvents(fd));
+  sqe->user_data = _userData(fd, URING_POLL, this->_generationByFd[fd]);
+  this->_armedByFd[fd] = true;
+}
+
+/**
+ * @brief Queues the cancellation of the poll request of a socket, if one is in
+ * flight. Its completion, if any, belongs to an older generation.
+ */
+void UringPoller::_queueRemove(int fd) {
+  if (!this->_armedByFd[fd])
+    return;
+
+  io_uring_sqe *sqe = this->_getSqe();
+
+  sqe->opcode = IORING_OP_POLL_REMOVE;
+  sqe->fd = -1;
+  sqe->addr = _userData(fd, URING_POLL, this->_generationByFd[fd]);
+  sqe->user_data = URING_IGNORED;
+  this->_armedByFd[fd] = false;
+  this->_generationByFd[fd]++;
+}
+
+/**
+ * @brief Queues the multishot accept request of a listening socket, or the
+ * multishot recv request of a connection.
+ */
+void UringPoller::_queueStream(int fd) {
+  io_uring_sqe *sqe = this->_getSqe();
+
+  sqe->fd = fd;
+#ifdef HAS_URING_MULTISHOT
+  if (this->_modeByFd[fd] == MODE_LISTENER) {
+    // the accepted sockets are non-blocking and not inherited by the CGIs
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data =
+        _userData(fd, URING_ACCEPT, this->_streamGenerationByFd[fd]);
+  } else {
+    // len 0: each completion fills at most one buffer of the ring
+    sqe->opcode = IORING_OP_RECV;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = _userData(fd, URING_RECV, this->_streamGenerationByFd[fd]);
+  }
+#endif
+  this->_streamByFd[fd] = STREAM_ARMED;
+}
+
+/**
+ * @brief Queues the cancellation of the accept or recv request of a socket.
+ * Its last completion (-ECANCELED) marks it idle again.
+ */
+void UringPoller::_queueCancel(int fd) {
+  io_uring_sqe *sqe = this->_getSqe();
+  unsigned kind =
+      (this->_modeByFd[fd] == MODE_LISTENER) ? URING_ACCEPT : URING_RECV;
+
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = _userData(fd, kind, this->_streamGenerationByFd[fd]);
+  sqe->user_data = URING_IGNORED;
+  this->_streamByFd[fd] = STREAM_CANCELLING;
+}
+
+/**
+ * @brief Brings the requests of a socket in line with its surveyed events: a
+ * poll request for the events not handled by an accept or recv request, and
+ * that request while the Service reads the socket, and while it does not hold
+ * too many connections (a batch) or buffers, nor the end of its bytes.
+ */
+void UringPoller::_arm(int fd) {
+  short events = this->_eventsByFd[fd];
+
+  if (this->_pollEvents(fd) != 0 && !this->_armedByFd[fd])
+    this->_queuePoll(fd);
+  if (this->_modeByFd[fd] != MODE_POLL) {
+    bool isWanted = (events & POLLIN) != 0;
+
+    if (this->_modeByFd[fd] == MODE_LISTENER)
+      isWanted = isWanted && this->_acceptedByFd[fd].size() < static_cast<size_t>(ACCEPT_BATCH);
+    else
+      isWanted = isWanted && this->_recvEndByFd[fd] == 0 &&
+                 this->_nbBuffersByFd[fd] < URING_RECV_MAX_BUFFERS;
+    if (isWanted && this->_streamByFd[fd] == STREAM_IDLE) {
+      if (this->_modeByFd[fd] == MODE_CONNECTION && this->_nbFreeBuffers == 0)
+        this->_starvedVector.push_back(fd);
+      else
+        this->_queueStream(fd);
+    } else if (!isWanted && this->_streamByFd[fd] == STREAM_ARMED)
+      this->_queueCancel(fd);
+  }
+  if ((events & POLLIN) && this->_hasInput(fd))
+    this->_listReport(fd);
+}
+
+/**
+ * @brief Publishes the queued submission entries and submits them, then waits
+ * for completions.
+ * @param minComplete The number of completions to wait for (0 to return at
+ * once).
+ * @param timeout The maximum wait, in milliseconds (-1 for no limit).
+ * @return int the result of io_uring_enter() (-1 with errno on error).
+ */
+int UringPoller::_enter(unsigned minComplete, int timeout) {
+  io_uring_getevents_arg arg;
+  __kernel_timespec ts;
+  unsigned flags = IORING_ENTER_EXT_ARG;
+
+  __atomic_store_n(this->_sqTail, this->_sqLocalTail, __ATOMIC_RELEASE);
+  std::memset(&arg, 0, sizeof(arg));
+  if (timeout >= 0) {
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000L;
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+  }
+  if (minComplete > 0)
+    flags |= IORING_ENTER_GETEVENTS;
+
+  unsigned toSubmit =
+      this->_sqLocalTail - __atomic_load_n(this->_sqHead, __ATOMIC_ACQUIRE);
+  long result = syscall(__NR_io_uring_enter, this->_ringFd, toSubmit,
+                        minComplete, flags, &arg, sizeof(arg));
+  if (result < 0 && errno != EINTR && errno != ETIME && errno != EBUSY)
+    throw std::runtime_error(ERR_URING_ENTER + std::string(std::strerror(errno)));
+  return static_cast<int>(result);
+}
+
+/**
+ * @brief Submits the queued entries without waiting. EBUSY means the
+ * completion ring overflowed: its completions are reaped before trying again.
+ */
+void UringPoller::_submit() {
+  while (this->_enter(0, 0) < 0) {
+    if (errno == EBUSY) {
+      if (this->_reapCompletions() == 0)
+        return;
+    } else if (errno != EINTR)
+      return;
+  }
+}
+
+/**
+ * @brief Records the completions: the events reported by the poll requests,
+ * the connections accepted and the buffers received. No request is queued
+ * here, the sockets to arm again are listed for the next wait().
+ * @return unsigned the number of completions reaped.
+ */
+unsigned UringPoller::_reapCompletions() {
+  unsigned head = *this->_cqHead;
+  unsigned tail = __atomic_load_n(this->_cqTail, __ATOMIC_ACQUIRE);
+  unsigned nbReaped = tail - head;
+
+  for (; head != tail; head++) {
+    io_uring_cqe const &cqe = this->_cqes[head & this->_cqMask];
+
+    if (cqe.user_data == URING_IGNORED)
+      continue;
+
+    int fd = static_cast<int>(cqe.user_data & 0xffffffffU);
+    unsigned kind = static_cast<unsigned>((cqe.user_data >> 32) & 0xff);
+    unsigned generation = static_cast<unsigned>(cqe.user_data >> 40);
+
+    if (kind == URING_POLL)
+      this->_reapPoll(fd, generation, cqe.res);
+    else
+      this->_reapStream(fd, kind, generation, cqe.res, cqe.flags);
+  }
+  __atomic_store_n(this->_cqHead, head, __ATOMIC_RELEASE);
+  return nbReaped;
+}
+
+/**
+ * @brief Records the events reported by a poll request (an error if the
+ * socket is no longer valid), unless the request was replaced since.
+ */
+void UringPoller::_reapPoll(int fd, unsigned generation, int result) {
+  if (static_cast<size_t>(fd) >= this->_eventsByFd.size() ||
+      generation != (this->_generationByFd[fd] & 0xffffffU) ||
+      !this->_armedByFd[fd])
+    return;
+  this->_armedByFd[fd] = false;
+  this->_reventsByFd[fd] |=
+      (result < 0) ? static_cast<short>(POLLERR)
+                   : static_cast<short>(result & (POLLIN | POLLOUT | POLLERR |
+                                                  POLLHUP | POLLNVAL));
+  this->_listReport(fd);
+  this->_rearmVector.push_back(fd);
+}
+
+/**
+ * @brief Records a completion of an accept or recv request.
+ *
+ * A completion for a removed socket is dropped: its buffer goes back to the
+ * ring, its accepted connection is closed. Without IORING_CQE_F_MORE, the
+ * request is over (cancelled, failed or short of buffers) and the socket is
+ * armed again at the next wait(). A kernel without the multishot request
+ * (EINVAL) has the socket surveyed by poll instead.
+ */
+void UringPoller::_reapStream(int fd, unsigned kind, unsigned generation,
+                              int result, unsigned flags) {
+  bool isCurrent = static_cast<size_t>(fd) < this->_eventsByFd.size() &&
+                   generation == (this->_streamGenerationByFd[fd] & 0xffffffU);
+  int bufferID = -1;
+
+#ifdef HAS_URING_MULTISHOT
+  if (kind == URING_RECV && (flags & IORING_CQE_F_BUFFER)) {
+    bufferID = static_cast<int>(flags >> IORING_CQE_BUFFER_SHIFT);
+    this->_nbFreeBuffers--;
+  }
+  if (!isCurrent || result <= 0 || kind != URING_RECV) {
+    if (bufferID >= 0)
+      this->_provideBuffer(bufferID);
+    bufferID = -1;
+  }
+  if (!isCurrent) {
+    if (kind == URING_ACCEPT && result >= 0)
+      close(result);
+    return;
+  }
+  if (!(flags & IORING_CQE_F_MORE)) {
+    this->_streamByFd[fd] = STREAM_IDLE;
+    this->_rearmVector.push_back(fd);
+  }
+#else
+  (void)flags;
+  if (!isCurrent)
+    return;
+#endif
+  if (result == -ECANCELED)
+    return;
+  if (result == -EINVAL) {
+    if (kind == URING_ACCEPT)
+      this->_hasMultishotAccept = false;
+    else
+      this->_hasMultishotRecv = false;
+    this->_modeByFd[fd] = MODE_POLL;
+    return;
+  }
+  if (kind == URING_ACCEPT) {
+    this->_acceptedByFd[fd].push_back(result);
+    if (this->_acceptedByFd[fd].size() >= static_cast<size_t>(ACCEPT_BATCH))
+      this->_rearmVector.push_back(fd);
+  } else if (bufferID >= 0) {
+    this->_bufferLength[bufferID] = static_cast<unsigned>(result);
+    if (this->_lastBufferByFd[fd] >= 0)
+      this->_nextBuffer[this->_lastBufferByFd[fd]] = bufferID;
+    else
+      this->_firstBufferByFd[fd] = bufferID;
+    this->_lastBufferByFd[fd] = bufferID;
+    if (++this->_nbBuffersByFd[fd] >= URING_RECV_MAX_BUFFERS)
+      this->_rearmVector.push_back(fd);
+  } else if (result == -ENOBUFS) {
+    this->_starvedVector.push_back(fd);
+    return;
+  } else if (this->_recvEndByFd[fd] == 0)
+    this->_recvEndByFd[fd] = (result == 0) ? URING_EOF : result;
+  this->_listReport(fd);
+}
+
+void UringPoller::_listReport(int fd) {
+  if (this->_isListedByFd[fd])
+    return;
+  this->_isListedByFd[fd] = true;
+  this->_reportVector.push_back(fd);
+}
+
+/**
+ * @brief Tells if a socket has connections accepted or bytes received (or
+ * their end) that the Service did not take yet.
+ */
+bool UringPoller::_hasInput(int fd) const {
+  if (this->_firstBufferByFd[fd] >= 0 || this->_recvEndByFd[fd] != 0)
+    return true;
+
+  std::map<int, std::deque<int> >::const_iterator it =
+      this->_acceptedByFd.find(fd);
+
+  return it != this->_acceptedByFd.end() && !it->second.empty();
+}
+
+/**
+ * @brief The events surveyed by the poll request of a socket: POLLIN is left
+ * to the accept or recv request, if the socket has one.
+ */
+short UringPoller::_pollEvents(int fd) const {
+  if (this->_modeByFd[fd] == MODE_POLL)
+    return this->_eventsByFd[fd];
+  return this->_eventsByFd[fd] & ~POLLIN;
+}
+
+/**
+ * @brief Forgets what a removed socket received: its buffers go back to the
+ * ring, the connections it accepted are closed.
+ */
+void UringPoller::_dropInput(int fd) {
+  for (int bufferID = this->_firstBufferByFd[fd]; bufferID >= 0;) {
+    int next = this->_nextBuffer[bufferID];
+
+    this->_provideBuffer(bufferID);
+    bufferID = next;
+  }
+  this->_firstBufferByFd[fd] = -1;
+  this->_lastBufferByFd[fd] = -1;
+  this->_nbBuffersByFd[fd] = 0;
+  this->_recvEndByFd[fd] = 0;
+
+  std::map<int, std::deque<int> >::iterator it = this->_acceptedByFd.find(fd);
+
+  if (it == this->_acceptedByFd.end())
+    return;
+  for (size_t i = 0; i < it->second.size(); i++)
+    if (it->second[i] >= 0)
+      close(it->second[i]);
+  this->_acceptedByFd.erase(it);
+}
+
+void UringPoller::_growFdTables(int fd) {
+  if (static_cast<size_t>(fd) < this->_eventsByFd.size())
+    return;
+
+  size_t size = std::max(static_cast<size_t>(fd) + 1,
+                         this->_eventsByFd.size() * 2);
+
+  this->_eventsByFd.resize(size, 0);
+  this->_modeByFd.resize(size, MODE_POLL);
+  this->_armedByFd.resize(size, false);
+  this->_generationByFd.resize(size, 0);
+  this->_streamByFd.resize(size, STREAM_IDLE);
+  this->_streamGenerationByFd.resize(size, 0);
+  this->_reventsByFd.resize(size, 0);
+  this->_isListedByFd.resize(size, false);
+  this->_firstBufferByFd.resize(size, -1);
+  this->_lastBufferByFd.resize(size, -1);
+  this->_nbBuffersByFd.resize(size, 0);
+  this->_recvEndByFd.resize(size, 0);
+}
+
+/**
+ * @brief Surveys a socket: its poll request is submitted with the next wait().
+ */
+void UringPoller::addFd(int fd, short events) {
+  this->_growFdTables(fd);
+  this->_eventsByFd[fd] = events;
+  this->_modeByFd[fd] = MODE_POLL;
+  this->_rearmVector.push_back(fd);
+}
+
+/**
+ * @brief Surveys a listening socket: it accepts the connections itself with a
+ * multishot accept request, if the kernel has it.
+ */
+void UringPoller::addListener(int fd) {
+  this->addFd(fd, POLLIN);
+  if (this->_hasMultishotAccept)
+    this->_modeByFd[fd] = MODE_LISTENER;
+}
+
+/**
+ * @brief Surveys a connection: it receives into the buffer ring with a
+ * multishot recv request, if the kernel has it.
+ */
+void UringPoller::addConnection(int fd, short events) {
+  this->addFd(fd, events);
+  if (this->_hasMultishotRecv)
+    this->_modeByFd[fd] = MODE_CONNECTION;
+}
+
+/**
+ * @brief Changes the events of a socket: its poll request is replaced if its
+ * events changed, its accept or recv request is started or stopped at the
+ * next wait().
+ */
+void UringPoller::modifyFd(int fd, short events) {
+  if (fd < 0 || static_cast<size_t>(fd) >= this->_eventsByFd.size())
+    return;
+
+  short pollEvents = this->_pollEvents(fd);
+
+  this->_eventsByFd[fd] = events;
+  if (this->_pollEvents(fd) != pollEvents)
+    this->_queueRemove(fd);
+  this->_rearmVector.push_back(fd);
+}
+
+/**
+ * @note A request in flight holds a reference on the socket: its cancellation
+ * is submitted at once, so the close() which follows really closes the socket
+ * (a listening socket closed by a graceful shutdown must stop accepting even
+ * if its event loop stops waiting).
+ */
+void UringPoller::removeFd(int fd) {
+  if (fd < 0 || static_cast<size_t>(fd) >= this->_eventsByFd.size())
+    return;
+  this->_eventsByFd[fd] = 0;
+  this->_reventsByFd[fd] = 0;
+  if (this->_streamByFd[fd] == STREAM_ARMED)
+    this->_queueCancel(fd);
+  this->_streamByFd[fd] = STREAM_IDLE;
+  this->_streamGenerationByFd[fd]++;
+  this->_dropInput(fd);
+  this->_queueRemove(fd);
+  this->_modeByFd[fd] = MODE_POLL;
+  if (this->_sqLocalTail != __atomic_load_n(this->_sqHead, __ATOMIC_ACQUIRE))
+    this->_submit();
+}
+
+/**
+ * @brief Takes a connection accepted by the multishot accept request of a
+ * listening socket (accept4() for a socket surveyed by poll).
+ * @return int the new socket, or -1 with errno (EAGAIN: none left).
+ */
+int UringPoller::accept(int fd, sockaddr_in &address) {
+  bool isListener = fd >= 0 &&
+                    static_cast<size_t>(fd) < this->_modeByFd.size() &&
+                    this->_modeByFd[fd] == MODE_LISTENER;
+
+  // the connections accepted since the last wait() are taken at once
+  if (isListener && this->_acceptedByFd[fd].empty())
+    this->_reapCompletions();
+
+  std::map<int, std::deque<int> >::iterator it = this->_acceptedByFd.find(fd);
+
+  if (it == this->_acceptedByFd.end() || it->second.empty()) {
+    if (isListener) {
+      errno = EAGAIN;
+      return -1;
+    }
+    return Poller::accept(fd, address);
+  }
+
+  int socket = it->second.front();
+  socklen_t addressLength = sizeof(address);
+
+  it->second.pop_front();
+  // an accept request stopped for holding too many connections can start again
+  if (this->_streamByFd[fd] == STREAM_IDLE)
+    this->_rearmVector.push_back(fd);
+  std::memset(&address, 0, sizeof(address));
+  if (socket < 0) {
+    errno = -socket;
+    return -1;
+  }
+  getpeername(socket, reinterpret_cast<sockaddr *>(&address), &addressLength);
+  return socket;
+}
+
+/**
+ * @brief Copies the bytes received by the multishot recv request of a
+ * connection, and gives the emptied buffers back to the kernel (recv() for a
+ * socket surveyed by poll).
+ * @return ssize_t the number of bytes copied, 0 if the client closed the
+ * connection, -1 with errno (EAGAIN: nothing received yet).
+ */
+ssize_t UringPoller::receive(int fd, char *buffer, size_t size) {
+  if (fd < 0 || static_cast<size_t>(fd) >= this->_eventsByFd.size())
+    return Poller::receive(fd, buffer, size);
+
+  int bufferID = this->_firstBufferByFd[fd];
+
+  if (bufferID < 0) {
+    if (this->_recvEndByFd[fd] == URING_EOF)
+      return 0;
+    if (this->_recvEndByFd[fd] < 0) {
+      errno = -this->_recvEndByFd[fd];
+      return -1;
+    }
+    if (this->_modeByFd[fd] != MODE_CONNECTION)
+      return Poller::receive(fd, buffer, size);
+    errno = EAGAIN;
+    return -1;
+  }
+
+  size_t copied = 0;
+
+  while (bufferID >= 0 && copied < size) {
+    size_t length = std::min(size - copied,
+                             static_cast<size_t>(this->_bufferLength[bufferID] -
+                                                 this->_bufferOffset[bufferID]));
+
+    std::memcpy(buffer + copied,
+                &this->_bufferVector[bufferID * URING_RECV_BUFFER_SIZE +
+                                     this->_bufferOffset[bufferID]],
+                length);
+    copied += length;
+    this->_bufferOffset[bufferID] += length;
+    if (this->_bufferOffset[bufferID] < this->_bufferLength[bufferID])
+      break;
+
+    int next = this->_nextBuffer[bufferID];
+
+    this->_provideBuffer(bufferID);
+    this->_nbBuffersByFd[fd]--;
+    bufferID = next;
+  }
+  this->_firstBufferByFd[fd] = bufferID;
+  if (bufferID < 0)
+    this->_lastBufferByFd[fd] = -1;
+  // a recv request stopped for holding too many buffers can start again
+  if (this->_streamByFd[fd] == STREAM_IDLE)
+    this->_rearmVector.push_back(fd);
+  return copied;
+}
+
+/**
+ * @brief Arms again the sockets reported by the previous wait() (and the ones
+ * added or modified since), submits everything with a single io_uring_enter()
+ * which also waits, then converts the completions to pollfd entries.
+ *
+ * A socket whose accepted connections or received bytes were not all taken
+ * is reported again, without waiting.
+ */
+int UringPoller::wait(int timeout) {
+  for (size_t i = 0; i < this->_readyVector.size(); i++) {
+    int fd = this->_readyVector[i].fd;
+
+    if ((this->_eventsByFd[fd] & POLLIN) && this->_hasInput(fd))
+      this->_listReport(fd);
+  }
+  this->_readyVector.clear();
+
+  if (!this->_starvedVector.empty() && this->_nbFreeBuffers > 0) {
+    this->_rearmVector.insert(this->_rearmVector.end(),
+                              this->_starvedVector.begin(),
+                              this->_starvedVector.end());
+    this->_starvedVector.clear();
+  }
+  // the completions reaped when the ring is full may add sockets to arm
+  for (size_t i = 0; i < this->_rearmVector.size(); i++)
+    this->_arm(this->_rearmVector[i]);
+  this->_rearmVector.clear();
+
+  if (!this->_reportVector.empty())
+    timeout = 0;
+
+  int result = this->_enter(timeout == 0 ? 0 : 1, timeout);
+  int error = errno;
+
+  this->_reapCompletions();
+  for (size_t i = 0; i < this->_reportVector.size(); i++) {
+    int fd = this->_reportVector[i];
+    pollfd ready;
+
+    this->_isListedByFd[fd] = false;
+    ready.fd = fd;
+    ready.events = 0;
+    ready.revents = this->_reventsByFd[fd];
+    this->_reventsByFd[fd] = 0;
+    if ((this->_eventsByFd[fd] & POLLIN) && this->_hasInput(fd))
+      ready.revents |= POLLIN;
+    if (ready.revents != 0)
+      this->_readyVector.push_back(ready);
+  }
+  this->_reportVector.clear();
+  if (this->_readyVector.empty() && result < 0 && error == EINTR) {
+    errno = EINTR;
+    return -1;
+  }
+  return this->_readyVector.size();
+}
+
+std::string UringPoller::getName() const { return BACKEND_URING; }
+
+#endif
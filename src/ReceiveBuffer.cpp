@@ -0,0 +1,82 @@
+/**
+ * @file ReceiveBuffer.cpp
+ * @brief Implementation of the receive buffer of a client's connection.
+ */
+
+#include "ReceiveBuffer.hpp"
+
+ReceiveBuffer::ReceiveBuffer(BufferPool &pool)
+    : _pool(&pool), _data(NULL), _size(0) {}
+
+ReceiveBuffer::~ReceiveBuffer() { this->clear(); }
+
+/**
+ * @brief Reads the bytes waiting on the socket, after the ones already in the
+ * buffer (no copy with recv()). A buffer is taken from the pool first if
+ * needed.
+ * @param poller Backend of the event loop: recv(), or the bytes its kernel
+ * requests already received.
+ * @return ssize_t the result of recv(): the number of bytes read, 0 if the
+ * client closed the connection, -1 on error (ENOBUFS if the buffer is full).
+ */
+ssize_t ReceiveBuffer::receive(Poller &poller, int socket) {
+  if (this->_data == NULL)
+    this->_data = this->_pool->acquire();
+  if (this->isFull()) {
+    errno = ENOBUFS;
+    return -1;
+  }
+
+  ssize_t bytes = poller.receive(socket, this->_data + this->_size,
+                                 this->_pool->getBufferSize() - this->_size);
+
+  if (bytes > 0)
+    this->_size += bytes;
+  else if (this->_size == 0)
+    this->clear();
+  return bytes;
+}
+
+/**
+ * @brief Getter for the bytes received (NULL if the buffer is empty).
+ */
+const char *ReceiveBuffer::data() const { return (this->_data); }
+
+size_t ReceiveBuffer::size() const { return (this->_size); }
+
+bool ReceiveBuffer::empty() const { return (this->_size == 0); }
+
+/**
+ * @brief Checks if the buffer can't take more bytes before some are handled.
+ */
+bool ReceiveBuffer::isFull() const {
+  return (this->_data != NULL && this->_size == this->_pool->getBufferSize());
+}
+
+char ReceiveBuffer::operator[](size_t pos) const { return (this->_data[pos]); }
+
+std::string ReceiveBuffer::substr(size_t pos, size_t length) const {
+  return std::string(this->_data + pos, length);
+}
+
+/**
+ * @brief Removes bytes (handled, or moved elsewhere), the ones after them are
+ * moved back. The buffer goes back to the pool if it is empty.
+ */
+void ReceiveBuffer::erase(size_t pos, size_t length) {
+  length = std::min(length, this->_size - pos);
+  std::memmove(this->_data + pos, this->_data + pos + length,
+               this->_size - pos - length);
+  this->_size -= length;
+  if (this->_size == 0)
+    this->clear();
+}
+
+/**
+ * @brief Empties the buffer and gives it back to the pool.
+ */
+void ReceiveBuffer::clear() {
+  this->_pool->release(this->_data);
+  this->_data = NULL;
+  this->_size = 0;
+}
@@ -0,0 +1,162 @@
+/**
+ * @file RequestBody.cpp
+ * @brief Implementation of the request body, in memory or in a temporary
+ * file.
+ */
+
+#include "RequestBody.hpp"
+#include <sys/mman.h>
+
+RequestBody::RequestBody()
+    : _fd(-1), _size(0), _bufferSize(DEFAULT_BODY_BUFFER_SIZE), _map(NULL) {}
+
+RequestBody::~RequestBody() { this->reset(0); }
+
+/**
+ * @brief Drops the body (the temporary file is closed, so deleted) and gets
+ * ready for the body of the next request.
+ * @param bufferSize The 'client_body_buffer_size' of the server.
+ */
+void RequestBody::reset(size_t bufferSize) {
+  this->_unmap();
+  if (this->_fd >= 0)
+    close(this->_fd);
+  this->_fd = -1;
+  std::string().swap(this->_data); // an idle connection keeps no memory
+  this->_size = 0;
+  this->_bufferSize = bufferSize;
+}
+
+/**
+ * @brief Adds the next bytes of the body, moving it to a temporary file when
+ * it gets larger than 'client_body_buffer_size'.
+ * @return false if the body can't be stored (the file can't be created, the
+ * disk is full...).
+ */
+bool RequestBody::append(const char *data, size_t size) {
+  if (size == 0)
+    return true;
+  this->_unmap();
+  if (this->_fd < 0 && this->_size + size > this->_bufferSize &&
+      !this->_spill())
+    return false;
+  if (this->_fd >= 0 && !_writeAll(this->_fd, data, size))
+    return false;
+  if (this->_fd < 0)
+    this->_data.append(data, size);
+  this->_size += size;
+  return true;
+}
+
+/**
+ * @brief Creates the temporary file and moves the bytes received so far to
+ * it.
+ */
+bool RequestBody::_spill() {
+  char path[] = BODY_TEMP_FILE;
+  int fd = mkstemp(path);
+
+  if (fd < 0) {
+    std::cerr << "[ERROR] " << ERR_BODY_TEMP_FILE << strerror(errno) << std::endl;
+    return false;
+  }
+  unlink(path);
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  if (!_writeAll(fd, this->_data.data(), this->_data.size())) {
+    close(fd);
+    return false;
+  }
+  this->_fd = fd;
+  std::string().swap(this->_data);
+  return true;
+}
+
+bool RequestBody::_writeAll(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(fd, data, size);
+
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0) {
+      std::cerr << "[ERROR] " << ERR_BODY_WRITE << strerror(errno) << std::endl;
+      return false;
+    }
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+void RequestBody::_unmap() const {
+  if (this->_map == NULL)
+    return;
+  munmap(this->_map, this->_size);
+  this->_map = NULL;
+}
+
+size_t RequestBody::size() const { return (this->_size); }
+
+bool RequestBody::isInFile() const { return (this->_fd >= 0); }
+
+/**
+ * @brief Getter for the temporary file (-1 if the body is in memory). Its
+ * offset is not used by the body: pass it to a process as it is.
+ */
+int RequestBody::getFd() const { return (this->_fd); }
+
+/**
+ * @brief Getter for the bytes of the body. A temporary file is mapped in
+ * memory (read-only, the pages are loaded as they are read), until the body
+ * changes.
+ * @return const char* `size()` bytes, NULL if the file can't be mapped.
+ */
+const char *RequestBody::data() const {
+  if (this->_fd < 0 || this->_size == 0)
+    return (this->_data.data());
+  if (this->_map == NULL) {
+    void *map = mmap(NULL, this->_size, PROT_READ, MAP_PRIVATE, this->_fd, 0);
+
+    if (map == MAP_FAILED) {
+      std::cerr << "[ERROR] " << ERR_BODY_MAP << strerror(errno) << std::endl;
+      return NULL;
+    }
+    this->_map = map;
+  }
+  return (static_cast<const char *>(this->_map));
+}
+
+/**
+ * @brief Copies the body to a file. A temporary file is copied by chunks
+ * (with sendfile() on Linux: the bytes stay in the kernel), so a large body is
+ * never loaded in memory.
+ * @return false if it can't be read or written.
+ */
+bool RequestBody::writeTo(int fd) const {
+  if (this->_fd < 0)
+    return _writeAll(fd, this->_data.data(), this->_size);
+
+  off_t offset = 0;
+
+  while (static_cast<size_t>(offset) < this->_size) {
+    size_t length = std::min(this->_size - offset,
+                             static_cast<size_t>(OUTPUT_CHUNK_SIZE));
+#ifdef __linux__
+    ssize_t copied = sendfile(fd, this->_fd, &offset, length);
+
+    if (copied < 0 && errno == EINTR)
+      continue;
+#else
+    char buffer[OUTPUT_CHUNK_SIZE];
+    ssize_t copied = pread(this->_fd, buffer, length, offset);
+
+    if (copied > 0 && !_writeAll(fd, buffer, copied))
+      return false;
+    offset += std::max(copied, static_cast<ssize_t>(0));
+#endif
+    if (copied <= 0) {
+      std::cerr << "[ERROR] " << ERR_BODY_WRITE << strerror(errno) << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,576 @@
+/**
+ * @file RequestParser.cpp
+ * @brief Implementation of the incremental HTTP request parser.
+ *
+ * The lines (request line, headers, chunk sizes, trailers) end with CRLF; a
+ * bare LF is accepted too. The empty lines before a request line are skipped
+ * (RFC 9112, 2.2). An error stops the parser at once, with the status of the
+ * error response: the request is rejected without waiting for the rest of it.
+ */
+
+#include "RequestParser.hpp"
+#include "Scanner.hpp"
+#include "utils.hpp"
+
+/**
+ * @brief The names of the known headers (lowercase), by ID.
+ */
+static const char *const g_headerNames[HEADER_COUNT] = {
+    "host",         "content-length", "transfer-encoding",
+    "content-type", "connection",     "expect",
+    "if-none-match", "range",         "accept-encoding"};
+
+/**
+ * @brief Perfect hash of the known header names: their lengths are all
+ * different, so the length gives the only candidate ID.
+ */
+static const int g_headerByLength[] = {
+    -1, -1, -1, -1, HEADER_HOST, HEADER_RANGE, HEADER_EXPECT, -1, -1, -1,
+    HEADER_CONNECTION, -1, HEADER_CONTENT_TYPE, HEADER_IF_NONE_MATCH,
+    HEADER_CONTENT_LENGTH, HEADER_ACCEPT_ENCODING, -1, HEADER_TRANSFER_ENCODING};
+
+RequestParser::RequestParser() { this->reset(); }
+
+RequestParser::~RequestParser() {}
+
+/**
+ * @brief Gets the parser ready for the next request, which starts at the
+ * beginning of the buffer.
+ */
+void RequestParser::reset() {
+  this->_state = PARSE_REQUEST_LINE;
+  this->_bodyState = PARSE_COMPLETE;
+  this->_pos = 0;
+  this->_scanPos = 0;
+  this->_bodyStart = 0;
+  this->_bodySize = 0;
+  this->_maxBodySize = 0;
+  this->_remaining = 0;
+  this->_isChunked = false;
+  this->_hasContentLength = false;
+  this->_method.clear();
+  this->_target.clear();
+  this->_fieldVector.clear();
+  for (int id = 0; id < HEADER_COUNT; id++)
+    this->_knownFields[id] = -1;
+  this->_errorStatus = 0;
+  this->_errorMessage.clear();
+}
+
+/**
+ * @brief Frees the list of the headers of the previous requests: called once
+ * the connection is idle, which then holds no memory for them.
+ */
+void RequestParser::release() {
+  std::vector<headerField_t>().swap(this->_fieldVector);
+}
+
+/**
+ * @brief Parses the bytes received since the previous call.
+ * @param buffer The receive buffer, holding the request from its first byte.
+ * @param body Where the body goes, decoded (without the chunk framing).
+ * @return state_e PARSE_COMPLETE or PARSE_ERROR once the request is over (the
+ * next calls do nothing), the state the parser waits in otherwise
+ * (PARSE_ROUTING: nothing more is parsed before `resume()`).
+ */
+RequestParser::state_e RequestParser::parse(ReceiveBuffer &buffer,
+                                            RequestBody &body) {
+  this->_parseBuffer(buffer, body);
+  this->_dropBody(buffer);
+  return this->_state;
+}
+
+void RequestParser::_parseBuffer(ReceiveBuffer &buffer, RequestBody &body) {
+  size_t lineEnd;
+
+  while (!this->isDone()) {
+    switch (this->_state) {
+    case PARSE_REQUEST_LINE:
+    case PARSE_HEADERS:
+    case PARSE_CHUNK_SIZE:
+    case PARSE_CHUNK_END:
+    case PARSE_TRAILERS: {
+      if (!this->_findLine(buffer, lineEnd))
+        return;
+
+      size_t begin = this->_pos;
+      size_t end = (lineEnd > begin && buffer[lineEnd - 1] == '\r') ? lineEnd - 1
+                                                                      : lineEnd;
+      this->_pos = lineEnd + 1;
+      this->_scanPos = this->_pos;
+      if (this->_state == PARSE_REQUEST_LINE)
+        this->_parseRequestLine(buffer, begin, end);
+      else if (this->_state == PARSE_HEADERS && begin == end)
+        this->_endHeaders();
+      else if (this->_state == PARSE_HEADERS)
+        this->_parseHeader(buffer, begin, end);
+      else if (this->_state == PARSE_CHUNK_SIZE)
+        this->_parseChunkSize(buffer, begin, end);
+      else if (this->_state == PARSE_CHUNK_END && begin == end)
+        this->_state = PARSE_CHUNK_SIZE;
+      else if (this->_state == PARSE_CHUNK_END)
+        this->_fail(400, "Bad Request: Invalid Chunk");
+      else if (begin == end) // end of the trailers (they are ignored)
+        this->_state = PARSE_COMPLETE;
+      break;
+    }
+    case PARSE_ROUTING:
+      return;
+    case PARSE_BODY:
+    case PARSE_CHUNK_DATA: {
+      size_t available = std::min(this->_remaining, buffer.size() - this->_pos);
+
+      if (available == 0)
+        return;
+      if (!body.append(buffer.data() + this->_pos, available))
+        return this->_fail(500, "Internal Server Error: Unable to store the request body");
+      this->_pos += available;
+      this->_bodySize += available;
+      this->_remaining -= available;
+      if (this->_remaining > 0)
+        return;
+      this->_state = (this->_state == PARSE_BODY) ? PARSE_COMPLETE
+                                                  : PARSE_CHUNK_END;
+      this->_scanPos = this->_pos;
+      break;
+    }
+    default:
+      break;
+    }
+  }
+}
+
+/**
+ * @brief Lets the parser read the body of the routed request (the next call
+ * of `parse()` goes on).
+ * @param maxBodySize The 'client_max_body_size' of the server the request is
+ * routed to: a larger `Content-Length` is rejected at once, a chunked body as
+ * soon as its chunks announce more.
+ */
+void RequestParser::resume(size_t maxBodySize) {
+  if (this->_state != PARSE_ROUTING)
+    return;
+  this->_maxBodySize = maxBodySize;
+  if (!this->_isChunked && this->_remaining > maxBodySize)
+    return this->_fail(413, "Payload Too Large");
+  this->_state = this->_bodyState;
+}
+
+/**
+ * @brief Rejects the request for a reason found by the Client (routing...):
+ * the request is over, with this error, and its body is not read.
+ */
+void RequestParser::reject(int status, std::string const &message) {
+  this->_fail(status, message);
+}
+
+/**
+ * @brief Removes the body parsed so far (its data, already in the sink, and
+ * the chunk framing) from the buffer: the headers stay before it, and the
+ * bytes not parsed yet (a partial chunk size line, the next request) are
+ * moved after them.
+ *
+ * Before the end of the headers, `_bodyStart` is 0 and nothing is removed.
+ */
+void RequestParser::_dropBody(ReceiveBuffer &buffer) {
+  if (this->_bodyStart == 0 || this->_pos <= this->_bodyStart)
+    return;
+
+  size_t size = this->_pos - this->_bodyStart;
+
+  buffer.erase(this->_bodyStart, size);
+  this->_scanPos = std::max(this->_scanPos, this->_pos) - size;
+  this->_pos = this->_bodyStart;
+}
+
+/**
+ * @brief Looks for the end of the current line, from where the previous search
+ * stopped.
+ * @param lineEnd Set to the position of the LF ending the line.
+ * @return false if the line is not complete yet.
+ */
+bool RequestParser::_findLine(ReceiveBuffer const &buffer, size_t &lineEnd) {
+  size_t size = buffer.size() - this->_scanPos;
+
+  lineEnd = this->_scanPos + getScanner().findByte(buffer.data() + this->_scanPos,
+                                                  size, '\n');
+  if (lineEnd < buffer.size())
+    return true;
+  this->_scanPos = buffer.size();
+  return false;
+}
+
+/**
+ * @brief Splits the request line in its method, target and version.
+ *
+ * Only HTTP/1.1 is supported. The method and the target are checked by the
+ * Client, with the configuration of the server.
+ */
+void RequestParser::_parseRequestLine(ReceiveBuffer const &buffer, size_t begin,
+                                      size_t end) {
+  size_t tokens[3][2]; // start and end of the method, the target, the version
+  size_t nbTokens = 0;
+  size_t pos = begin;
+
+  if (begin == end)
+    return; // empty line before the request
+  while (pos < end) {
+    while (pos < end && (buffer[pos] == ' ' || buffer[pos] == '\t'))
+      pos++;
+    size_t tokenStart = pos;
+    while (pos < end && buffer[pos] != ' ' && buffer[pos] != '\t')
+      pos++;
+    if (pos == tokenStart)
+      break;
+    if (nbTokens == 3)
+      return this->_fail(400, "Bad Request: Invalid Request Line");
+    tokens[nbTokens][0] = tokenStart;
+    tokens[nbTokens++][1] = pos;
+  }
+  if (nbTokens != 3 ||
+      getScanner().skipToken(buffer.data() + tokens[0][0],
+                             tokens[0][1] - tokens[0][0]) !=
+          tokens[0][1] - tokens[0][0])
+    return this->_fail(400, "Bad Request: Invalid Request Line");
+
+  std::string const version = buffer.substr(tokens[2][0],
+                                            tokens[2][1] - tokens[2][0]);
+
+  if (version == "HTTP/1.0")
+    return this->_fail(505, "HTTP Version Not Supported: Use HTTP/1.1");
+  if (version != "HTTP/1.1")
+    return this->_fail(400, "Bad Request: Invalid HTTP Version");
+  this->_method = buffer.substr(tokens[0][0], tokens[0][1] - tokens[0][0]);
+  this->_target = buffer.substr(tokens[1][0], tokens[1][1] - tokens[1][0]);
+  this->_state = PARSE_HEADERS;
+}
+
+/**
+ * @brief Stores the position of a header line's name and value (without the
+ * spaces around it), and identifies a known header. The headers announcing
+ * the body are checked at once, so an invalid or too large body is rejected
+ * before it is received.
+ *
+ * The name must be a token directly followed by the colon: a space before the
+ * colon, or at the start of the line (obsolete line folding), is rejected
+ * (RFC 9112, 5). The value can't hold control characters other than HTAB.
+ */
+void RequestParser::_parseHeader(ReceiveBuffer const &buffer, size_t begin,
+                                 size_t end) {
+  scanner_t const &scanner = getScanner();
+  const char *line = buffer.data();
+  headerField_t field;
+  size_t valueEnd = end;
+
+  field.name = begin;
+  field.nameLength = scanner.skipToken(line + begin, end - begin);
+  if (field.nameLength == 0 || begin + field.nameLength == end ||
+      line[begin + field.nameLength] != ':')
+    return this->_fail(400, "Bad Request: Malformed Header");
+  field.value = begin + field.nameLength + 1;
+  while (field.value < valueEnd &&
+         (line[field.value] == ' ' || line[field.value] == '\t'))
+    field.value++;
+  if (field.value + scanner.skipFieldValue(line + field.value,
+                                           valueEnd - field.value) != valueEnd)
+    return this->_fail(400, "Bad Request: Invalid Header Value");
+  while (valueEnd > field.value &&
+         (line[valueEnd - 1] == ' ' || line[valueEnd - 1] == '\t'))
+    valueEnd--;
+  field.valueLength = valueEnd - field.value;
+  if (field.valueLength == 0)
+    return this->_fail(400, "Bad Request: Empty Header Key or Value");
+
+  header_e id = _identify(line + field.name, field.nameLength);
+
+  this->_fieldVector.push_back(field);
+  if (id == HEADER_OTHER)
+    return;
+  // two Host headers may name two servers (RFC 9112, 3.2)
+  if (id == HEADER_HOST && this->_knownFields[HEADER_HOST] >= 0)
+    return this->_fail(400, "Bad Request: Duplicate Host Header");
+  this->_knownFields[id] = this->_fieldVector.size() - 1;
+  this->_setFraming(buffer, id, field);
+}
+
+/**
+ * @brief Reads the length of the body from the `Content-Length` and
+ * `Transfer-Encoding` headers.
+ */
+void RequestParser::_setFraming(ReceiveBuffer const &buffer, header_e id,
+                                headerField_t const &field) {
+  const char *value = buffer.data() + field.value;
+
+  if (id == HEADER_TRANSFER_ENCODING) {
+    if (field.valueLength != 7 || !_equalsIgnoreCase(value, "chunked", 7))
+      return this->_fail(501, "Not Implemented: Transfer-Encoding " +
+                                  buffer.substr(field.value, field.valueLength));
+    this->_isChunked = true;
+    return;
+  }
+  if (id != HEADER_CONTENT_LENGTH)
+    return;
+
+  size_t length = 0;
+  for (size_t i = 0; i < field.valueLength; i++) {
+    if (!std::isdigit(static_cast<unsigned char>(value[i])))
+      return this->_fail(400, "Bad Request: Invalid Content-Length");
+    if (length > (std::numeric_limits<size_t>::max() - 9) / 10)
+      return this->_fail(413, "Payload Too Large");
+    length = length * 10 + (value[i] - '0');
+  }
+  if (this->_hasContentLength && length != this->_remaining)
+    return this->_fail(400, "Bad Request: Invalid Content-Length");
+  this->_hasContentLength = true;
+  this->_remaining = length;
+}
+
+/**
+ * @brief Gives the ID of a known header name (case-insensitive).
+ * @return header_e HEADER_OTHER if the header is not a known one.
+ */
+header_e RequestParser::_identify(const char *name, size_t length) {
+  if (length >= sizeof(g_headerByLength) / sizeof(g_headerByLength[0]) ||
+      g_headerByLength[length] < 0)
+    return HEADER_OTHER;
+
+  header_e id = static_cast<header_e>(g_headerByLength[length]);
+
+  if (!_equalsIgnoreCase(name, g_headerNames[id], length))
+    return HEADER_OTHER;
+  return id;
+}
+
+/**
+ * @brief Compares bytes of the buffer to a lowercase string, ignoring the case.
+ */
+bool RequestParser::_equalsIgnoreCase(const char *s1, const char *s2,
+                                      size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    if (std::tolower(static_cast<unsigned char>(s1[i])) != s2[i])
+      return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Checks the headers once they are all received, and chooses how the
+ * body is read (if there is one). The parser then waits for the request to be
+ * routed.
+ *
+ * A request with both `Transfer-Encoding` and `Content-Length` is rejected:
+ * an intermediary may have framed it with the other header (request
+ * smuggling), and the connection is closed after the error (RFC 9112, 6.3).
+ */
+void RequestParser::_endHeaders() {
+  this->_bodyStart = this->_pos;
+  if (this->_knownFields[HEADER_HOST] < 0)
+    return this->_fail(400, "Bad Request: Missing Host Header");
+  if (this->_isChunked && this->_hasContentLength)
+    return this->_fail(400, "Bad Request: Content-Length With Transfer-Encoding");
+  if (this->_isChunked) {
+    this->_remaining = 0;
+    this->_bodyState = PARSE_CHUNK_SIZE;
+  } else if (!this->_hasContentLength && this->_method == "POST") {
+    return this->_fail(411, "Length Required");
+  } else {
+    this->_bodyState = (this->_remaining > 0) ? PARSE_BODY : PARSE_COMPLETE;
+  }
+  this->_state = PARSE_ROUTING;
+}
+
+/**
+ * @brief Reads the size of the next chunk (hexadecimal, its extensions are
+ * ignored). The last chunk (size 0) is followed by the trailers.
+ *
+ * The decoded body can't get larger than 'client_max_body_size': the request
+ * is rejected as soon as a chunk announces more, before its data is received.
+ */
+void RequestParser::_parseChunkSize(ReceiveBuffer const &buffer, size_t begin,
+                                    size_t end) {
+  size_t size = 0;
+  size_t pos = begin;
+
+  for (; pos < end && std::isxdigit(static_cast<unsigned char>(buffer[pos]));
+       pos++) {
+    int digit = std::tolower(static_cast<unsigned char>(buffer[pos]));
+
+    if (size > (std::numeric_limits<size_t>::max() >> 4))
+      return this->_fail(413, "Payload Too Large");
+    size = (size << 4) | (std::isdigit(digit) ? digit - '0' : digit - 'a' + 10);
+  }
+  if (pos == begin || (pos < end && buffer[pos] != ';' && buffer[pos] != ' ' &&
+                       buffer[pos] != '\t'))
+    return this->_fail(400, "Bad Request: Invalid Chunk Size");
+  if (size > this->_maxBodySize - this->_bodySize)
+    return this->_fail(413, "Payload Too Large");
+  this->_remaining = size;
+  this->_state = (size > 0) ? PARSE_CHUNK_DATA : PARSE_TRAILERS;
+}
+
+void RequestParser::_fail(int status, std::string const &message) {
+  this->_state = PARSE_ERROR;
+  this->_errorStatus = status;
+  this->_errorMessage = message;
+}
+
+/**
+ * @brief Checks if the request is over: complete, or rejected.
+ */
+bool RequestParser::isDone() const {
+  return (this->_state == PARSE_COMPLETE || this->_state == PARSE_ERROR);
+}
+
+/**
+ * @brief Checks if the headers of the request are all received (the body may
+ * still be on the way).
+ */
+bool RequestParser::hasHeaders() const {
+  return (this->_state != PARSE_REQUEST_LINE && this->_state != PARSE_HEADERS);
+}
+
+/**
+ * @brief Checks if the headers are complete and the request waits to be
+ * routed (see `resume()`).
+ */
+bool RequestParser::isWaitingForRoute() const {
+  return (this->_state == PARSE_ROUTING);
+}
+
+/**
+ * @brief Checks if the request has a body to receive (chunked, or a
+ * `Content-Length` above 0).
+ */
+bool RequestParser::expectsBody() const {
+  return (this->_bodyState != PARSE_COMPLETE);
+}
+
+bool RequestParser::hasError() const { return (this->_state == PARSE_ERROR); }
+
+/**
+ * @brief Getter for the length of the complete request in the buffer (the
+ * next request starts after it).
+ */
+size_t RequestParser::getLength() const { return (this->_pos); }
+
+/**
+ * @brief Getter for the size of the (decoded) body received so far.
+ */
+size_t RequestParser::getBodySize() const { return (this->_bodySize); }
+
+int RequestParser::getErrorStatus() const { return (this->_errorStatus); }
+
+const std::string &RequestParser::getErrorMessage() const {
+  return (this->_errorMessage);
+}
+
+const std::string &RequestParser::getMethod() const { return (this->_method); }
+
+const std::string &RequestParser::getTarget() const { return (this->_target); }
+
+bool RequestParser::hasHeader(header_e id) const {
+  return (this->_knownFields[id] >= 0);
+}
+
+/**
+ * @brief Getter for the value of a known header (the last one if it is
+ * repeated).
+ * @param buffer The receive buffer the request was parsed in.
+ * @return std::string the value, empty if the header is absent.
+ */
+std::string RequestParser::getHeader(ReceiveBuffer const &buffer,
+                                     header_e id) const {
+  if (this->_knownFields[id] < 0)
+    return "";
+
+  headerField_t const &field = this->_fieldVector[this->_knownFields[id]];
+
+  return buffer.substr(field.value, field.valueLength);
+}
+
+/**
+ * @brief Getter for the value of any header, by its name (case-insensitive).
+ * @return std::string the value, empty if the header is absent.
+ */
+std::string RequestParser::getHeader(ReceiveBuffer const &buffer,
+                                     std::string const &name) const {
+  int index = this->_findField(buffer, name);
+
+  if (index < 0)
+    return "";
+  return buffer.substr(this->_fieldVector[index].value,
+                       this->_fieldVector[index].valueLength);
+}
+
+/**
+ * @brief Finds the last header with a name (case-insensitive), the known ones
+ * without a scan.
+ * @return int its index in `_fieldVector`, or -1.
+ */
+int RequestParser::_findField(ReceiveBuffer const &buffer,
+                              std::string const &name) const {
+  std::string lowerName(name);
+
+  for (size_t i = 0; i < lowerName.size(); i++)
+    lowerName[i] = std::tolower(lowerName[i]);
+
+  header_e id = _identify(lowerName.data(), lowerName.size());
+  if (id != HEADER_OTHER)
+    return this->_knownFields[id];
+  for (size_t i = this->_fieldVector.size(); i-- > 0;) {
+    headerField_t const &field = this->_fieldVector[i];
+
+    if (field.nameLength == lowerName.size() &&
+        _equalsIgnoreCase(buffer.data() + field.name, lowerName.c_str(),
+                          field.nameLength))
+      return i;
+  }
+  return -1;
+}
+
+/**
+ * @brief Compares the value of a known header to a lowercase string, ignoring
+ * the case (false if the header is absent).
+ */
+bool RequestParser::headerEquals(ReceiveBuffer const &buffer, header_e id,
+                                 const char *value) const {
+  if (this->_knownFields[id] < 0)
+    return false;
+
+  headerField_t const &field = this->_fieldVector[this->_knownFields[id]];
+
+  return (field.valueLength == std::strlen(value) &&
+          _equalsIgnoreCase(buffer.data() + field.value, value,
+                            field.valueLength));
+}
+
+/**
+ * @brief Checks if the comma-separated list of a known header holds a
+ * lowercase token, ignoring the case (e.g. `Connection: keep-alive, Close`).
+ */
+bool RequestParser::headerHasToken(ReceiveBuffer const &buffer, header_e id,
+                                   const char *token) const {
+  if (this->_knownFields[id] < 0)
+    return false;
+
+  headerField_t const &field = this->_fieldVector[this->_knownFields[id]];
+  const char *value = buffer.data() + field.value;
+  size_t tokenLength = std::strlen(token);
+  size_t pos = 0;
+
+  while (pos < field.valueLength) {
+    while (pos < field.valueLength &&
+           (value[pos] == ',' || value[pos] == ' ' || value[pos] == '\t'))
+      pos++;
+    size_t start = pos;
+    while (pos < field.valueLength && value[pos] != ',')
+      pos++;
+    size_t end = pos;
+    while (end > start && (value[end - 1] == ' ' || value[end - 1] == '\t'))
+      end--;
+    if (end - start == tokenLength &&
+        _equalsIgnoreCase(value + start, token, tokenLength))
+      return true;
+  }
+  return false;
+}
@@ -0,0 +1,134 @@
+/**
+ * @file RequestTarget.cpp
+ * @brief Implementation of the parser of the request target.
+ *
+ * The target is read once: each byte is checked with a class table, the path
+ * is percent-decoded and its "." and ".." segments are removed (RFC 3986,
+ * 5.2.4) as they end, empty segments ("//") are merged, and the query is
+ * split off. A ".." can't go above the root: the request is rejected instead,
+ * so a path built from the root never leaves it.
+ */
+
+#include "RequestTarget.hpp"
+
+/**
+ * @brief Character classes of the target, by byte value.
+ */
+enum uriClass_e { URI_PATH = 1, URI_QUERY = 2, URI_HEX = 4 };
+
+/**
+ * @brief Builds the class table: the path characters are the unreserved ones,
+ * the sub-delimiters, ':', '@', '/' and '%' (RFC 3986, 3.3); the query also
+ * takes '?', and '[' and ']' sent unencoded by some clients.
+ */
+static std::vector<unsigned char> _buildClassTable() {
+  std::vector<unsigned char> table(256, 0);
+  const char *pathSpecials = "-._~!$&'()*+,;=:@/%";
+  const char *querySpecials = "?[]";
+
+  for (int c = 0; c < 256; c++) {
+    if (c > 0 && c < 0x80 &&
+        (std::isalnum(c) || std::strchr(pathSpecials, c)))
+      table[c] |= URI_PATH | URI_QUERY;
+    if (c > 0 && std::strchr(querySpecials, c))
+      table[c] |= URI_QUERY;
+    if (c < 0x80 && std::isxdigit(c))
+      table[c] |= URI_HEX;
+  }
+  return table;
+}
+
+static const std::vector<unsigned char> g_uriClass = _buildClassTable();
+
+static int _hexValue(char c) {
+  return std::isdigit(static_cast<unsigned char>(c))
+             ? c - '0'
+             : std::tolower(static_cast<unsigned char>(c)) - 'a' + 10;
+}
+
+static bool _isHex(std::string const &raw, size_t pos) {
+  return (pos < raw.size() &&
+          (g_uriClass[static_cast<unsigned char>(raw[pos])] & URI_HEX));
+}
+
+/**
+ * @brief Ends the last segment of the path: a "." is removed, a ".." removes
+ * the previous segment too.
+ * @param path The path decoded so far, the last segment starts at
+ * `segmentStart` (after a '/').
+ * @return false if a ".." goes above the root.
+ */
+static bool _endSegment(std::string &path, size_t segmentStart) {
+  size_t length = path.size() - segmentStart;
+
+  if (length == 1 && path[segmentStart] == '.')
+    path.resize(segmentStart);
+  else if (length == 2 && path[segmentStart] == '.' &&
+           path[segmentStart + 1] == '.') {
+    if (segmentStart == 1)
+      return false;
+    path.resize(path.rfind('/', segmentStart - 2) + 1);
+  }
+  return true;
+}
+
+/**
+ * @brief Parses the target of the request line (origin form: "/path?query").
+ *
+ * A fragment ('#...', never sent by the browsers) is ignored.
+ * @param raw The target, as received.
+ * @param target Filled with the decoded path and the query.
+ * @return targetStatus_e TARGET_OK, or the reason the target is invalid.
+ */
+targetStatus_e parseRequestTarget(std::string const &raw,
+                                  requestTarget_t &target) {
+  target.path.clear();
+  target.query.clear();
+  if (raw.empty() || raw[0] != '/')
+    return TARGET_INVALID_CHARACTER;
+  target.path.reserve(raw.size());
+
+  size_t segmentStart = 0;
+  size_t pos = 0;
+
+  for (; pos < raw.size() && raw[pos] != '?' && raw[pos] != '#'; pos++) {
+    unsigned char c = raw[pos];
+
+    if (!(g_uriClass[c] & URI_PATH))
+      return TARGET_INVALID_CHARACTER;
+    if (c == '%') {
+      if (!_isHex(raw, pos + 1) || !_isHex(raw, pos + 2))
+        return TARGET_INVALID_ENCODING;
+      c = _hexValue(raw[pos + 1]) * 16 + _hexValue(raw[pos + 2]);
+      if (c < 0x20 || c == 0x7f)
+        return TARGET_INVALID_ENCODING;
+      pos += 2;
+    }
+    if (c != '/') {
+      target.path += c;
+      continue;
+    }
+    if (!_endSegment(target.path, segmentStart))
+      return TARGET_OUTSIDE_ROOT;
+    if (target.path.empty() || target.path[target.path.size() - 1] != '/')
+      target.path += '/';
+    segmentStart = target.path.size();
+  }
+  if (!_endSegment(target.path, segmentStart))
+    return TARGET_OUTSIDE_ROOT;
+
+  if (pos < raw.size() && raw[pos] == '?') {
+    size_t queryStart = ++pos;
+
+    for (; pos < raw.size() && raw[pos] != '#'; pos++) {
+      unsigned char c = raw[pos];
+
+      if (!(g_uriClass[c] & URI_QUERY))
+        return TARGET_INVALID_CHARACTER;
+      if (c == '%' && (!_isHex(raw, pos + 1) || !_isHex(raw, pos + 2)))
+        return TARGET_INVALID_ENCODING;
+    }
+    target.query.assign(raw, queryStart, pos - queryStart);
+  }
+  return TARGET_OK;
+}
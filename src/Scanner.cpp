@@ -0,0 +1,289 @@
+/**
+ * @file Scanner.cpp
+ * @brief Implementation of the delimiter scans: scalar, SSE2 (the x86-64
+ * baseline) and AVX2 (used when the CPU has it, checked once at startup).
+ *
+ * The vectorized scans compare 16 or 32 bytes at once and turn the result in
+ * a bit mask: the position of its lowest bit is the byte searched for. The
+ * tail of the data (less than a vector) is handled by the scalar scan.
+ * The AVX2 scans clear the upper halves of the registers before handing their
+ * tail to the SSE2 ones: mixing dirty AVX state with legacy SSE instructions
+ * costs more than the scan itself.
+ *
+ * The token characters are tested as ranges with SSE2, and with a nibble
+ * lookup (vpshufb) with AVX2: the low nibble of a byte gives the set of its
+ * possible high nibbles, which must hold the byte's actual high nibble.
+ */
+
+#include "Scanner.hpp"
+
+#if defined(__GNUC__) && defined(__SSE2__) && \
+    (defined(__x86_64__) || defined(__i386__))
+# define SCANNER_X86
+# include <immintrin.h>
+#endif
+
+/* ************************************************************************** */
+/*                                   Scalar                                   */
+/* ************************************************************************** */
+
+/**
+ * @brief Character classes of the scans, by byte value.
+ */
+enum charClass_e { CHAR_TOKEN = 1, CHAR_CONTROL = 2 };
+
+/**
+ * @brief Builds the class table: the token characters are the letters, the
+ * digits and "!#$%&'*+-.^_`|~"; the control characters are the bytes below
+ * 0x20 (except HTAB) and DEL.
+ */
+static std::vector<unsigned char> _buildClassTable() {
+  std::vector<unsigned char> table(256, 0);
+  const char *tokenSpecials = "!#$%&'*+-.^_`|~";
+
+  for (int c = 0; c < 256; c++) {
+    if (std::isalnum(c) || (c != 0 && std::strchr(tokenSpecials, c)))
+      table[c] |= CHAR_TOKEN;
+    if ((c < 0x20 && c != '\t') || c == 0x7f)
+      table[c] |= CHAR_CONTROL;
+  }
+  return table;
+}
+
+static const std::vector<unsigned char> g_charClass = _buildClassTable();
+
+static size_t _scalarFindByte(const char *data, size_t size, char c) {
+  const void *found = std::memchr(data, c, size);
+
+  return found ? static_cast<const char *>(found) - data : size;
+}
+
+static size_t _scalarSkipToken(const char *data, size_t size) {
+  size_t i = 0;
+
+  while (i < size && (g_charClass[static_cast<unsigned char>(data[i])] & CHAR_TOKEN))
+    i++;
+  return i;
+}
+
+static size_t _scalarSkipFieldValue(const char *data, size_t size) {
+  size_t i = 0;
+
+  while (i < size &&
+         !(g_charClass[static_cast<unsigned char>(data[i])] & CHAR_CONTROL))
+    i++;
+  return i;
+}
+
+static const scanner_t g_scalarScanner = {"scalar", &_scalarFindByte,
+                                          &_scalarSkipToken,
+                                          &_scalarSkipFieldValue};
+
+#ifdef SCANNER_X86
+
+/* ************************************************************************** */
+/*                                    SSE2                                    */
+/* ************************************************************************** */
+
+/**
+ * @brief Sets the bytes of a vector which are in [low, high] (both below
+ * 0x80: the bytes from 0x80, negative as signed, are never in the range).
+ */
+static inline __m128i _sse2InRange(__m128i chunk, char low, char high) {
+  return _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8(low - 1)),
+                       _mm_cmplt_epi8(chunk, _mm_set1_epi8(high + 1)));
+}
+
+static size_t _sse2FindByte(const char *data, size_t size, char c) {
+  __m128i const needle = _mm_set1_epi8(c);
+  size_t i = 0;
+
+  for (; i + 16 <= size; i += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+  return i + _scalarFindByte(data + i, size - i, c);
+}
+
+/**
+ * @note The token characters are 9 ranges: "!", "#" to "'", "*+", "-.",
+ * the digits, the uppercase letters, "^" to "z", "|" and "~".
+ */
+static size_t _sse2SkipToken(const char *data, size_t size) {
+  size_t i = 0;
+
+  for (; i + 16 <= size; i += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    __m128i token = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('!'));
+
+    token = _mm_or_si128(token, _sse2InRange(chunk, '#', '\''));
+    token = _mm_or_si128(token, _sse2InRange(chunk, '*', '+'));
+    token = _mm_or_si128(token, _sse2InRange(chunk, '-', '.'));
+    token = _mm_or_si128(token, _sse2InRange(chunk, '0', '9'));
+    token = _mm_or_si128(token, _sse2InRange(chunk, 'A', 'Z'));
+    token = _mm_or_si128(token, _sse2InRange(chunk, '^', 'z'));
+    token = _mm_or_si128(token, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('|')));
+    token = _mm_or_si128(token, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('~')));
+
+    int mask = ~_mm_movemask_epi8(token) & 0xffff;
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+  return i + _scalarSkipToken(data + i, size - i);
+}
+
+static size_t _sse2SkipFieldValue(const char *data, size_t size) {
+  __m128i const last = _mm_set1_epi8(0x1f);
+  size_t i = 0;
+
+  for (; i + 16 <= size; i += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    // unsigned chunk <= 0x1f, except HTAB, or DEL
+    __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(chunk, last), chunk);
+
+    control = _mm_andnot_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t')),
+                               control);
+    control = _mm_or_si128(control, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(0x7f)));
+
+    int mask = _mm_movemask_epi8(control);
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+  return i + _scalarSkipFieldValue(data + i, size - i);
+}
+
+static const scanner_t g_sse2Scanner = {"sse2", &_sse2FindByte,
+                                        &_sse2SkipToken, &_sse2SkipFieldValue};
+
+/* ************************************************************************** */
+/*                                    AVX2                                    */
+/* ************************************************************************** */
+
+__attribute__((target("avx2"))) static size_t
+_avx2FindByte(const char *data, size_t size, char c) {
+  __m256i const needle = _mm256_set1_epi8(c);
+  size_t i = 0;
+
+  for (; i + 32 <= size; i += 32) {
+    __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+  _mm256_zeroupper();
+  return i + _sse2FindByte(data + i, size - i, c);
+}
+
+/**
+ * @brief Nibble tables of the token characters: for a low nibble, the bit
+ * (high nibble - 2) is set if the byte is a token character (they are all
+ * between 0x21 and 0x7e, high nibbles 2 to 7).
+ */
+static const unsigned char g_tokenByLowNibble[16] = {
+    0x3a, 0x3f, 0x3e, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f,
+    0x3e, 0x3e, 0x3d, 0x15, 0x34, 0x15, 0x3d, 0x1c};
+static const unsigned char g_bitByHighNibble[16] = {
+    0, 0, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0, 0, 0, 0, 0, 0, 0, 0};
+
+__attribute__((target("avx2"))) static size_t _avx2SkipToken(const char *data,
+                                                             size_t size) {
+  __m256i const lowTable = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(g_tokenByLowNibble)));
+  __m256i const highTable = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(g_bitByHighNibble)));
+  __m256i const nibble = _mm256_set1_epi8(0x0f);
+  size_t i = 0;
+
+  for (; i + 32 <= size; i += 32) {
+    __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    __m256i low = _mm256_shuffle_epi8(lowTable, _mm256_and_si256(chunk, nibble));
+    __m256i high = _mm256_shuffle_epi8(
+        highTable, _mm256_and_si256(_mm256_srli_epi16(chunk, 4), nibble));
+    __m256i notToken = _mm256_cmpeq_epi8(_mm256_and_si256(low, high),
+                                         _mm256_setzero_si256());
+    unsigned mask = _mm256_movemask_epi8(notToken);
+
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+  _mm256_zeroupper();
+  return i + _sse2SkipToken(data + i, size - i);
+}
+
+__attribute__((target("avx2"))) static size_t
+_avx2SkipFieldValue(const char *data, size_t size) {
+  __m256i const last = _mm256_set1_epi8(0x1f);
+  size_t i = 0;
+
+  for (; i + 32 <= size; i += 32) {
+    __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, last), chunk);
+
+    control = _mm256_andnot_si256(
+        _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t')), control);
+    control = _mm256_or_si256(control,
+                              _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(0x7f)));
+
+    unsigned mask = _mm256_movemask_epi8(control);
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+  _mm256_zeroupper();
+  return i + _sse2SkipFieldValue(data + i, size - i);
+}
+
+static const scanner_t g_avx2Scanner = {"avx2", &_avx2FindByte,
+                                        &_avx2SkipToken, &_avx2SkipFieldValue};
+
+#endif
+
+/* ************************************************************************** */
+/*                                  Selection                                 */
+/* ************************************************************************** */
+
+/**
+ * @brief Getter for the SSE2 scans (NULL if not built for x86).
+ */
+const scanner_t *getSse2Scanner() {
+#ifdef SCANNER_X86
+  return &g_sse2Scanner;
+#else
+  return NULL;
+#endif
+}
+
+/**
+ * @brief Getter for the AVX2 scans (NULL if the CPU doesn't have AVX2).
+ */
+const scanner_t *getAvx2Scanner() {
+#ifdef SCANNER_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return &g_avx2Scanner;
+#endif
+  return NULL;
+}
+
+const scanner_t &getScalarScanner() { return g_scalarScanner; }
+
+static const scanner_t *_selectScanner() {
+  const scanner_t *scanner = getAvx2Scanner();
+
+  if (scanner == NULL)
+    scanner = getSse2Scanner();
+  return scanner ? scanner : &g_scalarScanner;
+}
+
+static const scanner_t &g_scanner = *_selectScanner();
+
+/**
+ * @brief Getter for the fastest scans of the CPU, chosen at startup.
+ */
+const scanner_t &getScanner() { return g_scanner; }
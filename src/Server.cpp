@@ -18,7 +18,6 @@
  * @details The constructor performs the following operations:
  * - Uploads raw parameters from the provided maps (Server bloc parameters) and vector (multiple Location bloc parameters).
  * - Extracts and assigns server attributes such as server name, host, root, index, and port.
- * - Initializes the server socket to zero.
  * - Determines if this server instance is the primary one by checking other instances in `_serversVector`.
  */
 Server::Server(std::vector<Server>&	_serversVector, std::map<std::string, std::string> tempServerConfigMap, std::vector<std::map<std::string, std::string> > tempLocationMapVector) {
@@ -35,9 +34,16 @@ Server::Server(std::vector<Server>&	_serversVector, std::map<std::string, std::s
 	this->_fillErrorPageMap();
 	this->_port = this->_ServerConfigMap[LISTEN];
 	this->_clientMaxBodySize = this->_getConvertedMaxSize(_ServerConfigMap[MAX_SIZE]);
-	
-	//initialisation
-	this->_socket = 0;
+	this->_clientBodyBufferSize = this->_getNumberParam(BODY_BUF, DEFAULT_BODY_BUFFER_SIZE);
+	this->_keepaliveTimeout = this->_getNumberParam(KEEPALIVE_T, DEFAULT_KEEPALIVE_TIMEOUT);
+	this->_keepaliveRequests = this->_getNumberParam(KEEPALIVE_R, DEFAULT_KEEPALIVE_REQUESTS);
+	this->_headerTimeout = this->_getNumberParam(HEADER_T, DEFAULT_HEADER_TIMEOUT);
+	this->_bodyTimeout = this->_getNumberParam(BODY_T, DEFAULT_BODY_TIMEOUT);
+	this->_sendTimeout = this->_getNumberParam(SEND_T, DEFAULT_SEND_TIMEOUT);
+	this->_listenBacklog = this->_getNumberParam(BACKLOG, DEFAULT_LISTEN_BACKLOG);
+	this->_fillTcpOptions();
+	this->_maxConnections = this->_getNumberParam(MAX_CONN, 0);
+	this->_maxConnectionsPerIp = this->_getNumberParam(MAX_CONN_IP, 0);
 	
 	//get location bloc parameters from to `tempLocationMapVector` to a vector of struct location_t 
 	if (!tempLocationMapVector.empty()){
@@ -47,6 +53,8 @@ Server::Server(std::vector<Server>&	_serversVector, std::map<std::string, std::s
     //if any location bloc, use it the default location bloc
     this->_LocationMap["/"] = _getDefaultLocation();
   }
+  this->_defaultLocation = _getDefaultLocation();
+  this->_buildLocationTrie();
 
 	//check if there is other instance of server with the same `_host` `_port`
 	this->_isPrimary = this->_checkPrimaryServer(_serversVector);
@@ -61,6 +69,36 @@ Server::Server(std::vector<Server>&	_serversVector, std::map<std::string, std::s
 Server::~Server(){
 }
 
+/**
+ * The function `_getNumberParam` returns the value of an optional numeric directive (already checked by the
+ * Parser), or its default value if the directive is not in the server bloc.
+ */
+size_t Server::_getNumberParam(std::string const& dirName, size_t defaultValue){
+	std::map<std::string, std::string>::const_iterator it = this->_ServerConfigMap.find(dirName);
+
+	if (it == this->_ServerConfigMap.end())
+		return defaultValue;
+	return ft_stoll(it->second);
+}
+
+/**
+ * The function `_fillTcpOptions` gets the socket options of the server (see tcpOptions_t), only
+ * 'tcp_nodelay' is enabled by default.
+ */
+void Server::_fillTcpOptions(){
+	std::map<std::string, std::string>::const_iterator it = this->_ServerConfigMap.find(TCP_ND);
+
+	this->_tcpOptions.noDelay = (it == this->_ServerConfigMap.end() || it->second == "on");
+	this->_tcpOptions.deferAccept = this->_getNumberParam(TCP_DA, 0);
+	this->_tcpOptions.fastOpen = this->_getNumberParam(TCP_FO, 0);
+	this->_tcpOptions.rcvBuf = this->_getNumberParam(SO_RB, 0);
+	this->_tcpOptions.sndBuf = this->_getNumberParam(SO_SB, 0);
+	this->_tcpOptions.notSentLowat = this->_getNumberParam(TCP_NL, 0);
+	this->_tcpOptions.keepIdle = this->_getNumberParam(TCP_KI, 0);
+	this->_tcpOptions.keepIntvl = this->_getNumberParam(TCP_KV, 0);
+	this->_tcpOptions.keepCnt = this->_getNumberParam(TCP_KC, 0);
+}
+
 /**
  * The function `_fillServerNameVector` reads a string of server names, splits it into individual
  * words, and stores them in a vector.
@@ -224,41 +262,153 @@ void Server::_getLocationStruct() {
 }
 
 // ---> Getters ---------------------------------------------------------------
-bool                      Server::getIsPrimary(){return (this->_isPrimary);}
+bool                      Server::getIsPrimary() const{return (this->_isPrimary);}
 const std::string&	      Server::getHost() const{return this->_host;}
 const std::string&	      Server::getPort() const{return this->_port;}
-int							          Server::getSocket() const{return this->_socket;}
-std::vector<std::string>	Server::getServerNameVector() const{return this->_serverNameVector;}
+const std::vector<std::string>&	Server::getServerNameVector() const{return this->_serverNameVector;}
 size_t						        Server::getClientMaxBodySize() const{return this->_clientMaxBodySize;}
+size_t						        Server::getClientBodyBufferSize() const{return this->_clientBodyBufferSize;}
+size_t						        Server::getKeepaliveTimeout() const{return this->_keepaliveTimeout;}
+size_t						        Server::getKeepaliveRequests() const{return this->_keepaliveRequests;}
+size_t						        Server::getHeaderTimeout() const{return this->_headerTimeout;}
+size_t						        Server::getBodyTimeout() const{return this->_bodyTimeout;}
+size_t						        Server::getSendTimeout() const{return this->_sendTimeout;}
+size_t						        Server::getListenBacklog() const{return this->_listenBacklog;}
+const tcpOptions_t&			  Server::getTcpOptions() const{return this->_tcpOptions;}
+size_t						        Server::getMaxConnections() const{return this->_maxConnections;}
+size_t						        Server::getMaxConnectionsPerIp() const{return this->_maxConnectionsPerIp;}
 const std::string&			  Server::getRoot() const{return this->_root;}
 const std::string&			  Server::getIndex() const{return this->_index;}
 std::map<std::string, std::string>			Server::getErrorPage() const{return this->_errorPages;}
 const std::string&			                Server::getErrorResponse() const{return this->_errorResponse;}
 const std::map<std::string, location_t>& Server::getLocations() const{return this->_LocationMap;}
 
-location_t Server::getLocationConfig(const std::string &path) const
+/**
+ * @brief Getter for the location of a path: the longest location whose name is the path or
+ * its beginning up to a '/' ("/upload" for "/upload/a.txt", not for "/uploads").
+ * @return const location_t& the default location if no location matches.
+ */
+const location_t& Server::getLocationConfig(const std::string &path) const
 {
-    const std::map<std::string, location_t> &locations = getLocations();
-    const location_t *matchedLocation = NULL;
-    size_t matchedPrefixLength = 0;
+    const location_t *matchedLocation = findLocation(path, true);
 
-    // find the better location match
-    for (std::map<std::string, location_t>::const_iterator it = locations.begin(); it != locations.end(); ++it)
-	{
-		// check for a perfect match
-        if (path.find(it->first) == 0 && it->first.length() > matchedPrefixLength && (path[it->first.length()] == '/' || path[it->first.length()] == '\0'))
-		{
-            matchedLocation = &(it->second);
-            matchedPrefixLength = it->first.length();
+    if (matchedLocation)
+        return *matchedLocation;
+    return this->_defaultLocation;
+}
+
+/**
+ * @brief Compiles `_LocationMap` into `_locationTrie`, one node per segment of the names of
+ * the locations, so a lookup follows the segments of the path instead of testing every location.
+ * 
+ * A name that doesn't start with '/' can't be the beginning of a path: it isn't added.
+ * The trie holds copies of the locations, so a copy of the server (the servers are stored
+ * in vectors) has a trie of its own.
+ */
+void Server::_buildLocationTrie()
+{
+    this->_locationTrie.assign(1, locationNode_t());
+    for (std::map<std::string, location_t>::const_iterator it = _LocationMap.begin(); it != _LocationMap.end(); ++it)
+    {
+        const std::string &name = it->first;
+        size_t node = 0;
+        size_t start = 1;
+
+        if (name.empty() || name[0] != '/')
+            continue;
+        while (true)
+        {
+            size_t end = std::min(name.find('/', start), name.size());
+            std::string segment = name.substr(start, end - start);
+            std::map<std::string, size_t>::const_iterator child = _locationTrie[node].childMap.find(segment);
+
+            if (child == _locationTrie[node].childMap.end())
+            {
+                this->_locationTrie.push_back(locationNode_t());
+                child = _locationTrie[node].childMap.insert(std::make_pair(segment, _locationTrie.size() - 1)).first;
+            }
+            node = child->second;
+            if (end == name.size())
+                break;
+            start = end + 1;
         }
+        this->_locationTrie[node].hasLocation = true;
+        this->_locationTrie[node].location = it->second;
     }
-    if (matchedLocation)
+}
+
+/**
+ * @brief Finds the child of a trie node with the longest segment (holding a location) that
+ * is the beginning of `segment`: a location whose name ends inside a segment of the path,
+ * like "/up" for "/upload".
+ * 
+ * The greatest segment not after `segment` is the longest one that begins it, if any begins it;
+ * else `segment` is cut to what they have in common, and so on.
+ * @return size_t the index of the child, 0 (the root) if none.
+ */
+size_t Server::_findPartialChild(size_t node, std::string segment) const
+{
+    const std::map<std::string, size_t> &childMap = _locationTrie[node].childMap;
+
+    while (true)
     {
-        std::cout << "Matched location: " << matchedPrefixLength << ", uploadTo: " << matchedLocation->uploadTo << std::endl;
-        return *matchedLocation;
+        std::map<std::string, size_t>::const_iterator it = childMap.upper_bound(segment);
+        size_t common = 0;
+
+        if (it == childMap.begin())
+            return 0;
+        --it;
+        while (common < it->first.size() && common < segment.size() && it->first[common] == segment[common])
+            common++;
+        if (common < it->first.size())
+            segment.erase(common);
+        else if (_locationTrie[it->second].hasLocation)
+            return it->second;
+        else if (common == 0)
+            return 0;
+        else
+            segment.erase(common - 1);
+    }
+}
+
+/**
+ * @brief Finds the longest location that is the beginning of a path, following its segments
+ * in `_locationTrie` (each location matched on the way is longer than the previous one).
+ * @param wholeSegments true if the location must end at a '/' of the path or at its end
+ * (`getLocationConfig()`), false if it may end anywhere (the routing of a request).
+ * @return const location_t* NULL if no location matches.
+ */
+const location_t* Server::findLocation(const std::string &path, bool wholeSegments) const
+{
+    const location_t *matchedLocation = NULL;
+    size_t node = 0;
+    size_t start = 1;
+
+    if (path.empty() || path[0] != '/')
+        return NULL;
+    while (true)
+    {
+        size_t end = std::min(path.find('/', start), path.size());
+        std::string segment = path.substr(start, end - start);
+        std::map<std::string, size_t>::const_iterator child = _locationTrie[node].childMap.find(segment);
+
+        if (!wholeSegments)
+        {
+            size_t partial = _findPartialChild(node, segment);
+
+            if (partial)
+                matchedLocation = &_locationTrie[partial].location;
+        }
+        if (child == _locationTrie[node].childMap.end())
+            break;
+        node = child->second;
+        if (_locationTrie[node].hasLocation)
+            matchedLocation = &_locationTrie[node].location;
+        if (end == path.size())
+            break;
+        start = end + 1;
     }
-    // Retourner une configuration par défaut si aucune correspondance n’est trouvée
-    return _getDefaultLocation();
+    return matchedLocation;
 }
 
 /**
@@ -276,15 +426,6 @@ location_t Server::_getDefaultLocation() const
 }
 
 
-  void Server::createSocket()
-{
-	if (!this->_socket)
-	{
-		this->_socket = socket(AF_INET, SOCK_STREAM, 0);
-		if (this->_socket < 0)
-			throw std::runtime_error(ERR_SOCKET(this->_serverNameVector.at(0)));
-	}
-}
 /**
  * The function `printServers` in the `Server` class prints detailed information about server
  * configurations and locations.
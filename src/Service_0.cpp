@@ -14,45 +14,161 @@
  * @param argv The '.conf' file.
  * @param argc values allowed: 0 or 1.
  */
-Service::Service(int argc, char **argv) {
+Service::Service(int argc, char **argv)
+    : _servers(&this->_serversVector), _nbClients(0), _poller(NULL),
+      _now(getMonotonicTime()), _timerWheel(_now), _nbWakeups(0),
+      _nbEvents(0), _acceptPauseFd(-1), _drainDeadline(0),
+      _wakeupSlot(0), _master(this), _publishedGeneration(NULL),
+      _publishedCount(0), _adoptedCount(0), _isParsing(false), _isParsed(0),
+      _parsedGeneration(NULL), _reloadCount(g_reload),
+      _upgradeCount(g_upgrade), _upgradePid(-1), _previousPid(-1),
+      _nbReady(0), _argc(argc), _argv(argv), _isWorker(false), _workerID(0) {
+  this->_wakeupPipe[0] = -1;
+  this->_wakeupPipe[1] = -1;
+  this->_readyPipe[0] = -1;
+  this->_readyPipe[1] = -1;
+  for (int i = 0; i <= MASTER_WAKEUP; i++)
+    g_wakeupFds[i] = -1;
+  pthread_mutex_init(&this->_publishMutex, NULL);
   printInfo(START_MSG, GREEN);
+  this->_initTmpServiceInfo();
 
   // Intercepts signals for socket handling and interruption.
   std::signal(SIGPIPE, SIG_IGN); // Ignore SIGPIPE errors for sockets.
-  std::signal(SIGINT, signalHandler);
+  setSignalHandler(SIGINT, signalHandler);
+  setSignalHandler(SIGTERM, signalHandler);
+  setSignalHandler(SIGQUIT, signalHandler);
+  setSignalHandler(SIGHUP, signalHandler);
+  setSignalHandler(SIGUSR2, signalHandler);
 
   // Instantiate Parser to process the '.conf' file.
   Parser input(argc, argv);
 
   this->_serversVector = input.getServersVector();
-  this->_nbPrimaryServers = this->_countPrimaryServers();
+  this->_globalConfig = input.getGlobalConfig();
+  this->_bufferPool.setBufferSize(this->_globalConfig.headerBufferSize);
 }
 
 /**
- * @brief Destructor for Service, closes all sockets in the polling vector.
+ * @brief Constructor of a worker Service (worker mode only).
+ *
+ * The worker shares the master's servers vector and global configuration
+ * (then the ones it publishes on reload), and gets its own readiness backend
+ * surveying its own listening sockets (created by the master's setup()), and
+ * its own wake-up pipe.
+ * @param master The Service created by main, already set up.
+ * @param workerID Index of the worker, used to pick its listening sockets.
+ */
+Service::Service(Service &master, size_t workerID)
+    : _servers(master._servers), _nbClients(0), _poller(NULL),
+      _now(getMonotonicTime()), _timerWheel(_now), _nbWakeups(0),
+      _nbEvents(0), _acceptPauseFd(-1), _drainDeadline(0), _wakeupSlot(0),
+      _master(&master), _publishedGeneration(NULL), _publishedCount(0),
+      _adoptedCount(master._publishedCount), _isParsing(false), _isParsed(0),
+      _parsedGeneration(NULL), _reloadCount(master._reloadCount),
+      _upgradeCount(master._upgradeCount),
+      _upgradePid(-1), _previousPid(-1), _nbReady(0), _argc(master._argc),
+      _argv(master._argv), _globalConfig(master._globalConfig),
+      _isWorker(true), _workerID(workerID),
+      _listenerVector(master._listenerVector) {
+  this->_wakeupPipe[0] = -1;
+  this->_wakeupPipe[1] = -1;
+  this->_readyPipe[0] = -1;
+  this->_readyPipe[1] = -1;
+  pthread_mutex_init(&this->_publishMutex, NULL);
+  this->_initTmpServiceInfo();
+  this->_bufferPool.setBufferSize(this->_globalConfig.headerBufferSize);
+  this->_poller = Poller::create(this->_globalConfig.eventBackend);
+  this->_registerListeners(workerID);
+
+  // woken up by the signal handler (the signals are handled by the main thread)
+  try {
+    this->_openWakeupPipe(workerID);
+  } catch (const std::exception &) {
+    delete this->_poller;
+    pthread_mutex_destroy(&this->_publishMutex);
+    throw;
+  }
+  this->_growFdTables(this->_wakeupPipe[0]);
+  this->_poller->addFd(this->_wakeupPipe[0], POLLIN);
+}
+
+/**
+ * @brief Destructor for Service, stops the workers, closes all the sockets
+ * (listening and clients), deletes the clients and the readiness backend.
  */
 Service::~Service() {
 
-  for (size_t i = 0; i < this->_pollingFdVector.size(); i++)
-    close(this->_pollingFdVector.at(i).fd);
-  printInfo(END_MSG, GREEN);
+  for (size_t i = 0; i < this->_workerVector.size(); i++)
+    delete this->_workerVector[i];
+  if (this->_wakeupPipe[0] >= 0) {
+    g_wakeupFds[this->_wakeupSlot] = -1;
+    close(this->_wakeupPipe[0]);
+    close(this->_wakeupPipe[1]);
+  }
+  for (int i = 0; i < 2; i++) {
+    if (this->_readyPipe[i] >= 0)
+      close(this->_readyPipe[i]);
+  }
+
+  for (size_t fd = 0; fd < this->_clientTable.size(); fd++) {
+    if (this->_clientTable[fd]) {
+      delete this->_clientTable[fd];
+      close(fd);
+    } else if (this->_serverIndexByFd[fd] >= 0)
+      close(fd);
+  }
+  delete this->_poller;
+
+  // the workers released their references (and their clients) above
+  for (size_t i = 0; i < this->_generationVector.size(); i++)
+    _dropGeneration(this->_generationVector[i]);
+  if (this->_publishedGeneration)
+    _dropGeneration(this->_publishedGeneration);
+  pthread_mutex_destroy(&this->_publishMutex);
+  if (!this->_isWorker)
+    printInfo(END_MSG, GREEN);
+}
+
+/**
+ * @brief Creates the wake-up pipe of a thread and registers it in
+ * `g_wakeupFds`: the signal handler writes to it.
+ * @param slot Index of the pipe in `g_wakeupFds` (a worker's ID, or
+ * MASTER_WAKEUP for their main thread).
+ */
+void Service::_openWakeupPipe(size_t slot) {
+  if (pipe(this->_wakeupPipe) < 0)
+    throw std::runtime_error(ERR_PIPE + std::string(std::strerror(errno)));
+  for (int i = 0; i < 2; i++) {
+    fcntl(this->_wakeupPipe[i], F_SETFL, O_NONBLOCK);
+    fcntl(this->_wakeupPipe[i], F_SETFD, FD_CLOEXEC);
+  }
+  this->_wakeupSlot = slot;
+  g_wakeupFds[slot] = this->_wakeupPipe[1];
 }
 
 /**
- * @brief function to count the umber of primary server in the _serversVector
- * A server with an existing host and port is NOT a primary server
+ * @brief Makes sure the fd-indexed tables have a slot for `fd`.
  *
- * @return size_t, quantity of primary servers
+ * The kernel always gives the lowest free fd, so the tables stay about the
+ * size of the maximum number of sockets opened at the same time.
  */
-size_t Service::_countPrimaryServers() {
-  serverVector::iterator server = this->_serversVector.begin();
-  size_t count = 0;
+void Service::_growFdTables(int fd) {
+  if (static_cast<size_t>(fd) < this->_clientTable.size())
+    return;
+  this->_clientTable.resize(fd + 1, NULL);
+  this->_serverIndexByFd.resize(fd + 1, -1);
+  this->_eventsByFd.resize(fd + 1, 0);
+  this->_clientServerByFd.resize(fd + 1, -1);
+  this->_clientAddressByFd.resize(fd + 1, 0);
+  this->_generationByFd.resize(fd + 1, NULL);
+}
 
-  for (; server != this->_serversVector.end(); server++) {
-    if (server->getIsPrimary() == true)
-      count++;
-  }
-  return count;
+/**
+ * @brief Getter for the client linked to the current socket.
+ */
+Client &Service::_getClient() {
+  return *this->_clientTable[this->_tmpServiceInfo.clientID];
 }
 
 /**
@@ -68,7 +184,6 @@ void Service::printServiceInfo() {
   std::cout << "Server ID: " << _tmpServiceInfo.serverID << std::endl;
   std::cout << "Connection Socket FD: " << _tmpServiceInfo.connectionSocketFd
             << std::endl;
-  std::cout << "Poll ID: " << _tmpServiceInfo.pollID << std::endl;
   std::cout << "Mode: " << _tmpServiceInfo.mode << std::endl;
   std::cout << "Launch: " << (_tmpServiceInfo.launch ? "true" : "false")
             << std::endl;
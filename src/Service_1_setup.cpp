@@ -23,47 +23,112 @@
  * - Initializes temporary service information for socket setup.
  * - Skips non-primary servers to focus setup on primary ones only.
  * - Retrieves setup information such as socket, host, and port from each primary server.
- * - Sets the socket option to allow the reuse of local addresses.
+ * - Sets the socket option to allow the reuse of local addresses (and port in worker mode).
+ * - Sets the TCP options of the server ('tcp_nodelay', 'so_rcvbuf'...), inherited by the accepted sockets.
  * - Converts the server's host information into a network address format.
  * - Binds the converted address to the server's socket.
  * - Configures the socket to listen for incoming connections.
- * - Adds the configured socket to the `_pollSockVec`, which is used for polling operations.
+ * - Adds the configured socket to the `_listenerVector`.
  * - Resets the temporary service information to ensure clean setup for the next server.
  * 
+ * After a binary upgrade (SIGUSR2), the listening sockets passed by the previous process are adopted
+ * instead of being created and bound again (see Service_7_upgrade.cpp).
+ * 
+ * In worker mode ('worker_threads' > 1), these steps are done once per worker: each worker gets
+ * its own listening socket bound to the same address (SO_REUSEPORT), so the kernel spreads the
+ * incoming connections between the workers.
+ * 
+ * Then the listening sockets are registered in the readiness backend (poll() or epoll) chosen by the
+ * 'event_backend' directive, or in the backend of each worker. With 'worker_processes', this last
+ * step is done by each worker process once forked (see launch()).
  */
 void Service::setup()
 {
 	printInfo(SETUP_MSG, BLUE);
+	this->_getInheritedListeners();
 	
 	std::vector<Server>::iterator server = this->_serversVector.begin();
 	for(; server != this->_serversVector.end(); server++)
 	{
-		this->_initTmpServiceInfo();
-
 		if (!server->getIsPrimary())
 			continue;
 
-		 //get socket, host, port
-		this->_getSetupInfo(server);
-		// std::cout << "TEST 2" << std::endl;
+		int serverID = static_cast<int>(server - this->_serversVector.begin());
 
-		this->_setReuseableAddress();
-		// std::cout << "TEST 3" << std::endl;
+		for (size_t workerID = 0; workerID < this->_globalConfig.workerThreads; workerID++)
+			this->_listenerVector.push_back(this->_createListener(*server, serverID, workerID));
+	}
 
-		this->_convertHostToAddress();
-		// std::cout << "TEST 4" << std::endl;
+	// A backend can't be shared by several processes: each worker process sets up its own after the fork.
+	if (this->_globalConfig.workerProcesses == 0)
+		this->_setupEventLoops();
 
-		this->_bindAddressToSocket();
-		// std::cout << "TEST 5" << std::endl;
+	// after a binary upgrade: the previous process can stop now
+	this->_finishInheritance();
+}
 
-		this->_setSocketListening();
-		// std::cout << "TEST 6" << std::endl;
-		
-		this->_addSocketToPollSockVec();
-		// std::cout << "TEST 7" << std::endl;
+/**
+ * @brief Creates the readiness backend and registers the listening sockets in it, or creates the
+ * workers (each one with its own backend) in worker mode.
+ */
+void Service::_setupEventLoops()
+{
+	if (this->_globalConfig.workerThreads > 1)
+	{
+		this->_setupWorkers();
+		return;
+	}
 
-		this->_resetTmpServiceInfo();
+	this->_poller = Poller::create(this->_globalConfig.eventBackend);
+	printInfo(BACKEND_MSG(this->_poller->getName()), BLUE);
+	this->_registerListeners(0);
+}
+
+/**
+ * @brief Creates a listening socket for a primary server: the setup steps above, from socket() to listen().
+ *
+ * The socket is closed if a step fails, so a failed configuration reload doesn't leak it.
+ * @param server The primary server.
+ * @param serverID Index of the server in its servers vector.
+ * @param workerID Index of the event loop which will survey the socket.
+ */
+listener_t Service::_createListener(Server const &server, int serverID, size_t workerID)
+{
+	listener_t listener;
+
+	this->_initTmpServiceInfo();
+
+	 //get socket, host, port
+	bool inherited = this->_getSetupInfo(server, serverID);
+
+	listener.fd = this->_tmpServiceInfo.listeningSocketFd;
+	listener.serverID = serverID;
+	listener.workerID = workerID;
+	listener.host = server.getHost();
+	listener.port = server.getPort();
+	try
+	{
+		if (!inherited)
+			this->_setReuseableAddress();
+
+		this->_setTcpOptions(server);
+
+		if (!inherited)
+		{
+			this->_convertHostToAddress();
+
+			this->_bindAddressToSocket();
+		}
+
+		this->_setSocketListening(server.getListenBacklog());
+	}
+	catch (...)
+	{
+		close(listener.fd);
+		throw;
 	}
+	this->_resetTmpServiceInfo();
+	return listener;
 }
 
 /**
@@ -81,23 +146,32 @@ void Service::_initTmpServiceInfo()
 
 
 /**
- * The _getSetupInfo function initializes service information based on a server's socket, host, and
- * port.
+ * The _getSetupInfo function creates a new listening socket (or adopts the one passed by the previous
+ * binary) and initializes service information based on a server's host and port.
  * 
- * @param server The `server` parameter is an iterator pointing to an element in a vector of `Server`
- * objects.
+ * @param server The (primary) server of the socket.
+ * @param serverID Index of the server in its servers vector.
+ * @return true if the socket was inherited: it is already bound.
  */
-void Service::_getSetupInfo(std::vector<Server>::iterator server)
+bool Service::_getSetupInfo(Server const &server, int serverID)
 {
-	server->createSocket();
-	this->_tmpServiceInfo.listeningSocketFd = server->getSocket();
-	this->_tmpServiceInfo.host = server->getHost();
-	this->_tmpServiceInfo.port = server->getPort();
+	int inheritedFd = this->_adoptListener(server.getHost(), server.getPort());
+
+	this->_tmpServiceInfo.listeningSocketFd = (inheritedFd >= 0) ? inheritedFd : socket(AF_INET, SOCK_STREAM, 0);
+	if (this->_tmpServiceInfo.listeningSocketFd < 0)
+		throw std::runtime_error(ERR_SOCKET(server.getHost() + ":" + server.getPort()));
+	this->_tmpServiceInfo.host = server.getHost();
+	this->_tmpServiceInfo.port = server.getPort();
+	this->_tmpServiceInfo.serverID = serverID;
 	this->_tmpServiceInfo.launch = false;
+	return (inheritedFd >= 0);
 }
 
 /**
  * @brief Sets the SO_REUSEADDR option (see documentation of 'setsockopt()') for the listening socket to allow reuse of the socket address after its closing .
+ *
+ * In worker mode, SO_REUSEPORT is set too: each worker binds its own socket to the same address and port,
+ * and the kernel balances the new connections between them.
  */
 void Service::_setReuseableAddress()
 {
@@ -107,6 +181,94 @@ void Service::_setReuseableAddress()
 		this->_resetTmpServiceInfo();
 		throw std::runtime_error(ERR_SET_SOCKET + std::string(std::strerror(errno)));
 	}
+	if (this->_globalConfig.workerThreads == 1)
+		return;
+#ifdef SO_REUSEPORT
+	if (setsockopt(this->_tmpServiceInfo.listeningSocketFd, SOL_SOCKET, SO_REUSEPORT, &active, sizeof(int)) < 0)
+	{
+		this->_resetTmpServiceInfo();
+		throw std::runtime_error(ERR_SET_SOCKET + std::string(std::strerror(errno)));
+	}
+#else
+	this->_resetTmpServiceInfo();
+	throw std::runtime_error(ERR_REUSEPORT);
+#endif
+}
+
+/**
+ * @brief Sets the TCP options of a server on its listening socket.
+ *
+ * They are set once per listening socket instead of once per connection: the sockets returned by accept()
+ * inherit them. The buffer sizes are set before listen(), so the TCP window scale announced in the handshake
+ * matches them. An option left to 0 keeps the system's default.
+ * @param server The (primary) server of the listening socket.
+ */
+void Service::_setTcpOptions(Server const &server)
+{
+	const tcpOptions_t &options = server.getTcpOptions();
+
+	if (options.noDelay)
+		this->_setSocketOption(IPPROTO_TCP, TCP_NODELAY, 1, TCP_ND);
+	if (options.rcvBuf > 0)
+		this->_setSocketOption(SOL_SOCKET, SO_RCVBUF, options.rcvBuf, SO_RB);
+	if (options.sndBuf > 0)
+		this->_setSocketOption(SOL_SOCKET, SO_SNDBUF, options.sndBuf, SO_SB);
+	if (options.keepIdle > 0)
+	{
+		this->_setSocketOption(SOL_SOCKET, SO_KEEPALIVE, 1, TCP_KI);
+#ifdef TCP_KEEPIDLE
+		this->_setSocketOption(IPPROTO_TCP, TCP_KEEPIDLE, options.keepIdle, TCP_KI);
+#else
+		this->_setSocketOption(IPPROTO_TCP, TCP_KEEPALIVE, options.keepIdle, TCP_KI);
+#endif
+	}
+	if (options.keepIntvl > 0)
+		this->_setSocketOption(IPPROTO_TCP, TCP_KEEPINTVL, options.keepIntvl, TCP_KV);
+	if (options.keepCnt > 0)
+		this->_setSocketOption(IPPROTO_TCP, TCP_KEEPCNT, options.keepCnt, TCP_KC);
+	if (options.notSentLowat > 0)
+	{
+#ifdef TCP_NOTSENT_LOWAT
+		this->_setSocketOption(IPPROTO_TCP, TCP_NOTSENT_LOWAT, options.notSentLowat, TCP_NL);
+#else
+		this->_resetTmpServiceInfo();
+		throw std::runtime_error(ERR_SOCKET_OPTION(TCP_NL));
+#endif
+	}
+	if (options.deferAccept > 0)
+	{
+#ifdef TCP_DEFER_ACCEPT
+		this->_setSocketOption(IPPROTO_TCP, TCP_DEFER_ACCEPT, options.deferAccept, TCP_DA);
+#else
+		this->_resetTmpServiceInfo();
+		throw std::runtime_error(ERR_SOCKET_OPTION(TCP_DA));
+#endif
+	}
+	if (options.fastOpen > 0)
+	{
+#ifdef TCP_FASTOPEN
+		this->_setSocketOption(IPPROTO_TCP, TCP_FASTOPEN, options.fastOpen, TCP_FO);
+#else
+		this->_resetTmpServiceInfo();
+		throw std::runtime_error(ERR_SOCKET_OPTION(TCP_FO));
+#endif
+	}
+}
+
+/**
+ * @brief Sets an integer option on the listening socket being set up.
+ *
+ * @param directive The directive asking for the option, for the error message.
+ */
+void Service::_setSocketOption(int level, int name, int value, char const *directive)
+{
+	if (setsockopt(this->_tmpServiceInfo.listeningSocketFd, level, name, &value, sizeof(int)) < 0)
+	{
+		int error = errno;
+
+		this->_resetTmpServiceInfo();
+		throw std::runtime_error(ERR_SET_SOCKET + std::string(directive) + ": " + std::string(std::strerror(error)));
+	}
 }
 
 /**
@@ -122,7 +284,6 @@ void Service::_resetTmpServiceInfo()
 	std::memset(&this->_tmpServiceInfo.parameters, 0, sizeof(this->_tmpServiceInfo.parameters));
 	this->_tmpServiceInfo.host.clear();
 	this->_tmpServiceInfo.port.clear();
-	this->_tmpServiceInfo.pollID = 0;
 	this->_tmpServiceInfo.clientID = 0;
 	this->_tmpServiceInfo.serverID = 0;
 	this->_tmpServiceInfo.listeningSocketFd = 0;
@@ -169,19 +330,27 @@ void Service::_bindAddressToSocket()
 
 /**
  * The function _setSocketListening sets the socket to listening mode with a specified maximum number
- * of pending connections.
+ * of pending connections (the 'listen_backlog' of its server).
+ *
+ * The socket is non-blocking: when several worker processes survey the same listening socket, they are
+ * all woken up by a new connection, and accept() must not block the ones which lose the race.
+ * @param backlog The 'listen_backlog' of the server.
  */
-void Service::_setSocketListening()
+void Service::_setSocketListening(int backlog)
 {
-	if (listen(this->_tmpServiceInfo.listeningSocketFd, MAX_PENDING) < 0)
+	if (listen(this->_tmpServiceInfo.listeningSocketFd, backlog) < 0)
 	{
 		this->_resetTmpServiceInfo();
 		throw std::runtime_error(ERR_LISTEN_SOCKET + std::string(std::strerror(errno)));
 	}
+	fcntl(this->_tmpServiceInfo.listeningSocketFd, F_SETFL, O_NONBLOCK);
 }
 
 /**
- * @brief Adds the configured socket to the polling vector for monitoring (polling).
+ * @brief Registers the configured socket in the readiness backend for monitoring (polling).
+ *
+ * A listening socket also gets its server index in the `_serverIndexByFd` table, so it can be
+ * recognised with a single lookup when it reports an event.
  */
 void Service::_addSocketToPollSockVec()
 {
@@ -189,9 +358,9 @@ void Service::_addSocketToPollSockVec()
 
 	if (this->_tmpServiceInfo.launch == true) //we are surveying a Client socket
 	{
-		//the 'connection Socket' is set to listen or read (POLLIN | POLLOUT)" 
+		//the 'connection Socket' is set to read (POLLIN): POLLOUT is only surveyed while a response is pending
 		pollSocket.fd = this->_tmpServiceInfo.connectionSocketFd;
-		pollSocket.events = POLLIN | POLLOUT;
+		pollSocket.events = POLLIN;
 	}
 	else //we are surveying a Server socket
 	{
@@ -200,6 +369,35 @@ void Service::_addSocketToPollSockVec()
 		pollSocket.events = POLLIN;
 	}
 	pollSocket.revents = 0;
+	this->_growFdTables(pollSocket.fd);
+	if (this->_tmpServiceInfo.launch == false)
+	{
+		this->_serverIndexByFd[pollSocket.fd] = this->_tmpServiceInfo.serverID;
+		this->_listeningFdVector.push_back(pollSocket.fd);
+	}
+	this->_eventsByFd[pollSocket.fd] = pollSocket.events;
 	//the socket is added to the poll
-	this->_pollingFdVector.push_back(pollSocket);
+	if (this->_tmpServiceInfo.launch == true)
+		this->_poller->addConnection(pollSocket.fd, pollSocket.events);
+	else
+		this->_poller->addListener(pollSocket.fd);
+}
+
+/**
+ * @brief Registers in the readiness backend the listening sockets of a worker (worker 0 without worker mode).
+ *
+ * @param workerID Index of the worker whose listening sockets are registered.
+ */
+void Service::_registerListeners(size_t workerID)
+{
+	for (size_t i = 0; i < this->_listenerVector.size(); i++)
+	{
+		if (this->_listenerVector[i].workerID != workerID)
+			continue;
+		this->_resetTmpServiceInfo();
+		this->_tmpServiceInfo.listeningSocketFd = this->_listenerVector[i].fd;
+		this->_tmpServiceInfo.serverID = this->_listenerVector[i].serverID;
+		this->_addSocketToPollSockVec();
+	}
+	this->_resetTmpServiceInfo();
 }
@@ -11,48 +11,219 @@
 #include "utils.hpp"
 
 /**
- * The `launch` function continuously initializes and polls a list of sockets
- * until a shutdown signal is received.
+ * The `launch` function runs the event loop, or starts the workers' event
+ * loops (one per thread) in worker mode, or forks the worker processes.
  */
 void Service::launch() {
   printInfo(LAUNCH_MSG, BLUE);
 
+  if (this->_globalConfig.workerProcesses > 0)
+    this->_launchProcesses();
+  else
+    this->_launchEventLoops();
+}
+
+/**
+ * The `_launchEventLoops` function runs the event loop, or the workers' event
+ * loops (one per thread) in worker mode.
+ */
+void Service::_launchEventLoops() {
+  if (this->_workerVector.empty())
+    this->_launch();
+  else
+    this->_launchWorkers();
+}
+
+/**
+ * The `_launch` function (the event loop) continuously initializes and polls
+ * a list of sockets until a shutdown signal is received.
+ *
+ * After SIGTERM or SIGQUIT, it goes on until its connections are finished or
+ * the 'shutdown_timeout' is over. After SIGHUP, it reloads the configuration
+ * (in a worker process, the master replaces the whole process instead).
+ * After SIGUSR2, the first event loop starts the new binary.
+ */
+void Service::_launch() {
+  long start = this->_now;
+  long cpuStart = getThreadCpuTime();
+  bool isReady = false;
+
   while (g_shutdown == false) {
+    // graceful shutdown: stop accepting, then wait for the connections to end
+    if (g_drain && this->_drainDeadline == 0)
+      this->_startDrain();
+    if (this->_drainDeadline != 0 && this->_isDrained())
+      break;
+    // reload: in a single event loop, it parses the configuration in a
+    // thread; a worker thread adopts the ones published by its main thread
+    if (this->_master == this)
+      this->_checkReload();
+    else
+      this->_checkPublished();
+    if (this->_upgradeCount != g_upgrade) {
+      this->_upgradeCount = g_upgrade;
+      if (this->_globalConfig.workerProcesses == 0 && this->_workerID == 0 &&
+          this->_drainDeadline == 0)
+        this->_startUpgrade();
+    }
+    if (this->_upgradePid > 0)
+      this->_checkUpgrade();
+
     // init the list (table) of polling sockets
     this->_initPollingVector();
+    if (!isReady) {
+      isReady = true;
+      this->_reportReady(); // after a binary upgrade: stops the previous one
+    }
 
     // loop on each socket of the list to check if there is a signal (something
     // to read, send, error). Note: each Service (aka Server bloc) has a socket
     this->_pollingManager();
+
+    // close the connections whose timeout is over
+    this->_expireTimers();
   }
+  this->_stopParsing();
+  if (g_shutdown && this->_reportsSignals())
+    printInfo(SHUTDOWN_MSG, GREEN);
+  this->_printLoopStats(start, cpuStart);
 }
 
 /**
- * The function _initPollingVector() uses poll() to survey file descriptors
- * without blocking the main process and throws an error if the poll operation
- * fails.
+ * @brief Checks if this event loop prints the signals it sees: the only one,
+ * or the first worker thread. With worker processes, the master prints them.
+ */
+bool Service::_reportsSignals() const {
+  return (this->_globalConfig.workerProcesses == 0 &&
+          (this->_wakeupPipe[0] < 0 || this->_workerID == 0));
+}
+
+/**
+ * @brief Prints how often the event loop woke up and the CPU time it used.
+ *
+ * An idle loop should only wake up for the nearest timeout (at most once per
+ * POLL_TIME_OUT) and use almost no CPU.
+ * @param start Time (ms, monotonic clock) when the loop started.
+ * @param cpuStart CPU time (ms) of the thread when the loop started.
+ */
+void Service::_printLoopStats(long start, long cpuStart) {
+  long seconds = std::max(1L, (getMonotonicTime() - start) / 1000);
+
+  printInfo(LOOP_STATS_MSG(this->_workerID, seconds, this->_nbWakeups,
+                           this->_nbEvents, getThreadCpuTime() - cpuStart),
+            BLUE);
+}
+
+/**
+ * The function _initPollingVector() waits for events with the readiness
+ * backend (poll() or epoll) without blocking the main process and throws an
+ * error if the wait fails.
+ *
+ * The wait ends at the latest when the nearest connection's timeout expires
+ * (or after POLL_TIME_OUT), then the cached clock is updated for the whole
+ * iteration.
  */
 void Service::_initPollingVector() {
-  // poll() is used to survey file descriptors (=sockets) without blocking the
-  // main process. It sends a signal when a socket is ready to read, listen or
-  // get an error
-  if (poll(this->_pollingFdVector.data(), this->_pollingFdVector.size(),
-           POLL_TIME_OUT) < 0 &&
-      g_shutdown == false)
+  // The backend surveys file descriptors (=sockets) without blocking the
+  // main process. It returns when a socket is ready to read, listen or
+  // get an error, and only keeps the sockets which reported something.
+  int timeout = this->_timerWheel.getTimeout(this->_now, POLL_TIME_OUT);
+
+  if (this->_drainDeadline != 0)
+    timeout = std::max(0L, std::min(static_cast<long>(timeout),
+                                    this->_drainDeadline - this->_now));
+  if (this->_isParsing)
+    timeout = std::min(timeout, RELOAD_POLL_TIME_OUT);
+  int nbReady = this->_poller->wait(timeout);
+
+  if (nbReady < 0 && errno != EINTR && g_shutdown == false)
     throw std::runtime_error(ERR_POLL_FAIL + std::string(std::strerror(errno)));
+  this->_now = getMonotonicTime();
+  this->_nbWakeups++;
+  if (nbReady > 0)
+    this->_nbEvents += nbReady;
+}
+
+/**
+ * @brief (Re)arms the timer of the current client with the deadline of what
+ * its connection is waiting for (see Client::getDeadline()).
+ */
+void Service::_updateTimer() {
+  int fd = this->_tmpServiceInfo.clientID;
+
+  if (this->_clientTable[fd] == NULL)
+    return; // the connection was closed
+  this->_timerWheel.schedule(fd, this->_clientTable[fd]->getDeadline());
+}
+
+/**
+ * @brief Surveys the events the current client's connection is waiting for.
+ *
+ * POLLIN while a request can be received, POLLOUT only while a response is
+ * pending: a connection with nothing to send doesn't wake the loop up. The
+ * reading stops while the output queue is full, so the kernel's buffers (and
+ * TCP flow control) hold the client back. The backend is only called when the
+ * events change.
+ */
+void Service::_updateInterest() {
+  int fd = this->_tmpServiceInfo.clientID;
+  Client *client = this->_clientTable[fd];
+
+  if (client == NULL)
+    return; // the connection was closed
+  short events = 0;
+  if (!client->isOutputFull())
+    events |= POLLIN;
+  if (client->hasPendingResponse())
+    events |= POLLOUT;
+  if (events == this->_eventsByFd[fd])
+    return;
+  this->_poller->modifyFd(fd, events);
+  this->_eventsByFd[fd] = events;
+}
+
+/**
+ * @brief Closes the connections whose deadline is over.
+ */
+void Service::_expireTimers() {
+  std::vector<int> expiredVector;
+
+  this->_timerWheel.advance(this->_now, expiredVector);
+  for (size_t i = 0; i < expiredVector.size(); i++) {
+    if (expiredVector[i] == this->_acceptPauseFd) {
+      this->_resumeAccept(); // the accept pause is over
+      continue;
+    }
+    if (this->_clientTable[expiredVector[i]] == NULL)
+      continue;
+    this->_resetTmpServiceInfo();
+    this->_tmpServiceInfo.clientID = expiredVector[i];
+    this->_tmpServiceInfo.listeningSocketFd = expiredVector[i];
+    this->_closeConnection(TIMEOUT_MSG);
+  }
 }
 
 /**
- * The function `_pollingManager` iterates through a vector of socket file
- * descriptors, resets temporary service information, retrieves launch
+ * The function `_pollingManager` iterates through the sockets reported as
+ * ready by the backend, resets temporary service information, retrieves launch
  * information, handles errors, and performs actions based on the socket mode
  * (POLLIN or POLLOUT).
+ *
+ * The requests are handled as soon as they are received, and their responses
+ * are sent at once: POLLOUT is only awaited for what the socket couldn't take.
  */
 void Service::_pollingManager() {
-  // Loop on each socket in the polling vector containign the socket's fd
-  for (size_t i = 0; i < this->_pollingFdVector.size(); i++) {
+  const std::vector<pollfd> &readyVector = this->_poller->getReadyVector();
+
+  // Loop on each socket which reported an event (and only on them)
+  for (size_t i = 0; i < readyVector.size(); i++) {
+    if (readyVector[i].fd == this->_wakeupPipe[0]) {
+      this->_clearWakeups(); // a signal: seen at the next iteration
+      continue;
+    }
     this->_resetTmpServiceInfo();
-    this->_getLaunchInfo(i);
+    if (!this->_getLaunchInfo(readyVector[i]))
+      continue; // the socket was closed earlier in this loop
 
     // Handle errors first
     if (this->_hasBadRequest())
@@ -72,6 +243,8 @@ void Service::_pollingManager() {
            std::cerr << "Error occurred: " << e.what() << std::endl;
            this->_closeConnection("Closing connection due to error.");
         }
+        if (this->_clientTable[this->_tmpServiceInfo.clientID] != NULL)
+          this->_sendDataToClient();
        }
     } else if (this->_tmpServiceInfo.mode &
                POLLOUT) // Ready to send data (POLLOUT)
@@ -82,28 +255,27 @@ void Service::_pollingManager() {
 }
 
 /**
- * @brief  @brief Retrieves launch-specific information for each socket in the
- * polling vector.
+ * @brief  @brief Retrieves launch-specific information for each socket
+ * reported as ready by the backend.
  *
- * For example: assigns a unique client ID to the socket based on its index in
- * the polling vector.
+ * For example: the client ID is the slot of the client in the client table.
+ * The table is indexed by the socket's fd, so the ID is the fd itself and
+ * the client is found without any search.
  *
- * The client ID is calculated by subtracting the number of primary servers
- * (listening sockets) from the current index in the polling vector. This is
- * because the first `nbPrimaryServers` entries in the polling vector correspond
- * to listening sockets, and the subsequent entries represent client
- * connections. Therefore, the client IDs start after the primary servers'
- * indices and provide a zero-based index for client connections.
- *
- * @param i Index of the socket in the polling vector.
+ * @param ready The socket's fd and the events it reported.
+ * @return false if the socket is neither a listening socket nor a client's
+ * socket anymore (closed earlier in this loop).
  */
-void Service::_getLaunchInfo(int const i) {
-  this->_tmpServiceInfo.pollID = i;
-  this->_tmpServiceInfo.clientID = i - this->_nbPrimaryServers;
-  this->_tmpServiceInfo.listeningSocketFd = this->_pollingFdVector.at(i).fd;
-  this->_tmpServiceInfo.mode = this->_pollingFdVector.at(i).revents;
+bool Service::_getLaunchInfo(pollfd const &ready) {
+  if (ready.fd < 0 || static_cast<size_t>(ready.fd) >= this->_clientTable.size())
+    return false;
+
+  this->_tmpServiceInfo.clientID = ready.fd;
+  this->_tmpServiceInfo.listeningSocketFd = ready.fd;
+  this->_tmpServiceInfo.mode = ready.revents;
   this->_tmpServiceInfo.serverID = this->_getServerIndex();
   this->_tmpServiceInfo.launch = true;
+  return (this->_isServerSocket() || this->_clientTable[ready.fd] != NULL);
 }
 
 /**
@@ -111,22 +283,41 @@ void Service::_getLaunchInfo(int const i) {
  * @return True if socket belongs to a server, false otherwise.
  */
 bool Service::_isServerSocket() {
-  // the socket can be a server or a client socket. We compare the socket to the
-  // server's list sockets to know if it's a server or a client
-  std::vector<Server>::iterator server = this->_serversVector.begin();
-  for (; server != this->_serversVector.end(); server++) {
-    if (server->getSocket() == this->_tmpServiceInfo.listeningSocketFd)
-      return true;
-  }
-  return false;
+  // the socket can be a server or a client socket. The listening sockets have
+  // their server index in the fd-indexed table.
+  return (this->_serverIndexByFd[this->_tmpServiceInfo.listeningSocketFd] >= 0);
 }
 
 /**
- * The `_acceptConnection` function accepts a new connection on the server side,
- * creates a new socket for the client, sets it to non-blocking mode, and adds
- * the client to a vector of clients associated with the server.
+ * The `_acceptConnection` function accepts the pending connections of a
+ * listening socket, until there is none left or ACCEPT_BATCH were accepted
+ * (the other ready sockets are not kept waiting during a burst: the listening
+ * socket is still ready at the next iteration).
+ *
+ * With 'overload_action stop', it also stops once a 'max_connections' is
+ * reached, and the listening sockets are no longer surveyed until a
+ * connection is closed.
  */
 void Service::_acceptConnection() {
+  bool stopWhenFull = (this->_globalConfig.overloadAction == OVERLOAD_STOP);
+
+  for (int nbAccepted = 0; nbAccepted < ACCEPT_BATCH; nbAccepted++) {
+    if (this->_acceptPauseFd >= 0 ||
+        (stopWhenFull && this->_isOverloaded(this->_tmpServiceInfo.serverID)))
+      break;
+    if (!this->_acceptOneConnection())
+      break;
+  }
+  this->_updateListeners();
+}
+
+/**
+ * The `_acceptOneConnection` function accepts a new connection on the server
+ * side, creates a new (non-blocking) socket for the client, and adds the
+ * client to the client table (in the slot of its socket's fd).
+ * @return false if there is no pending connection left.
+ */
+bool Service::_acceptOneConnection() {
   /*
           - accept() a connection on the server side means create a new
      connectionSocketFd for the client .
@@ -135,39 +326,74 @@ void Service::_acceptConnection() {
      connexion
   */
 
-  this->_tmpServiceInfo.connectionSocketFd =
-      accept(this->_tmpServiceInfo.listeningSocketFd, NULL, NULL);
+  sockaddr_in address;
 
-  if (this->_tmpServiceInfo.connectionSocketFd < 0)
-    throw std::runtime_error(ERR_ACCEPT_SOCKET);
+  // accept4() (or accept()), or a connection the backend already accepted
+  this->_tmpServiceInfo.connectionSocketFd =
+      this->_poller->accept(this->_tmpServiceInfo.listeningSocketFd, address);
+
+  if (this->_tmpServiceInfo.connectionSocketFd < 0) {
+    // The listening socket is non-blocking and may be shared with other worker
+    // processes: the connection was already taken.
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+      return false;
+    // No fd (or memory) left: the pending connections wait in the backlog
+    // instead of waking the loop up again and again.
+    if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS ||
+        errno == ENOMEM) {
+      this->_pauseAccept();
+      return false;
+    }
+    if (errno == EBADF || errno == EINVAL || errno == ENOTSOCK ||
+        errno == EFAULT)
+      throw std::runtime_error(ERR_ACCEPT_SOCKET);
+    return true; // aborted by the client, network error: only this connection
+  }
 
+#ifndef __linux__
   // fctnl() can set socket to non-blocking
   fcntl(this->_tmpServiceInfo.connectionSocketFd, F_SETFL, O_NONBLOCK);
+  fcntl(this->_tmpServiceInfo.connectionSocketFd, F_SETFD, FD_CLOEXEC);
+#endif
+
+  // check the connection limits
+  this->_growFdTables(this->_tmpServiceInfo.connectionSocketFd);
+  if (!this->_admitConnection(this->_tmpServiceInfo.connectionSocketFd,
+                              address.sin_addr.s_addr)) {
+    this->_rejectConnection(this->_tmpServiceInfo.connectionSocketFd);
+    return true;
+  }
 
-  // push a new (instance of) Client "linked" to the server (with the serverID and the socket fd) in the Client vector
-  this->_clientVector.push_back(
-      Client(this->_serversVector.at(this->_tmpServiceInfo.serverID),
-             this->_tmpServiceInfo.connectionSocketFd));
+  // put a new (instance of) Client "linked" to the server (with the serverID and the socket fd) in the slot of its fd
+  this->_clientTable[this->_tmpServiceInfo.connectionSocketFd] =
+      new Client(this->_servers->at(this->_tmpServiceInfo.serverID),
+                 this->_tmpServiceInfo.connectionSocketFd, this->_now,
+                 this->_bufferPool);
+  this->_nbClients++;
+  this->_generationByFd[this->_tmpServiceInfo.connectionSocketFd] = this->_servers;
+  this->_nbClientsByGeneration[this->_servers]++;
 
   // update the list of socket with the first client
   this->_addSocketToPollSockVec();
+
+  // the client has 'client_header_timeout' to send its first request
+  this->_tmpServiceInfo.clientID = this->_tmpServiceInfo.connectionSocketFd;
+  this->_updateTimer();
+  return true;
 }
 
 /**
  * The function `_readDataFromClient` reads data from a client socket into the
- * buffer and appends it to a vector, with an option to close the connection if
- * no data is received.
+ * client's receive buffer, with an option to close the connection if no data
+ * is received. The request is routed as soon as its headers are received.
  */
 void Service::_readDataFromClient() {
-  char buffer[BUFFER_SIZE] = {0};
-
-	//the buffer is filled with the content passing to the listeningSocketFd then the content is "read" with recv()
-	int		bytes;
-	while ((bytes = recv(this->_tmpServiceInfo.listeningSocketFd, buffer, BUFFER_SIZE, 0)) > 0)
-	{
-		// Append the received data to the client's request
-        this->_clientVector.at(this->_tmpServiceInfo.clientID).appendRequest(buffer, bytes);
-	}
+	// recv() writes to the client's receive buffer (from the pool) and the client parses the new bytes
+	// stops at the end of the request: a rejected request's body is not read, the next requests wait for their turn
+	Client	&client = this->_getClient();
+	ssize_t	bytes = 1;
+	while (!client.clientIsReadyToReceive() && (bytes = client.receiveRequest(*this->_poller, this->_now)) > 0)
+        this->_routeRequest();
 	if (bytes == 0) // Client disconnected
     {
         std::cerr << "[INFO] Client ID " << this->_tmpServiceInfo.clientID 
@@ -176,17 +402,14 @@ void Service::_readDataFromClient() {
     }
     else if (bytes < 0) // Error occurred during recv
     {
-        std::cerr << "[ERROR] Failed to read data from client ID " 
-                  << this->_tmpServiceInfo.clientID 
-                  << " (errno: " << errno << ")." << std::endl;
 		if (errno == EAGAIN || errno == EWOULDBLOCK) {
             return; // Retry mechanism for non-blocking socket
         }
-		std::cerr << "[ERROR] recv failed (errno: " << errno << ")." << std::endl;
+        std::cerr << "[ERROR] Failed to read data from client ID " 
+                  << this->_tmpServiceInfo.clientID 
+                  << " (errno: " << errno << ")." << std::endl;
         this->_closeConnection(EMPTY_MSG);
     }
-		// DEBUGG: read the request
-		std::cout << "in '_readDataFromClient:: buffer : " << buffer << std::endl;
 }
 
 /**
@@ -213,26 +436,57 @@ bool Service::_hasBadRequest() {
 
 /**
  * @brief Sends response data to the client.
+ *
+ * Every complete request already received is handled in order (pipelining), their responses are queued in the
+ * client's output queue and sent together. The queue is drained over the next POLLOUTs, and no new request is
+ * handled while it is full (backpressure): a slow client only holds its own connection.
+ * Called after each read too: the socket is usually writable, so the response goes out without waiting for POLLOUT.
  */
 void Service::_sendDataToClient() {
-  // check the timeout (= if the connection and the server are fast enough)
-  if (this->_clientVector.at(this->_tmpServiceInfo.clientID).isTimeout()) {
-    this->_closeConnection(TIMEOUT_MSG);
+  Client &client = this->_getClient();
+
+  try {
+    do {
+      // check if the client is ready to receive datas from server (=has finish to send)
+      while (client.clientIsReadyToReceive() && !client.isOutputFull()) {
+        client.handleClientRequest();
+        if (!client.isKeepAlive())
+          break;
+        // the next pipelined request may be waiting for its route
+        this->_routeRequest();
+      }
+      // send
+      if (client.hasPendingResponse())
+        client.sendPendingResponse(this->_now);
+      // the queue has room again: the next pipelined requests are handled now
+    } while (client.isKeepAlive() && client.clientIsReadyToReceive() &&
+             !client.isOutputFull());
+  } catch (const std::runtime_error &e) {
+    std::cerr << "Error occurred: " << e.what() << std::endl;
+    this->_closeConnection("Closing connection due to error.");
     return;
   }
 
-  // check if the client is ready to receive datas from server (=has finish to send)
-  if (!this->_clientVector.at(this->_tmpServiceInfo.clientID)
-           .clientIsReadyToReceive())
+  // keep-alive: the client stays in the table and waits for its next request
+  if (!client.hasPendingResponse() && !client.isKeepAlive()) {
+    this->_closeConnection(EMPTY_MSG);
     return;
+  }
+  // the timeout and the surveyed events depend on what the connection waits for now
+  this->_updateTimer();
+  this->_updateInterest();
+}
 
-  // chek if the server is available to send the request
+/**
+ * @brief Routes the client's request once its headers are received: the server
+ * of its `Host` header is chosen first, so the request is checked against that
+ * server's locations and 'client_max_body_size'.
+ */
+void Service::_routeRequest() {
+  if (!this->_getClient().isWaitingForRoute())
+    return;
   this->_checkRequestedServer();
-
-  // send
-  this->_clientVector.at(this->_tmpServiceInfo.clientID).handleClientRequest();
-
-  this->_closeConnection(EMPTY_MSG);
+  this->_getClient().routeRequest();
 }
 
 /**
@@ -251,7 +505,8 @@ void Service::_sendDataToClient() {
  *    - If the requested host matches one of the default server's names, the
  * function exits as no change is needed.
  * 4. If the host does not match the default server, iterates over all servers
- * in `_serversVector` to find a matching server name.
+ * in `_serversVector` to find a matching server name (the servers the
+ * connection was accepted with, even if the configuration was reloaded since).
  *    - If a match is found, updates the client's associated server to the
  * matching server.
  * 5. If no matching server is found, the client's association remains
@@ -261,33 +516,23 @@ void Service::_sendDataToClient() {
  * host specified in their request.
  */
 void Service::_checkRequestedServer() {
-  // 1. Get the client's request (to know who is the requested server)
-  std::string request =
-      this->_clientVector.at(this->_tmpServiceInfo.clientID).getRequest();
-  std::string requestedHost;
+  // 1. Get the `Host` header of the request (found by the parser)
+  std::string requestedHost = this->_getClient().getHeader(HEADER_HOST);
   size_t pos;
 
-  // 2. Get the "host key" in the request
-  if ((pos = request.find(REQUEST_HOST)) != std::string::npos) {
-    // 3. Get the server name in the "host key"
-    requestedHost = request.substr(pos + std::strlen(REQUEST_HOST));
-    if ((pos = requestedHost.find(CURSOR_NEWLINE)) != std::string::npos)
-      requestedHost = requestedHost.substr(0, pos);
-  } else {
-    // If REQUEST_HOST is not found, exit the function
+  // If there is no `Host` header, exit the function
+  if (requestedHost.empty())
     return;
-  }
 
   // Remove port number from the server name
   if ((pos = requestedHost.find(":")) != std::string::npos)
     requestedHost = requestedHost.substr(0, pos);
 
   // Get the server associated with the client by default
-  Server defaultServer =
-      this->_clientVector.at(this->_tmpServiceInfo.clientID).getServer();
+  const Server &defaultServer = this->_getClient().getServer();
 
   // Find if the requested host from the HTTP request corresponds to one of the server's names
-  std::vector<std::string> serverNames = defaultServer.getServerNameVector();
+  const std::vector<std::string> &serverNames = defaultServer.getServerNameVector();
   if (std::find(serverNames.begin(), serverNames.end(), requestedHost) !=
       serverNames.end()) {
     return; // Already using the correct server, exit
@@ -295,15 +540,15 @@ void Service::_checkRequestedServer() {
 
   // If it does not correspond, loop on each server in the `_serversVector` to
   // find the correct server's name
-  std::vector<Server>::iterator itServer = this->_serversVector.begin();
-  for (; itServer != this->_serversVector.end(); ++itServer) {
-    Server tmp = *itServer;
-    // Store the server names in a local variable
-    std::vector<std::string> serverNames = tmp.getServerNameVector();
+  const std::vector<Server> &servers =
+      *this->_generationByFd[this->_tmpServiceInfo.clientID];
+  std::vector<Server>::const_iterator itServer = servers.begin();
+  for (; itServer != servers.end(); ++itServer) {
+    const std::vector<std::string> &serverNames = itServer->getServerNameVector();
 
     if (std::find(serverNames.begin(), serverNames.end(), requestedHost) !=
         serverNames.end()) {
-      _clientVector.at(_tmpServiceInfo.clientID).changeServer(*itServer);
+      this->_getClient().changeServer(*itServer);
 
       return;
     }
@@ -312,13 +557,24 @@ void Service::_checkRequestedServer() {
 
 /**
  * @brief Close connection and delete socket's file descriptor
+ *
+ * The socket is removed from the backend before being closed, then its slot
+ * in the fd-indexed tables is freed: nothing else is moved or copied.
  */
 void Service::_closeConnection(std::string const &msg) {
-  close(this->_tmpServiceInfo.listeningSocketFd);
-  this->_pollingFdVector.erase(this->_pollingFdVector.begin() +
-                               this->_tmpServiceInfo.pollID);
-  this->_clientVector.erase(this->_clientVector.begin() +
-                            this->_tmpServiceInfo.clientID);
+  int fd = this->_tmpServiceInfo.listeningSocketFd;
+
+  this->_poller->removeFd(fd);
+  this->_timerWheel.cancel(fd);
+  close(fd);
+  if (this->_clientTable[fd]) {
+    delete this->_clientTable[fd];
+    this->_clientTable[fd] = NULL;
+    this->_nbClients--;
+    this->_releaseConnection(fd);
+    this->_releaseGeneration(fd);
+  }
+  this->_serverIndexByFd[fd] = -1;
   if (!msg.empty())
     printInfo(msg, RED);
 }
@@ -327,28 +583,15 @@ void Service::_closeConnection(std::string const &msg) {
  * @brief Determines the index of the server associated with the current socket
  * in the servers vector.
  *
- * This function iterates through the `_serversVector` to find the server whose
- * listening socket matches the socket file descriptor stored in
- * `_tmpServiceInfo.listeningSocketFd`. The index of this server in the vector
- * is returned.
+ * The index of each listening socket is stored in `_serverIndexByFd` during
+ * the setup, so it is a single lookup.
  *
  * @return The index of the matching server within the `_serversVector` as an
- * integer. Returns 0 if no match is found.
- *
- * @note This function assumes that each server has a unique listening socket,
- * and it is used to identify servers in contexts where multiple servers are
- * managed by the service.
+ * integer. Returns 0 if the socket is not a listening socket.
  */
 int Service::_getServerIndex() {
-  // get un SERVER index for for each SERVER serviceInfo. There is a CLIENT
-  // index for CLIENT Service Info. To know if the ServiceInfo is a SERVER, we
-  // compare its socket to the socket in ServersVector.
-  std::vector<Server>::iterator server = this->_serversVector.begin();
-  for (; server != this->_serversVector.end(); server++) {
-    if (server->getSocket() == this->_tmpServiceInfo.listeningSocketFd) {
-
-      return static_cast<int>(server - this->_serversVector.begin());
-    }
-  }
-  return 0;
+  int serverIndex =
+      this->_serverIndexByFd[this->_tmpServiceInfo.listeningSocketFd];
+
+  return (serverIndex < 0 ? 0 : serverIndex);
 }
@@ -0,0 +1,363 @@
+/**
+ * @file Service_3_workers.cpp
+ * @brief Implementation of the worker modes of the Service: N independent
+ * event loops, one per thread, and/or N worker processes forked by a master.
+ *
+ * Each worker is a Service with its own readiness backend, clients and
+ * listening sockets (bound with SO_REUSEPORT), so the workers never share
+ * mutable state. The servers vector of the master is shared read-only, as
+ * the configurations it reloads (see Service_6_reload.cpp).
+ *
+ * Worker processes are forked after the setup: they inherit the listening
+ * sockets and the configuration, then each one runs its own event loop(s).
+ */
+
+#include "Service.hpp"
+#include "utils.hpp"
+
+/**
+ * @brief Creates one worker per thread, each one registering its own
+ * listening sockets in its own backend.
+ *
+ * The workers' threads don't get the signals: the handler writes to the pipe
+ * of every worker, so they see `g_shutdown` or `g_drain` at once.
+ */
+void Service::_setupWorkers() {
+  for (size_t workerID = 0; workerID < this->_globalConfig.workerThreads;
+       workerID++)
+    this->_workerVector.push_back(new Service(*this, workerID));
+  printInfo(BACKEND_MSG(this->_workerVector[0]->_poller->getName()), BLUE);
+}
+
+/**
+ * @brief Starts a thread for each worker, reloads the configuration for them
+ * until a shutdown signal, then waits for them to stop.
+ *
+ * The signals are blocked in the workers' threads (the mask is inherited
+ * from the creating thread), so SIGINT, SIGTERM, SIGQUIT, SIGHUP and SIGUSR2
+ * are always handled by the main thread.
+ * The handler sets `g_shutdown` (or `g_drain`), which stops every event loop.
+ */
+void Service::_launchWorkers() {
+  std::vector<pthread_t> threadVector(this->_workerVector.size());
+  sigset_t signals;
+  sigset_t previousSignals;
+  size_t nbStarted = 0;
+  int error = 0;
+
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigaddset(&signals, SIGQUIT);
+  sigaddset(&signals, SIGHUP);
+  sigaddset(&signals, SIGUSR2);
+  this->_openWakeupPipe(MASTER_WAKEUP);
+  pthread_sigmask(SIG_BLOCK, &signals, &previousSignals);
+
+  printInfo(WORKERS_MSG(this->_workerVector.size()), BLUE);
+  for (; nbStarted < this->_workerVector.size(); nbStarted++) {
+    error = pthread_create(&threadVector[nbStarted], NULL,
+                           &Service::_workerRoutine,
+                           this->_workerVector[nbStarted]);
+    if (error != 0) {
+      g_shutdown = true;
+      wakeUpEventLoops();
+      break;
+    }
+  }
+  pthread_sigmask(SIG_SETMASK, &previousSignals, NULL);
+
+  if (error == 0)
+    this->_superviseWorkers();
+  for (size_t i = 0; i < nbStarted; i++)
+    pthread_join(threadVector[i], NULL);
+
+  if (error != 0)
+    throw std::runtime_error(ERR_THREAD + std::string(std::strerror(error)));
+}
+
+/**
+ * @brief Main thread in worker mode: reloads the configuration on SIGHUP
+ * until a shutdown signal (see Service_6_reload.cpp).
+ *
+ * The configuration is parsed, checked and its new listening sockets bound
+ * once, here, then published to the workers, which adopt it. The next one is
+ * published once every worker adopted this one: until then, a SIGHUP waits.
+ * In a worker process, the master reloads: the threads keep theirs.
+ */
+void Service::_superviseWorkers() {
+  pollfd wakeup;
+
+  wakeup.fd = this->_wakeupPipe[0];
+  wakeup.events = POLLIN;
+  while (g_shutdown == false && g_drain == false) {
+    bool isPending = (this->_reloadCount != g_reload &&
+                      this->_globalConfig.workerProcesses == 0);
+
+    if (isPending && this->_isAdopted()) {
+      this->_reloadCount = g_reload;
+      isPending = false;
+      printInfo(RELOAD_MSG, GREEN);
+
+      configGeneration_t *generation = this->_parseGeneration();
+
+      if (generation && this->_reloadListeners(*generation))
+        this->_publishGeneration(generation);
+      else
+        delete generation;
+    }
+    poll(&wakeup, 1, isPending ? RELOAD_POLL_TIME_OUT : -1);
+    this->_clearWakeups();
+  }
+}
+
+/**
+ * @brief Entry point of a worker's thread: runs its event loop.
+ *
+ * An exception can't leave a thread, so it stops the whole Service instead
+ * (as it does without worker mode).
+ * @param worker The worker Service.
+ */
+void *Service::_workerRoutine(void *worker) {
+  Service *self = static_cast<Service *>(worker);
+
+  try {
+    self->_launch();
+  } catch (const std::exception &e) {
+    printInfo(ERR_WORKER(self->_workerID, e.what()), RED);
+    g_shutdown = true;
+    wakeUpEventLoops();
+  }
+  return NULL;
+}
+
+/**
+ * @brief Empties the wake-up pipe of a thread: the signal (or the reload)
+ * which wrote to it is handled by its loop.
+ */
+void Service::_clearWakeups() {
+  char buffer[64];
+
+  while (read(this->_wakeupPipe[0], buffer, sizeof(buffer)) > 0)
+    ;
+}
+
+/* ************************************************************************** */
+/*                              Worker processes                              */
+/* ************************************************************************** */
+
+/**
+ * @brief Master process: forks the worker processes, then restarts the ones
+ * which stop until a shutdown signal is received.
+ *
+ * A worker process which crashes only loses its own connections. It is
+ * restarted at once, or after RESPAWN_DELAY if it didn't even live that long
+ * (to avoid a fork loop on a worker which crashes at startup).
+ *
+ * On SIGHUP, the master reloads the configuration, then forks new workers
+ * with it and stops the previous ones gracefully (SIGQUIT): they finish their
+ * connections with the configuration they were accepted with. On SIGUSR2,
+ * it starts the new binary with the listening sockets.
+ *
+ * In a worker process, this function returns once its event loops stopped.
+ */
+void Service::_launchProcesses() {
+  size_t nbProcesses = this->_globalConfig.workerProcesses;
+
+  printInfo(PROCESSES_MSG(nbProcesses), BLUE);
+  this->_workerPidVector.assign(nbProcesses, -1);
+  this->_workerStartVector.assign(nbProcesses, 0);
+  // after a binary upgrade: each worker tells when its event loops are ready
+  if (this->_previousPid > 0 && pipe(this->_readyPipe) == 0) {
+    fcntl(this->_readyPipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(this->_readyPipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(this->_readyPipe[1], F_SETFD, FD_CLOEXEC);
+  }
+  for (size_t slot = 0; slot < nbProcesses; slot++) {
+    if (this->_spawnWorkerProcess(slot) == 0)
+      return;
+  }
+  if (this->_readyPipe[1] >= 0) {
+    close(this->_readyPipe[1]);
+    this->_readyPipe[1] = -1;
+  } else if (this->_previousPid > 0)
+    this->_notifyReady(); // no pipe: stopped at once, as before
+
+  while (g_shutdown == false && g_drain == false) {
+    if (this->_reloadCount != g_reload) {
+      this->_reloadCount = g_reload;
+      printInfo(RELOAD_MSG, GREEN);
+      if (this->_reload() && !this->_replaceWorkerProcesses())
+        return;
+    }
+    if (this->_upgradeCount != g_upgrade) {
+      this->_upgradeCount = g_upgrade;
+      this->_startUpgrade();
+    }
+
+    int status;
+    pid_t pid;
+
+    if (this->_readyPipe[0] >= 0) {
+      this->_waitWorkersReady();
+      pid = waitpid(-1, &status, WNOHANG);
+      if (pid == 0)
+        continue;
+    } else
+      pid = waitpid(-1, &status, 0);
+
+    if (pid < 0) {
+      if (errno == EINTR)
+        continue; // a signal: check g_shutdown (or g_reload)
+      break;      // no worker left (ECHILD)
+    }
+
+    std::vector<pid_t>::iterator it = std::find(
+        this->_workerPidVector.begin(), this->_workerPidVector.end(), pid);
+    if (pid == this->_upgradePid) {
+      printInfo(UPGRADE_FAIL_MSG(pid), RED);
+      this->_upgradePid = -1;
+      continue;
+    }
+    if (it == this->_workerPidVector.end()) {
+      // a worker replaced by a reload finished its connections
+      this->_retiredPidVector.erase(std::remove(this->_retiredPidVector.begin(),
+                                                this->_retiredPidVector.end(),
+                                                pid),
+                                    this->_retiredPidVector.end());
+      continue;
+    }
+    size_t slot = it - this->_workerPidVector.begin();
+    *it = -1;
+    if (g_shutdown || g_drain)
+      break;
+
+    std::string how = WIFSIGNALED(status)
+                          ? "killed by signal " + to_string(WTERMSIG(status))
+                          : "exited with status " +
+                                to_string(WEXITSTATUS(status));
+    printInfo(WORKER_EXIT_MSG(pid, how), RED);
+    if (time(NULL) - this->_workerStartVector[slot] < RESPAWN_DELAY)
+      sleep(RESPAWN_DELAY);
+    if (g_shutdown == false && g_drain == false &&
+        this->_spawnWorkerProcess(slot) == 0)
+      return;
+  }
+  if (g_shutdown || g_drain)
+    printInfo(g_shutdown ? SHUTDOWN_MSG : DRAIN_MSG, GREEN);
+  // graceful shutdown: only the workers accept on the listening sockets now
+  if (g_drain) {
+    for (size_t i = 0; i < this->_listenerVector.size(); i++)
+      close(this->_listenerVector[i].fd);
+    this->_listenerVector.clear();
+  }
+  this->_stopWorkerProcesses();
+}
+
+/**
+ * @brief Forks the worker process of a slot.
+ *
+ * The child becomes a worker: it creates its own readiness backend (or its
+ * worker threads), registers the inherited listening sockets and runs its
+ * event loop(s). On Linux, it gets SIGTERM if the master dies, so no worker
+ * keeps the listening sockets after a crash (or a SIGKILL) of the master.
+ * @param slot Index of the worker process.
+ * @return pid_t the pid of the new worker in the master, 0 in the worker
+ * (once its event loops stopped).
+ */
+pid_t Service::_spawnWorkerProcess(size_t slot) {
+  pid_t masterPid = getpid();
+  pid_t pid = fork();
+
+  if (pid < 0) {
+    int error = errno;
+
+    g_shutdown = true;
+    this->_stopWorkerProcesses();
+    throw std::runtime_error(ERR_FORK + std::string(std::strerror(error)));
+  }
+  if (pid == 0) {
+#ifdef __linux__
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+    if (getppid() != masterPid) // the master died before prctl()
+      g_shutdown = true;
+    this->_isWorker = true;
+    this->_workerID = slot;
+    this->_previousPid = -1; // stopped by the master
+    if (this->_readyPipe[0] >= 0) {
+      close(this->_readyPipe[0]);
+      this->_readyPipe[0] = -1;
+    }
+    this->_workerPidVector.clear();
+    this->_retiredPidVector.clear();
+    this->_setupEventLoops();
+    this->_launchEventLoops();
+    return 0;
+  }
+  this->_workerPidVector[slot] = pid;
+  this->_workerStartVector[slot] = time(NULL);
+  return pid;
+}
+
+/**
+ * @brief Forks a new worker process for each slot (with the reloaded
+ * configuration), then stops the previous ones gracefully.
+ * @return false in a new worker (once its event loops stopped).
+ */
+bool Service::_replaceWorkerProcesses() {
+  std::vector<pid_t> previousPidVector;
+
+  for (size_t slot = 0; slot < this->_workerPidVector.size(); slot++) {
+    if (this->_workerPidVector[slot] > 0)
+      previousPidVector.push_back(this->_workerPidVector[slot]);
+    if (this->_spawnWorkerProcess(slot) == 0)
+      return false;
+  }
+  for (size_t i = 0; i < previousPidVector.size(); i++) {
+    kill(previousPidVector[i], SIGQUIT);
+    this->_retiredPidVector.push_back(previousPidVector[i]);
+  }
+  return true;
+}
+
+/**
+ * @brief Forwards the shutdown signal (SIGTERM by default) to the worker
+ * processes and waits for them to stop.
+ *
+ * During a graceful shutdown, the workers can take up to 'shutdown_timeout':
+ * a new signal received meanwhile (a SIGINT, a second SIGTERM) is forwarded
+ * too, and stops them at once. The workers replaced by a reload are waited
+ * for too.
+ */
+void Service::_stopWorkerProcesses() {
+  int signum = (g_signal != 0) ? static_cast<int>(g_signal) : SIGTERM;
+  bool forced = g_shutdown;
+
+  for (size_t slot = 0; slot < this->_workerPidVector.size(); slot++) {
+    if (this->_workerPidVector[slot] > 0)
+      kill(this->_workerPidVector[slot], signum);
+  }
+  // the replaced workers are already finishing their connections
+  for (size_t i = 0; i < this->_retiredPidVector.size(); i++) {
+    if (forced)
+      kill(this->_retiredPidVector[i], signum);
+    this->_workerPidVector.push_back(this->_retiredPidVector[i]);
+  }
+  this->_retiredPidVector.clear();
+  for (size_t slot = 0; slot < this->_workerPidVector.size(); slot++) {
+    if (this->_workerPidVector[slot] <= 0)
+      continue;
+    while (waitpid(this->_workerPidVector[slot], NULL, 0) < 0 && errno == EINTR) {
+      if (forced || !g_shutdown)
+        continue;
+      forced = true;
+      printInfo(SHUTDOWN_MSG, GREEN);
+      for (size_t i = slot; i < this->_workerPidVector.size(); i++) {
+        if (this->_workerPidVector[i] > 0)
+          kill(this->_workerPidVector[i], g_signal);
+      }
+    }
+    this->_workerPidVector[slot] = -1;
+  }
+}
@@ -0,0 +1,168 @@
+/**
+ * @file Service_4_admission.cpp
+ * @brief Implementation of the connection limits of an event loop: the
+ * 'max_connections' (global and per server) and 'max_connections_per_ip'
+ * directives, and the pause of the listening sockets when accept() runs out of
+ * file descriptors.
+ *
+ * The limits are counted by each event loop (like the connections of an nginx
+ * worker): with N workers, up to N x 'max_connections' clients are served.
+ * A server's limit applies to its listening socket, so to all the servers
+ * sharing its 'listen_host:listen_port'.
+ *
+ * Over a limit, the 'overload_action' directive chooses between:
+ * - "stop": the listening sockets are no longer surveyed, the new connections
+ *   wait in the kernel's backlog until a client leaves;
+ * - "503": the new connections get a preformatted 503 response (with
+ *   Retry-After), then are closed.
+ * The 'max_connections_per_ip' limit is only known once the connection is
+ * accepted: over it, the connection is closed (or gets the 503 response).
+ */
+
+#include "Service.hpp"
+#include "utils.hpp"
+
+/**
+ * @brief Checks if a new connection to a listening socket would exceed the
+ * global or its server's 'max_connections'.
+ * @param serverID Index of the server of the listening socket.
+ */
+bool Service::_isOverloaded(int serverID) const {
+  size_t serverMax = this->_servers->at(serverID).getMaxConnections();
+
+  if (this->_globalConfig.maxConnections > 0 &&
+      this->_nbClients >= this->_globalConfig.maxConnections)
+    return true;
+  return (serverMax > 0 &&
+          static_cast<size_t>(serverID) < this->_nbClientsByServer.size() &&
+          this->_nbClientsByServer[serverID] >= serverMax);
+}
+
+/**
+ * @brief Checks the limits for a new connection (accepted on the current
+ * listening socket) and counts it if it is admitted.
+ * @param fd The socket of the new connection.
+ * @param address The IPv4 address of the client.
+ * @return false if the connection is over a limit (it is not counted).
+ */
+bool Service::_admitConnection(int fd, in_addr_t address) {
+  int serverID = this->_tmpServiceInfo.serverID;
+  size_t ipMax = this->_servers->at(serverID).getMaxConnectionsPerIp();
+
+  if (this->_isOverloaded(serverID))
+    return false;
+  if (ipMax > 0) {
+    std::map<in_addr_t, size_t>::const_iterator it =
+        this->_nbClientsByAddress.find(address);
+    if (it != this->_nbClientsByAddress.end() && it->second >= ipMax)
+      return false;
+  }
+
+  if (static_cast<size_t>(serverID) >= this->_nbClientsByServer.size())
+    this->_nbClientsByServer.resize(this->_servers->size(), 0);
+  this->_nbClientsByServer[serverID]++;
+  this->_nbClientsByAddress[address]++;
+  this->_clientServerByFd[fd] = serverID;
+  this->_clientAddressByFd[fd] = address;
+  return true;
+}
+
+/**
+ * @brief Closes a connection over a limit, after trying to send it the
+ * overload response with 'overload_action 503'.
+ *
+ * The response is sent with a single non-blocking send(): nothing is queued
+ * for a rejected connection. The data already received is read first, so the
+ * close() doesn't reset the connection before the client gets the response.
+ * @param fd The socket of the rejected connection.
+ */
+void Service::_rejectConnection(int fd) {
+  if (this->_globalConfig.overloadAction == OVERLOAD_503) {
+    static const char response[] = OVERLOAD_RESPONSE;
+    char buffer[BUFFER_SIZE];
+
+    send(fd, response, sizeof(response) - 1, MSG_DONTWAIT);
+    shutdown(fd, SHUT_WR);
+    while (recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT) > 0)
+      ;
+  }
+  close(fd);
+  printInfo(OVERLOAD_MSG, RED);
+}
+
+/**
+ * @brief Uncounts a closed client's connection, so the listening sockets
+ * can accept again.
+ *
+ * A client accepted before a configuration reload is no longer counted by
+ * server (the server indexes changed), only globally and by address.
+ * @param fd The socket of the closed connection.
+ */
+void Service::_releaseConnection(int fd) {
+  int serverID = this->_clientServerByFd[fd];
+  std::map<in_addr_t, size_t>::iterator it =
+      this->_nbClientsByAddress.find(this->_clientAddressByFd[fd]);
+
+  if (serverID >= 0)
+    this->_nbClientsByServer[serverID]--;
+  if (it != this->_nbClientsByAddress.end() && --it->second == 0)
+    this->_nbClientsByAddress.erase(it);
+  this->_clientServerByFd[fd] = -1;
+
+  // a file descriptor is free again
+  if (this->_acceptPauseFd >= 0)
+    this->_resumeAccept();
+  else
+    this->_updateListeners();
+}
+
+/**
+ * @brief Surveys (POLLIN) the listening sockets which can accept, and stops
+ * surveying the others: all of them during an accept pause, and the ones over
+ * a limit with 'overload_action stop'.
+ *
+ * The backend is only called when the events of a socket change.
+ */
+void Service::_updateListeners() {
+  bool stopWhenFull = (this->_globalConfig.overloadAction == OVERLOAD_STOP);
+
+  for (size_t i = 0; i < this->_listeningFdVector.size(); i++) {
+    int fd = this->_listeningFdVector[i];
+    short events = POLLIN;
+
+    if (this->_serverIndexByFd[fd] < 0)
+      continue; // closed
+    if (this->_acceptPauseFd >= 0 ||
+        (stopWhenFull && this->_isOverloaded(this->_serverIndexByFd[fd])))
+      events = 0;
+    if (events == this->_eventsByFd[fd])
+      continue;
+    this->_poller->modifyFd(fd, events);
+    this->_eventsByFd[fd] = events;
+  }
+}
+
+/**
+ * @brief Stops accepting for ACCEPT_RETRY_DELAY, or until a connection is
+ * closed, after accept() failed for lack of file descriptors or memory.
+ *
+ * A level-triggered listening socket stays ready while connections are
+ * pending: without the pause, the loop would spin on the failing accept().
+ * The timer of the pause is armed on the current listening socket.
+ */
+void Service::_pauseAccept() {
+  printInfo(ACCEPT_PAUSE_MSG(std::strerror(errno)), RED);
+  this->_acceptPauseFd = this->_tmpServiceInfo.listeningSocketFd;
+  this->_timerWheel.schedule(this->_acceptPauseFd,
+                             this->_now + ACCEPT_RETRY_DELAY);
+  this->_updateListeners();
+}
+
+/**
+ * @brief Ends the accept pause: the listening sockets are surveyed again.
+ */
+void Service::_resumeAccept() {
+  this->_timerWheel.cancel(this->_acceptPauseFd);
+  this->_acceptPauseFd = -1;
+  this->_updateListeners();
+}
@@ -0,0 +1,101 @@
+/**
+ * @file Service_5_shutdown.cpp
+ * @brief Implementation of the graceful shutdown of an event loop (SIGTERM,
+ * SIGQUIT).
+ *
+ * The event loop closes its listening sockets, so the new connections go to
+ * the other servers (or are refused), then finishes the requests in progress:
+ * - the idle keep-alive connections are closed at once;
+ * - the others get their response with `Connection: close`, their output
+ *   queue is flushed, then they are closed.
+ * The loop stops once it has no connection left, or when the
+ * 'shutdown_timeout' is over (the remaining connections are cut).
+ */
+
+#include "Service.hpp"
+#include "utils.hpp"
+
+/**
+ * @brief Starts the graceful shutdown of the event loop.
+ */
+void Service::_startDrain() {
+  if (this->_reportsSignals())
+    printInfo(DRAIN_MSG, GREEN);
+  this->_drainDeadline =
+      this->_now + static_cast<long>(this->_globalConfig.shutdownTimeout) * 1000;
+  if (this->_drainDeadline == 0)
+    this->_drainDeadline = 1; // 0 means "not shutting down"
+  this->_closeListeners();
+
+  for (size_t fd = 0; fd < this->_clientTable.size(); fd++) {
+    Client *client = this->_clientTable[fd];
+
+    if (client == NULL)
+      continue;
+    client->closeAfterResponse();
+    if (!client->isIdle())
+      continue;
+    this->_resetTmpServiceInfo();
+    this->_tmpServiceInfo.clientID = fd;
+    this->_tmpServiceInfo.listeningSocketFd = fd;
+    this->_closeConnection(EMPTY_MSG);
+  }
+  this->_resetTmpServiceInfo();
+  printInfo(DRAIN_START_MSG(this->_workerID, this->_nbClients), GREEN);
+}
+
+/**
+ * @brief Checks if the graceful shutdown is over: no connection left, or the
+ * 'shutdown_timeout' is over.
+ */
+bool Service::_isDrained() {
+  if (this->_nbClients == 0)
+    return true;
+  if (this->_now < this->_drainDeadline)
+    return false;
+  printInfo(DRAIN_TIMEOUT_MSG(this->_workerID, this->_nbClients), RED);
+  return true;
+}
+
+/**
+ * @brief Stops surveying the listening sockets of the event loop and closes
+ * them.
+ *
+ * The connections already waiting are accepted first (a batch per socket):
+ * the io_uring backend accepts them ahead, they would be reset otherwise.
+ * The other pending connections of their backlog are refused by the kernel
+ * once every process has closed the socket.
+ */
+void Service::_closeListeners() {
+  for (size_t i = 0; i < this->_listeningFdVector.size(); i++) {
+    int fd = this->_listeningFdVector[i];
+
+    if (this->_serverIndexByFd[fd] < 0 || this->_poller == NULL)
+      continue;
+    this->_resetTmpServiceInfo();
+    this->_tmpServiceInfo.listeningSocketFd = fd;
+    this->_tmpServiceInfo.serverID = this->_getServerIndex();
+    this->_tmpServiceInfo.launch = true;
+    for (int nbAccepted = 0;
+         nbAccepted < ACCEPT_BATCH && this->_acceptPauseFd < 0; nbAccepted++)
+      if (!this->_acceptOneConnection())
+        break;
+  }
+  this->_resetTmpServiceInfo();
+
+  if (this->_acceptPauseFd >= 0)
+    this->_timerWheel.cancel(this->_acceptPauseFd);
+  this->_acceptPauseFd = -1;
+
+  for (size_t i = 0; i < this->_listeningFdVector.size(); i++) {
+    int fd = this->_listeningFdVector[i];
+
+    if (this->_serverIndexByFd[fd] < 0)
+      continue; // already closed
+    if (this->_poller)
+      this->_poller->removeFd(fd);
+    close(fd);
+    this->_serverIndexByFd[fd] = -1;
+  }
+  this->_listeningFdVector.clear();
+}
@@ -0,0 +1,479 @@
+/**
+ * @file Service_6_reload.cpp
+ * @brief Implementation of the configuration reload (SIGHUP).
+ *
+ * The configuration file is parsed and checked once: by a short-lived thread
+ * for a single event loop (so the loop goes on serving meanwhile), by the
+ * main thread with 'worker_threads', or by the master process with
+ * 'worker_processes'. The new configuration replaces the current one only if
+ * it passes every check and its new listening sockets could all be bound:
+ * otherwise the error is printed and nothing changes.
+ *
+ * The listening sockets whose 'listen_host:listen_port' is still used are
+ * kept open, with their pending connections (and their socket options), the
+ * new ones are bound and the ones no longer used are closed.
+ *
+ * The reloaded servers, global directives and listening sockets form one
+ * generation, published to the worker threads: each event loop adopts it by
+ * swapping its pointers and reconciling its own listening sockets, so they
+ * all run the same configuration. The connections already accepted keep the
+ * generation they were accepted with, until their last one is closed; the new
+ * connections use the reloaded one. With 'worker_processes', the master forks
+ * new workers instead, and the previous ones finish their connections
+ * gracefully (see Service::_launchProcesses()).
+ *
+ * 'event_backend', 'worker_threads' and 'worker_processes' can't change
+ * without a restart.
+ */
+
+#include "Service.hpp"
+#include "utils.hpp"
+
+/**
+ * @brief Master process: parses the configuration file again and, if it is
+ * valid, replaces the servers, the global directives and the listening
+ * sockets. The new workers are forked with them.
+ * @return false if the configuration was not reloaded.
+ */
+bool Service::_reload() {
+  configGeneration_t *generation = this->_parseGeneration();
+
+  if (generation == NULL || !this->_reloadListeners(*generation)) {
+    delete generation;
+    return false;
+  }
+
+  size_t nbKept = 0;
+  size_t nbClosed = this->_closeUnusedListeners(generation->listenerVector);
+
+  for (size_t i = 0; i < generation->listenerVector.size(); i++) {
+    for (size_t j = 0; j < this->_listenerVector.size(); j++) {
+      if (this->_listenerVector[j].fd == generation->listenerVector[i].fd)
+        nbKept++;
+    }
+  }
+  this->_serversVector.swap(generation->servers);
+  this->_globalConfig = generation->globalConfig;
+  this->_listenerVector = generation->listenerVector;
+  printInfo(RELOAD_DONE_MSG(this->_workerID, nbKept,
+                            this->_listenerVector.size() - nbKept, nbClosed),
+            GREEN);
+  delete generation;
+  return true;
+}
+
+/**
+ * @brief Parses the configuration file again.
+ * @return configGeneration_t* the reloaded servers and global directives
+ * (without listening sockets yet), or NULL if the configuration is invalid.
+ */
+configGeneration_t *Service::_parseGeneration() const {
+  configGeneration_t *generation = new configGeneration_t();
+
+  try {
+    Parser input(this->_argc, this->_argv);
+
+    generation->servers = input.getServersVector();
+    generation->globalConfig = input.getGlobalConfig();
+  } catch (const std::exception &e) {
+    printInfo(ERR_RELOAD(e.what()), RED);
+    delete generation;
+    return NULL;
+  }
+  this->_keepGlobalConfig(generation->globalConfig);
+  return generation;
+}
+
+/**
+ * @brief Keeps the global directives which can't change without a restart
+ * (the backend, the workers and the receive buffers are already created).
+ * @param config The reloaded global configuration.
+ */
+void Service::_keepGlobalConfig(globalConfig_t &config) const {
+  if (config.eventBackend != this->_globalConfig.eventBackend)
+    printInfo(RELOAD_KEPT_MSG(EVENT_BACKEND), RED);
+  if (config.workerThreads != this->_globalConfig.workerThreads)
+    printInfo(RELOAD_KEPT_MSG(WORKER_T), RED);
+  if (config.workerProcesses != this->_globalConfig.workerProcesses)
+    printInfo(RELOAD_KEPT_MSG(WORKER_P), RED);
+  if (config.headerBufferSize != this->_globalConfig.headerBufferSize)
+    printInfo(RELOAD_KEPT_MSG(HEADER_BUF), RED);
+  config.eventBackend = this->_globalConfig.eventBackend;
+  config.workerThreads = this->_globalConfig.workerThreads;
+  config.workerProcesses = this->_globalConfig.workerProcesses;
+  config.headerBufferSize = this->_globalConfig.headerBufferSize;
+}
+
+/* ************************************************************************** */
+/*                              Single event loop                             */
+/* ************************************************************************** */
+
+/**
+ * @brief Single event loop: starts parsing the configuration on SIGHUP, and
+ * adopts it once parsed.
+ *
+ * The listening sockets are bound here, by the loop (the setup helpers use
+ * its `_tmpServiceInfo`). In a worker process, the master reloads instead.
+ */
+void Service::_checkReload() {
+  configGeneration_t *generation;
+
+  if (this->_isParsing) {
+    if (__atomic_load_n(&this->_isParsed, __ATOMIC_ACQUIRE) == 0)
+      return;
+    pthread_join(this->_parseThread, NULL);
+    this->_isParsing = false;
+    generation = this->_parsedGeneration;
+    this->_parsedGeneration = NULL;
+  } else if (this->_reloadCount != g_reload) {
+    this->_reloadCount = g_reload;
+    if (this->_globalConfig.workerProcesses > 0 || this->_drainDeadline != 0)
+      return;
+    printInfo(RELOAD_MSG, GREEN);
+    if (this->_startParsing())
+      return;
+    generation = this->_parseGeneration(); // no thread: parsed at once
+  } else
+    return;
+
+  if (generation && this->_drainDeadline == 0 &&
+      this->_reloadListeners(*generation)) {
+    this->_listenerVector = generation->listenerVector;
+    generation->nbReferences = 1;
+    this->_adoptGeneration(generation);
+  } else
+    delete generation;
+}
+
+/**
+ * @brief Starts the thread parsing the configuration. It doesn't get the
+ * signals, which must interrupt the event loop's wait.
+ * @return false if the thread couldn't be created.
+ */
+bool Service::_startParsing() {
+  sigset_t signals;
+  sigset_t previousSignals;
+
+  sigfillset(&signals);
+  pthread_sigmask(SIG_BLOCK, &signals, &previousSignals);
+  this->_isParsed = 0;
+  this->_isParsing = (pthread_create(&this->_parseThread, NULL,
+                                     &Service::_parseRoutine, this) == 0);
+  pthread_sigmask(SIG_SETMASK, &previousSignals, NULL);
+  return this->_isParsing;
+}
+
+/**
+ * @brief Entry point of the parsing thread.
+ *
+ * It only reads the configuration file and the Service's global directives,
+ * which the event loop doesn't change while the thread runs.
+ * @param service The single event loop's Service.
+ */
+void *Service::_parseRoutine(void *service) {
+  Service *self = static_cast<Service *>(service);
+
+  self->_parsedGeneration = self->_parseGeneration();
+  __atomic_store_n(&self->_isParsed, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+/**
+ * @brief Waits for the parsing thread when the event loop stops (its result
+ * is dropped).
+ */
+void Service::_stopParsing() {
+  if (!this->_isParsing)
+    return;
+  pthread_join(this->_parseThread, NULL);
+  delete this->_parsedGeneration;
+  this->_parsedGeneration = NULL;
+  this->_isParsing = false;
+}
+
+/* ************************************************************************** */
+/*                               Worker threads                               */
+/* ************************************************************************** */
+
+/**
+ * @brief Main thread: publishes a reloaded configuration to the workers and
+ * wakes them up. It keeps a reference until the next one is published.
+ * @param generation The configuration, with the listening sockets of every
+ * worker.
+ */
+void Service::_publishGeneration(configGeneration_t *generation) {
+  configGeneration_t *previous;
+
+  generation->nbReferences = 1;
+  pthread_mutex_lock(&this->_publishMutex);
+  previous = this->_publishedGeneration;
+  this->_publishedGeneration = generation;
+  __atomic_add_fetch(&this->_publishedCount, 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&this->_publishMutex);
+  if (previous)
+    _dropGeneration(previous);
+  this->_globalConfig = generation->globalConfig;
+  this->_listenerVector = generation->listenerVector;
+  wakeUpEventLoops();
+}
+
+/**
+ * @brief Main thread: checks if every worker adopted the last configuration
+ * published. Until then, the next reload waits: the listening sockets it
+ * would close could still be surveyed.
+ */
+bool Service::_isAdopted() const {
+  return (this->_publishedGeneration == NULL ||
+          __atomic_load_n(&this->_publishedGeneration->nbAdopted,
+                          __ATOMIC_ACQUIRE) ==
+              static_cast<int>(this->_workerVector.size()));
+}
+
+/**
+ * @brief Worker thread: adopts the last configuration published by the main
+ * thread, if it didn't yet. During a graceful shutdown, its new listening
+ * sockets are closed at once.
+ */
+void Service::_checkPublished() {
+  if (__atomic_load_n(&this->_master->_publishedCount, __ATOMIC_ACQUIRE) ==
+      this->_adoptedCount)
+    return;
+
+  configGeneration_t *generation;
+
+  pthread_mutex_lock(&this->_master->_publishMutex);
+  generation = this->_master->_publishedGeneration;
+  this->_adoptedCount = this->_master->_publishedCount;
+  __atomic_add_fetch(&generation->nbReferences, 1, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&this->_master->_publishMutex);
+  this->_adoptGeneration(generation);
+  if (this->_drainDeadline != 0)
+    this->_closeListeners();
+}
+
+/**
+ * @brief Adopts a reloaded configuration: surveys its listening sockets which
+ * belong to this event loop (the kept ones get their new server index), stops
+ * surveying and closes the ones no longer used, then swaps the servers and the
+ * global directives.
+ * @param generation The configuration, with a reference taken for the loop.
+ */
+void Service::_adoptGeneration(configGeneration_t *generation) {
+  std::vector<listener_t> const &listenerVector = generation->listenerVector;
+  std::vector<int> previousFdVector;
+  size_t nbKept = 0;
+  size_t nbOpened = 0;
+  size_t nbClosed = 0;
+
+  if (this->_acceptPauseFd >= 0)
+    this->_timerWheel.cancel(this->_acceptPauseFd);
+  this->_acceptPauseFd = -1;
+  previousFdVector.swap(this->_listeningFdVector);
+  for (size_t i = 0; i < listenerVector.size(); i++) {
+    int fd = listenerVector[i].fd;
+
+    if (listenerVector[i].workerID != this->_workerID)
+      continue;
+    if (std::find(previousFdVector.begin(), previousFdVector.end(), fd) !=
+            previousFdVector.end() &&
+        this->_serverIndexByFd[fd] >= 0) {
+      this->_serverIndexByFd[fd] = listenerVector[i].serverID;
+      this->_listeningFdVector.push_back(fd);
+      nbKept++;
+      continue;
+    }
+    this->_resetTmpServiceInfo();
+    this->_tmpServiceInfo.listeningSocketFd = fd;
+    this->_tmpServiceInfo.serverID = listenerVector[i].serverID;
+    this->_addSocketToPollSockVec();
+    nbOpened++;
+  }
+  this->_resetTmpServiceInfo();
+
+  // the listening sockets no longer used
+  for (size_t i = 0; i < previousFdVector.size(); i++) {
+    int fd = previousFdVector[i];
+
+    if (this->_serverIndexByFd[fd] < 0 ||
+        std::find(this->_listeningFdVector.begin(),
+                  this->_listeningFdVector.end(),
+                  fd) != this->_listeningFdVector.end())
+      continue;
+    this->_poller->removeFd(fd);
+    this->_serverIndexByFd[fd] = -1;
+    close(fd);
+    nbClosed++;
+  }
+
+  const std::vector<Server> *previous = this->_servers;
+
+  this->_generationVector.push_back(generation);
+  this->_servers = &generation->servers;
+  this->_globalConfig = generation->globalConfig;
+  this->_freeGeneration(previous);
+
+  // the server indexes changed: the clients already accepted are only counted
+  // globally and by address from now on
+  this->_nbClientsByServer.assign(this->_servers->size(), 0);
+  this->_clientServerByFd.assign(this->_clientServerByFd.size(), -1);
+  this->_updateListeners();
+  __atomic_add_fetch(&generation->nbAdopted, 1, __ATOMIC_RELEASE);
+  printInfo(RELOAD_DONE_MSG(this->_workerID, nbKept, nbOpened, nbClosed),
+            GREEN);
+}
+
+/**
+ * @brief Releases a reference to a reloaded configuration, and deletes it
+ * with the last one.
+ */
+void Service::_dropGeneration(configGeneration_t *generation) {
+  if (__atomic_sub_fetch(&generation->nbReferences, 1, __ATOMIC_ACQ_REL) == 0)
+    delete generation;
+}
+
+/* ************************************************************************** */
+/*                              Listening sockets                             */
+/* ************************************************************************** */
+
+/**
+ * @brief Gives a listening socket to each primary server of the reloaded
+ * configuration, for each event loop: the current one of its
+ * 'listen_host:listen_port' if there is one, a new one otherwise.
+ *
+ * Nothing is closed here: each event loop closes its own sockets no longer
+ * used when it adopts the configuration.
+ * @param generation The reloaded configuration, which gets the sockets.
+ * @return false if a new listening socket couldn't be created (the new ones
+ * are closed, the current ones are unchanged).
+ */
+bool Service::_reloadListeners(configGeneration_t &generation) {
+  std::vector<Server> const &servers = generation.servers;
+  std::vector<listener_t> &listenerVector = generation.listenerVector;
+  std::vector<bool> openedVector;
+  std::vector<bool> keptVector(this->_listenerVector.size(), false);
+  size_t nbWorkers = std::max(static_cast<size_t>(1),
+                              this->_workerVector.size());
+
+  if (this->_globalConfig.workerProcesses > 0)
+    nbWorkers = std::max(static_cast<size_t>(1),
+                         this->_globalConfig.workerThreads);
+  try {
+    for (size_t serverID = 0; serverID < servers.size(); serverID++) {
+      Server const &server = servers[serverID];
+
+      if (!server.getIsPrimary())
+        continue;
+      for (size_t workerID = 0; workerID < nbWorkers; workerID++) {
+        int i = this->_findListener(server.getHost(), server.getPort(),
+                                    workerID, keptVector);
+
+        if (i >= 0) {
+          keptVector[i] = true;
+          listenerVector.push_back(this->_listenerVector[i]);
+          listenerVector.back().serverID = serverID;
+          openedVector.push_back(false);
+          continue;
+        }
+        listenerVector.push_back(
+            this->_createListener(server, serverID, workerID));
+        openedVector.push_back(true);
+      }
+    }
+  } catch (const std::exception &e) {
+    for (size_t i = 0; i < listenerVector.size(); i++) {
+      if (openedVector[i])
+        close(listenerVector[i].fd);
+    }
+    listenerVector.clear();
+    printInfo(ERR_RELOAD(e.what()), RED);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Master process: closes its listening sockets which the reloaded
+ * configuration doesn't use (the previous workers keep their copies until
+ * they stop).
+ * @param listenerVector The listening sockets of the reloaded configuration.
+ * @return size_t the number of sockets closed.
+ */
+size_t Service::_closeUnusedListeners(
+    std::vector<listener_t> const &listenerVector) {
+  size_t nbClosed = 0;
+
+  for (size_t i = 0; i < this->_listenerVector.size(); i++) {
+    bool isUsed = false;
+
+    for (size_t j = 0; j < listenerVector.size() && !isUsed; j++)
+      isUsed = (listenerVector[j].fd == this->_listenerVector[i].fd);
+    if (isUsed)
+      continue;
+    close(this->_listenerVector[i].fd);
+    nbClosed++;
+  }
+  return nbClosed;
+}
+
+/**
+ * @brief Finds a current listening socket bound to an address.
+ *
+ * The address is compared as written in the configuration: 'localhost' and
+ * '127.0.0.1' are different (and the new socket can't be bound).
+ * @param keptVector The listening sockets already given to a server.
+ * @return int the index of the socket in `_listenerVector`, or -1.
+ */
+int Service::_findListener(std::string const &host, std::string const &port,
+                           size_t workerID,
+                           std::vector<bool> const &keptVector) const {
+  for (size_t i = 0; i < this->_listenerVector.size(); i++) {
+    listener_t const &listener = this->_listenerVector[i];
+
+    if (!keptVector[i] && listener.workerID == workerID &&
+        listener.host == host && listener.port == port)
+      return static_cast<int>(i);
+  }
+  return -1;
+}
+
+/* ************************************************************************** */
+/*                                Generations                                 */
+/* ************************************************************************** */
+
+/**
+ * @brief Uncounts a closed client from the servers vector it was accepted
+ * with, which is released with its last client if it was replaced by a reload.
+ * @param fd The socket of the closed connection.
+ */
+void Service::_releaseGeneration(int fd) {
+  const std::vector<Server> *servers = this->_generationByFd[fd];
+
+  this->_generationByFd[fd] = NULL;
+  if (servers == NULL)
+    return;
+  if (--this->_nbClientsByGeneration[servers] == 0)
+    this->_nbClientsByGeneration.erase(servers);
+  this->_freeGeneration(servers);
+}
+
+/**
+ * @brief Releases a reloaded configuration once it is replaced and no client
+ * of this event loop uses it anymore.
+ *
+ * The servers vector of the startup configuration is not in the list: it is
+ * kept.
+ */
+void Service::_freeGeneration(const std::vector<Server> *servers) {
+  if (servers == this->_servers ||
+      this->_nbClientsByGeneration.find(servers) !=
+          this->_nbClientsByGeneration.end())
+    return;
+
+  for (size_t i = 0; i < this->_generationVector.size(); i++) {
+    if (&this->_generationVector[i]->servers == servers) {
+      _dropGeneration(this->_generationVector[i]);
+      this->_generationVector.erase(this->_generationVector.begin() + i);
+      return;
+    }
+  }
+}
@@ -0,0 +1,300 @@
+/**
+ * @file Service_7_upgrade.cpp
+ * @brief Implementation of the binary upgrade (SIGUSR2), like nginx's.
+ *
+ * The running process forks and executes its binary again (the path it was
+ * started with, so the new build installed there), with the same arguments.
+ * Every listening socket of the process is inherited by the new process and
+ * listed in the UPGRADE_ENV environment variable ("fd;fd;..."). The new
+ * process adopts the ones bound to the address of a server in setup(),
+ * instead of binding new ones: the connections pending in their backlog are
+ * not lost, and no connection is refused meanwhile.
+ *
+ * Once its event loops run (each one returned from its first wait; with
+ * worker processes, once every worker reported it to the master), the new
+ * process sends SIGQUIT to the previous one, which closes its listening
+ * sockets and finishes its connections gracefully. If the new binary stops
+ * before (invalid configuration, crash...), the previous process keeps
+ * running with its sockets.
+ *
+ * With worker threads, the first event loop starts the new binary (with the
+ * listening sockets of every worker); with worker processes, the master does.
+ */
+
+#include "Service.hpp"
+#include "utils.hpp"
+
+extern char **environ;
+
+/**
+ * @brief Starts the new binary with the listening sockets of the process.
+ *
+ * The listening sockets are found among the open file descriptors, so the
+ * ones of the other worker threads are passed too: a socket of a SO_REUSEPORT
+ * group loses its pending connections when its last copy is closed.
+ *
+ * Everything the child needs is prepared before fork(): with worker threads,
+ * the child must not allocate memory before execve(). The child closes every
+ * other file descriptor and unblocks the signals blocked in the worker
+ * threads.
+ */
+void Service::_startUpgrade() {
+  printInfo(UPGRADE_MSG, GREEN);
+  if (this->_upgradePid > 0)
+    return; // the previous new binary is not ready yet
+
+  // the open file descriptors
+  std::vector<int> openFdVector;
+  DIR *fdDir = opendir("/proc/self/fd");
+  if (fdDir) {
+    struct dirent *entry;
+
+    while ((entry = readdir(fdDir)) != NULL) {
+      if (std::isdigit(entry->d_name[0]))
+        openFdVector.push_back(std::atoi(entry->d_name));
+    }
+    closedir(fdDir);
+  } else {
+    long maxFd = std::min(sysconf(_SC_OPEN_MAX), 65536L);
+
+    for (int fd = 0; fd < maxFd; fd++) {
+      if (fcntl(fd, F_GETFD) >= 0)
+        openFdVector.push_back(fd);
+    }
+  }
+
+  // the listening sockets among them
+  std::string listeners;
+  std::vector<int> keptFdVector;
+  for (size_t i = 0; i < openFdVector.size(); i++) {
+    int fd = openFdVector[i];
+    int listening = 0;
+    socklen_t length = sizeof(listening);
+
+    if (fd < 3 ||
+        getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &length) < 0 ||
+        !listening)
+      continue;
+    listeners += (listeners.empty() ? "" : ";") + to_string(fd);
+    keptFdVector.push_back(fd);
+  }
+
+  std::vector<std::string> environmentVars;
+  std::string const prefix = std::string(UPGRADE_ENV) + "=";
+
+  for (char **var = environ; var && *var; var++) {
+    if (!startsWith(*var, prefix))
+      environmentVars.push_back(*var);
+  }
+  environmentVars.push_back(prefix + listeners);
+  std::vector<char *> envVars(environmentVars.size() + 1, NULL);
+  for (size_t i = 0; i < environmentVars.size(); i++)
+    envVars[i] = const_cast<char *>(environmentVars[i].c_str());
+
+  sigset_t noSignals;
+  sigemptyset(&noSignals);
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    printInfo(ERR_FORK + std::string(std::strerror(errno)), RED);
+    return;
+  }
+  if (pid == 0) {
+    for (size_t i = 0; i < openFdVector.size(); i++) {
+      int fd = openFdVector[i];
+
+      if (fd >= 3 && std::find(keptFdVector.begin(), keptFdVector.end(),
+                               fd) == keptFdVector.end())
+        close(fd);
+    }
+    sigprocmask(SIG_SETMASK, &noSignals, NULL);
+    execve(this->_argv[0], this->_argv, &envVars[0]);
+    perror(ERR_EXEC);
+    _exit(EXIT_FAILURE);
+  }
+  this->_upgradePid = pid;
+  printInfo(UPGRADE_START_MSG(pid, keptFdVector.size()), GREEN);
+}
+
+/**
+ * @brief Checks if the new binary stopped before being ready (the previous
+ * process then keeps running).
+ *
+ * Once ready, it stops this process: its pid is kept until then.
+ */
+void Service::_checkUpgrade() {
+  if (waitpid(this->_upgradePid, NULL, WNOHANG) != this->_upgradePid)
+    return;
+  printInfo(UPGRADE_FAIL_MSG(this->_upgradePid), RED);
+  this->_upgradePid = -1;
+}
+
+/**
+ * @brief Reads the listening sockets passed by the previous binary, if this
+ * process was started by a binary upgrade, with the address each one is
+ * bound to.
+ *
+ * The variable is removed from the environment (a later upgrade sets its
+ * own). An entry which is not a listening socket is ignored.
+ */
+void Service::_getInheritedListeners() {
+  const char *value = std::getenv(UPGRADE_ENV);
+
+  if (value == NULL)
+    return;
+  std::istringstream iss(value);
+  std::string item;
+
+  unsetenv(UPGRADE_ENV);
+  while (std::getline(iss, item, ';')) {
+    listener_t listener;
+    sockaddr_in address;
+    socklen_t addressLength = sizeof(address);
+    int listening = 0;
+    socklen_t length = sizeof(listening);
+    char host[INET_ADDRSTRLEN];
+
+    listener.fd = std::atoi(item.c_str());
+    if (listener.fd < 3 ||
+        getsockopt(listener.fd, SOL_SOCKET, SO_ACCEPTCONN, &listening,
+                   &length) < 0 ||
+        !listening ||
+        getsockname(listener.fd, reinterpret_cast<sockaddr *>(&address),
+                    &addressLength) < 0 ||
+        address.sin_family != AF_INET)
+      continue;
+    inet_ntop(AF_INET, &address.sin_addr, host, sizeof(host));
+    listener.serverID = -1;
+    listener.workerID = 0;
+    listener.host = host;
+    listener.port = to_string(ntohs(address.sin_port));
+    this->_inheritedListenerVector.push_back(listener);
+  }
+}
+
+/**
+ * @brief Takes a listening socket passed by the previous binary bound to the
+ * address of a server, if there is one left.
+ *
+ * The address is resolved first, so 'localhost' matches a socket bound to
+ * 127.0.0.1.
+ * @return int the socket, or -1 if a new one must be created.
+ */
+int Service::_adoptListener(std::string const &host, std::string const &port) {
+  if (this->_inheritedListenerVector.empty())
+    return -1;
+
+  addrinfo parameters;
+  addrinfo *address = NULL;
+  char resolvedHost[INET_ADDRSTRLEN];
+
+  std::memset(&parameters, 0, sizeof(parameters));
+  parameters.ai_family = AF_INET;
+  parameters.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host.c_str(), port.c_str(), &parameters, &address) != 0)
+    return -1;
+  sockaddr_in const *resolved =
+      reinterpret_cast<sockaddr_in const *>(address->ai_addr);
+  inet_ntop(AF_INET, &resolved->sin_addr, resolvedHost, sizeof(resolvedHost));
+  std::string resolvedPort = to_string(ntohs(resolved->sin_port));
+  freeaddrinfo(address);
+
+  for (size_t i = 0; i < this->_inheritedListenerVector.size(); i++) {
+    listener_t &listener = this->_inheritedListenerVector[i];
+    int fd = listener.fd;
+
+    if (fd < 0 || listener.host != resolvedHost || listener.port != resolvedPort)
+      continue;
+    listener.fd = -1; // adopted
+    return fd;
+  }
+  return -1;
+}
+
+/**
+ * @brief Ends the setup of a process started by a binary upgrade: closes the
+ * inherited listening sockets no longer in the configuration. The previous
+ * process is stopped once the event loops are ready (see _reportReady()).
+ */
+void Service::_finishInheritance() {
+  if (this->_inheritedListenerVector.empty())
+    return;
+
+  size_t nbAdopted = 0;
+
+  for (size_t i = 0; i < this->_inheritedListenerVector.size(); i++) {
+    if (this->_inheritedListenerVector[i].fd < 0)
+      nbAdopted++;
+    else
+      close(this->_inheritedListenerVector[i].fd);
+  }
+  this->_inheritedListenerVector.clear();
+  printInfo(UPGRADE_INHERIT_MSG(nbAdopted), GREEN);
+  if (getppid() > 1)
+    this->_previousPid = getppid();
+}
+
+/**
+ * @brief Called by an event loop once its first wait returned: it surveys its
+ * listening sockets and serves. The last worker thread ready (or the single
+ * event loop) tells it to the Service which stops the previous binary.
+ */
+void Service::_reportReady() {
+  Service *master = this->_master;
+
+  if (master != this &&
+      __atomic_add_fetch(&master->_nbReady, 1, __ATOMIC_ACQ_REL) !=
+          static_cast<int>(master->_workerVector.size()))
+    return;
+  master->_notifyReady();
+}
+
+/**
+ * @brief The event loops of the process are ready: a worker process tells it
+ * to its master, otherwise the previous binary is told to stop gracefully.
+ */
+void Service::_notifyReady() {
+  if (this->_readyPipe[1] >= 0) {
+    ssize_t written = write(this->_readyPipe[1], "", 1);
+
+    (void)written;
+    close(this->_readyPipe[1]);
+    this->_readyPipe[1] = -1;
+    return;
+  }
+  if (this->_previousPid <= 0)
+    return;
+  printInfo(UPGRADE_READY_MSG(this->_previousPid), GREEN);
+  kill(this->_previousPid, SIGQUIT);
+  this->_previousPid = -1;
+}
+
+/**
+ * @brief Master process started by a binary upgrade: counts the worker
+ * processes ready (for up to POLL_TIME_OUT), and stops the previous binary
+ * once they all are.
+ *
+ * If the pipe is closed first, a worker stopped before being ready: the
+ * previous binary keeps running.
+ */
+void Service::_waitWorkersReady() {
+  pollfd ready;
+  char buffer[64];
+  ssize_t nbRead;
+
+  ready.fd = this->_readyPipe[0];
+  ready.events = POLLIN;
+  if (poll(&ready, 1, POLL_TIME_OUT) <= 0)
+    return;
+  while ((nbRead = read(this->_readyPipe[0], buffer, sizeof(buffer))) > 0)
+    this->_nbReady += nbRead;
+  if (this->_nbReady >= static_cast<int>(this->_workerPidVector.size()))
+    this->_notifyReady();
+  else if (nbRead == 0)
+    printInfo(UPGRADE_NOT_READY_MSG(this->_previousPid), RED);
+  else
+    return;
+  close(this->_readyPipe[0]);
+  this->_readyPipe[0] = -1;
+  this->_previousPid = -1;
+}
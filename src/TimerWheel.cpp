@@ -0,0 +1,186 @@
+/**
+ * @file TimerWheel.cpp
+ * @brief Implementation of the hierarchical timer wheel used for the
+ * connection timeouts.
+ */
+
+#include "TimerWheel.hpp"
+
+/**
+ * @param now Current time (ms, monotonic clock): the wheel starts at this tick.
+ */
+TimerWheel::TimerWheel(long now)
+    : _slotHead(2 * TIMER_SLOTS, -1), _currentTick(now / TIMER_TICK),
+      _nbTimers(0) {}
+
+TimerWheel::~TimerWheel() {}
+
+/**
+ * @brief Arms (or moves) the timer of a socket.
+ *
+ * Nothing is done if the timer is already armed with the same deadline, so it
+ * can be called after each event of the connection.
+ * @param fd The socket.
+ * @param deadline Expiry time (ms, monotonic clock).
+ */
+void TimerWheel::schedule(int fd, long deadline) {
+  if (static_cast<size_t>(fd) >= this->_timerVector.size()) {
+    wheelTimer_t unarmed = {0, -1, -1, -1};
+    this->_timerVector.resize(fd + 1, unarmed);
+  }
+  wheelTimer_t &timer = this->_timerVector[fd];
+
+  if (timer.slot >= 0) {
+    if (timer.deadline == deadline)
+      return;
+    this->_unlink(fd); // moved: still counted
+  } else
+    this->_nbTimers++;
+  timer.deadline = deadline;
+  this->_insert(fd, this->_currentTick + 1);
+}
+
+/**
+ * @brief Disarms the timer of a socket (call it before closing the socket).
+ */
+void TimerWheel::cancel(int fd) {
+  if (fd < 0 || static_cast<size_t>(fd) >= this->_timerVector.size() ||
+      this->_timerVector[fd].slot < 0)
+    return;
+  this->_unlink(fd);
+  this->_nbTimers--;
+}
+
+/**
+ * @brief Getter for the number of armed timers.
+ */
+size_t TimerWheel::getNbTimers() const { return (this->_nbTimers); }
+
+/**
+ * @brief Moves the wheel up to `now` and hands back the sockets whose
+ * deadline is over (their timers are disarmed).
+ *
+ * A timer is put in the slot of the first tick after its deadline, so it never
+ * expires early.
+ * @param now Current time (ms, monotonic clock).
+ * @param expiredVector Filled with the fds of the expired timers.
+ */
+void TimerWheel::advance(long now, std::vector<int> &expiredVector) {
+  long targetTick = now / TIMER_TICK;
+
+  if (this->_nbTimers == 0) {
+    this->_currentTick = std::max(this->_currentTick, targetTick);
+    return;
+  }
+  while (this->_currentTick < targetTick) {
+    this->_currentTick++;
+    if (this->_currentTick % TIMER_SLOTS == 0)
+      this->_cascade();
+
+    int &head = this->_slotHead[this->_currentTick % TIMER_SLOTS];
+    while (head != -1) {
+      int fd = head;
+      this->_unlink(fd);
+      this->_nbTimers--;
+      expiredVector.push_back(fd);
+    }
+  }
+}
+
+/**
+ * @brief Computes how long the event loop can wait for events before the next
+ * timer expires.
+ *
+ * Only the slots within `maxTimeout` are looked at.
+ * @param now Current time (ms, monotonic clock).
+ * @param maxTimeout Maximum wait (ms), returned when no timer is due before.
+ * @return int the wait in ms (0 to maxTimeout).
+ */
+int TimerWheel::getTimeout(long now, int maxTimeout) const {
+  if (this->_nbTimers == 0)
+    return maxTimeout;
+
+  long nbTicks = std::min(static_cast<long>(maxTimeout / TIMER_TICK + 1),
+                          static_cast<long>(TIMER_SLOTS - 1));
+  for (long i = 1; i <= nbTicks; i++) {
+    long tick = this->_currentTick + i;
+    bool isDue = (this->_slotHead[tick % TIMER_SLOTS] != -1);
+
+    // a timer of the second wheel may be cascaded into this tick
+    if (tick % TIMER_SLOTS == 0)
+      isDue = isDue || this->_slotHead[TIMER_SLOTS +
+                                       (tick / TIMER_SLOTS) % TIMER_SLOTS] != -1;
+    if (isDue)
+      return static_cast<int>(
+          std::max(0L, std::min(tick * TIMER_TICK - now,
+                                static_cast<long>(maxTimeout))));
+  }
+  return maxTimeout;
+}
+
+/**
+ * @brief Links an (unlinked) timer in the slot of its deadline.
+ *
+ * The timers due within one turn go in the first wheel. The others go in the
+ * slot of their turn in the second wheel, or in its last slot if they are due
+ * even later (they are put back in the right place when cascaded).
+ * @param firstTick The first tick whose slot is still to be processed: a
+ * timer already due goes there.
+ */
+void TimerWheel::_insert(int fd, long firstTick) {
+  wheelTimer_t &timer = this->_timerVector[fd];
+  long tick = (timer.deadline + TIMER_TICK - 1) / TIMER_TICK;
+
+  if (tick < firstTick)
+    tick = firstTick;
+
+  if (tick - this->_currentTick < TIMER_SLOTS)
+    timer.slot = tick % TIMER_SLOTS;
+  else {
+    long turn = tick / TIMER_SLOTS;
+    long currentTurn = this->_currentTick / TIMER_SLOTS;
+
+    if (turn - currentTurn >= TIMER_SLOTS)
+      turn = currentTurn + TIMER_SLOTS - 1;
+    timer.slot = TIMER_SLOTS + turn % TIMER_SLOTS;
+  }
+
+  timer.prev = -1;
+  timer.next = this->_slotHead[timer.slot];
+  if (timer.next != -1)
+    this->_timerVector[timer.next].prev = fd;
+  this->_slotHead[timer.slot] = fd;
+}
+
+/**
+ * @brief Removes a timer from its slot (the timer is then unarmed).
+ */
+void TimerWheel::_unlink(int fd) {
+  wheelTimer_t &timer = this->_timerVector[fd];
+
+  if (timer.prev != -1)
+    this->_timerVector[timer.prev].next = timer.next;
+  else
+    this->_slotHead[timer.slot] = timer.next;
+  if (timer.next != -1)
+    this->_timerVector[timer.next].prev = timer.prev;
+  timer.slot = -1;
+  timer.prev = -1;
+  timer.next = -1;
+}
+
+/**
+ * @brief A new turn of the first wheel begins: the timers of this turn are
+ * moved from the second wheel to the first one (the slot of the current tick
+ * included: it is processed right after).
+ */
+void TimerWheel::_cascade() {
+  int &head =
+      this->_slotHead[TIMER_SLOTS + (this->_currentTick / TIMER_SLOTS) % TIMER_SLOTS];
+
+  while (head != -1) {
+    int fd = head;
+    this->_unlink(fd);
+    this->_insert(fd, this->_currentTick);
+  }
+}
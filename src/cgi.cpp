@@ -15,7 +15,7 @@
 #include <utils.hpp>
 
 CGI::CGI(const std::string &scriptPath, const std::string &method, 
-         const std::string &queryString, const std::string &requestBody,
+         const std::string &queryString, const RequestBody &requestBody,
          const std::string &pathInfo, const std::string &scriptFileName)
     : _scriptPath(scriptPath), _method(method), _queryString(queryString), 
       _requestBody(requestBody), _pathInfo(pathInfo), _scriptFileName(scriptFileName) {}
@@ -57,6 +57,14 @@ std::string CGI::execute()
 {
     setEnvironment();
 
+    // A body in a temporary file is the script's standard input, read from its beginning
+    bool bodyInFile = (_method == "POST" && _requestBody.isInFile());
+    if (bodyInFile && lseek(_requestBody.getFd(), 0, SEEK_SET) == -1)
+    {
+        perror("lseek failed");
+        return "Error: Body file unavailable";
+    }
+
     // Create pipes for communication
     int pipeIn[2], pipeOut[2];
     if (pipe(pipeIn) == -1 || pipe(pipeOut) == -1)
@@ -65,6 +73,21 @@ std::string CGI::execute()
         return "Error: Pipe creation failed";
     }
 
+    // Prepare environment variables and arguments before fork(): in worker mode the process has
+    // several threads, and the child must not allocate memory before execve()
+    std::vector<char*> envVars(_environmentVars.size() + 1, NULL);
+    for (size_t i = 0; i < _environmentVars.size(); ++i)
+    {
+        envVars[i] = const_cast<char*>(_environmentVars[i].c_str());
+    }
+
+    // Use _scriptPath as the interpreter and _scriptFileName as the script to execute
+    char *argv[] = {
+        const_cast<char*>(_scriptPath.c_str()),     // Interpreter (e.g., Python)
+        const_cast<char*>(_scriptFileName.c_str()), // Script (e.g., age_calculator.py)
+        NULL                                        // Null-terminate the argument list
+    };
+
     pid_t pid = fork();
     if (pid == -1)
     {
@@ -74,42 +97,28 @@ std::string CGI::execute()
 
     if (pid == 0) { // Child process
         // Set up pipes
-        dup2(pipeIn[0], STDIN_FILENO);
+        dup2(bodyInFile ? _requestBody.getFd() : pipeIn[0], STDIN_FILENO);
         dup2(pipeOut[1], STDOUT_FILENO);
 
         // Close unused pipe ends
         close(pipeIn[1]);
         close(pipeOut[0]);
 
-        // Prepare environment variables
-        std::vector<char*> envVars(_environmentVars.size() + 1, NULL);
-        for (size_t i = 0; i < _environmentVars.size(); ++i)
-        {
-            envVars[i] = const_cast<char*>(_environmentVars[i].c_str());
-        }
-       
-        // Use _scriptPath as the interpreter and _scriptFileName as the script to execute
-        char *argv[] = {
-            const_cast<char*>(_scriptPath.c_str()),     // Interpreter (e.g., Python)
-            const_cast<char*>(_scriptFileName.c_str()), // Script (e.g., age_calculator.py)
-            NULL                                        // Null-terminate the argument list
-        };
-
         // Execute the interpreter with the script file as an argument
         execve(_scriptPath.c_str(), argv, envVars.data());
 
         // If execve fails, log the error and exit
         perror("execve failed");
-        exit(1);
+        _exit(1);
     }
     else
     { // Parent process
         close(pipeIn[0]);
         close(pipeOut[1]);
 
-        if (_method == "POST" && !_requestBody.empty())
+        if (_method == "POST" && !bodyInFile && _requestBody.size() > 0)
         {
-           if (write(pipeIn[1], _requestBody.c_str(), _requestBody.size()) == -1) {
+           if (write(pipeIn[1], _requestBody.data(), _requestBody.size()) == -1) {
                 perror("Failed to write to pipe");
             }
         }
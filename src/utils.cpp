@@ -1,7 +1,12 @@
 #include "utils.hpp"
 #include "defines.hpp"
 
-bool g_shutdown = false;
+volatile sig_atomic_t g_shutdown = false;
+volatile sig_atomic_t g_drain = false;
+volatile sig_atomic_t g_wakeupFds[MAX_WORKERS + 1]; // set to -1 by the Service
+volatile sig_atomic_t g_signal = 0;
+volatile sig_atomic_t g_reload = 0;
+volatile sig_atomic_t g_upgrade = 0;
 
 /* === Time === */
 std::string getTime() {
@@ -9,11 +14,34 @@ std::string getTime() {
   struct tm tstruct;
   char buf[9];
 
-  tstruct = *localtime(&now);
+  localtime_r(&now, &tstruct); // localtime() is not thread-safe
   strftime(buf, sizeof(buf), "%H:%M:%S", &tstruct);
   return (buf);
 }
 
+/**
+ * @brief Monotonic clock (not changed by the system's date), for the timeouts.
+ * @return long the time in ms.
+ */
+long getMonotonicTime() {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec * 1000L + now.tv_nsec / 1000000L);
+}
+
+/**
+ * @brief CPU time (user and system) used by the calling thread, for the event
+ * loop statistics.
+ * @return long the time in ms.
+ */
+long getThreadCpuTime() {
+  struct timespec used;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &used);
+  return (used.tv_sec * 1000L + used.tv_nsec / 1000000L);
+}
+
 /* === Logs === */
 void printInfo(std::string const &s, std::string const &color) {
   if (s == START_MSG)
@@ -27,11 +55,70 @@ void printInfo(std::string const &s, std::string const &color) {
 
 /* === Signal === */
 
+/**
+ * @brief SIGINT stops the server at once. SIGTERM and SIGQUIT start a
+ * graceful shutdown (see Service::_startDrain()), a second one stops the
+ * server at once. SIGHUP reloads the configuration (see Service_6_reload.cpp).
+ * SIGUSR2 starts the new binary (see Service::_startUpgrade()).
+ *
+ * The handler only sets flags and wakes the event loops up: it can interrupt
+ * any code (malloc(), iostream...), so it calls nothing which isn't
+ * async-signal-safe. The loops print the messages when they see the flags.
+ */
 void signalHandler(int signum) {
-  if (signum == SIGINT) {
+  if (signum == SIGUSR2) {
+    g_upgrade = g_upgrade + 1;
+    wakeUpEventLoops();
+    return;
+  }
+  if (signum == SIGHUP) {
+    g_reload = g_reload + 1;
+    wakeUpEventLoops();
+    return;
+  }
+  if (signum != SIGINT && signum != SIGTERM && signum != SIGQUIT)
+    return;
+  g_signal = signum;
+  if (signum == SIGINT || g_drain)
     g_shutdown = true;
-    printInfo(SHUTDOWN_MSG, GREEN);
+  else
+    g_drain = true;
+  wakeUpEventLoops(); // once the flags are set: the workers check them at once
+}
+
+/**
+ * @brief Wakes the worker threads up (they don't get the signals), so they
+ * see a new `g_shutdown` or `g_drain` (or a reloaded configuration) at once,
+ * and their main thread, which reloads the configuration. Async-signal-safe.
+ *
+ * Each worker has its own pipe: it empties it when woken up, without taking
+ * the wake-up of the others.
+ */
+void wakeUpEventLoops() {
+  int savedErrno = errno; // the interrupted code may check it
+
+  for (int i = 0; i <= MASTER_WAKEUP; i++) {
+    if (g_wakeupFds[i] >= 0) {
+      ssize_t written = write(g_wakeupFds[i], "", 1);
+      (void)written;
+    }
   }
+  errno = savedErrno;
+}
+
+/**
+ * @brief Installs a signal handler without SA_RESTART, so a blocking call
+ * (poll(), waitpid()...) returns EINTR and the caller sees `g_shutdown` (or
+ * `g_drain`).
+ */
+void setSignalHandler(int signum, void (*handler)(int)) {
+  struct sigaction action;
+
+  std::memset(&action, 0, sizeof(action));
+  action.sa_handler = handler;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = 0;
+  sigaction(signum, &action, NULL);
 }
 
 /* === PrintInfo === */
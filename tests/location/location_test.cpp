@@ -0,0 +1,138 @@
+/**
+ * @file location_test.cpp
+ * @brief Checks the location trie of a server against a linear scan of its
+ * locations.
+ *
+ * Servers are built from random location blocks whose names share segments
+ * and beginnings of segments ("/a", "/ab", "/a/", "/a/b"...), then random
+ * paths are looked up in both modes of Server::findLocation():
+ * - wholeSegments: the longest location that is the path or its beginning up
+ *   to a '/' (getLocationConfig()),
+ * - not wholeSegments: the longest location that is any beginning of the path
+ *   (the routing of a request).
+ * Each location has its name as root, to tell which one was found. The
+ * lookups also go through a copy of the server, as the servers live in
+ * vectors.
+ *
+ * Usage: location_test
+ */
+
+#include "Server.hpp"
+
+static size_t g_nbChecks = 0;
+static size_t g_nbErrors = 0;
+
+static void check(bool isOk, std::string const &what,
+                  std::string const &value) {
+  g_nbChecks++;
+  if (isOk)
+    return;
+  if (g_nbErrors++ < 10)
+    std::cerr << what << " (" << value << ")" << std::endl;
+}
+
+/**
+ * @brief The reference: the longest location name that begins the path (and
+ * ends at a '/' of the path or at its end if `wholeSegments`).
+ * @return the root of the location, "none" if no location matches.
+ */
+static std::string scanLocations(Server const &server, std::string const &path,
+                                 bool wholeSegments) {
+  const std::map<std::string, location_t> &locations = server.getLocations();
+  std::string matchedRoot = "none";
+  size_t matchedLength = 0;
+
+  for (std::map<std::string, location_t>::const_iterator it =
+           locations.begin();
+       it != locations.end(); ++it) {
+    const std::string &name = it->first;
+
+    if (name.empty() || name[0] != '/' || path.compare(0, name.size(), name))
+      continue;
+    if (wholeSegments && path.size() > name.size() && path[name.size()] != '/')
+      continue;
+    if (name.size() > matchedLength) {
+      matchedRoot = it->second.root;
+      matchedLength = name.size();
+    }
+  }
+  return matchedRoot;
+}
+
+/** @brief The root of the location found by the trie, "none" if none. */
+static std::string findRoot(Server const &server, std::string const &path,
+                            bool wholeSegments) {
+  const location_t *location = server.findLocation(path, wholeSegments);
+
+  return location ? location->root : "none";
+}
+
+/** @brief A random name or path made of a few short segments. */
+static std::string randomPath(size_t maxSegments) {
+  static const char *segments[] = {"", "a", "ab", "abc", "b", "ba", "a.b"};
+  size_t nbSegments = std::rand() % (maxSegments + 1);
+  std::string path;
+
+  for (size_t i = 0; i < nbSegments; i++)
+    path += std::string("/") + segments[std::rand() % 7];
+  if (path.empty() || std::rand() % 4 == 0)
+    path += "/";
+  return path;
+}
+
+/** @brief A server with `nbLocations` random location blocks. */
+static Server makeServer(size_t nbLocations) {
+  std::vector<Server> serversVector;
+  std::map<std::string, std::string> serverConfigMap;
+  std::vector<std::map<std::string, std::string> > locationMapVector;
+
+  serverConfigMap[SERVER_N] = "localhost";
+  serverConfigMap[HOST] = "127.0.0.1";
+  serverConfigMap[LISTEN] = "8080";
+  serverConfigMap[MAX_SIZE] = "1000000";
+  for (size_t i = 0; i < nbLocations; i++) {
+    std::map<std::string, std::string> locationMap;
+    std::string name = randomPath(3);
+
+    if (std::rand() % 10 == 0)
+      name = name.substr(1); // not a beginning of a path: never found
+    locationMap["location"] = name;
+    locationMap["root"] = name;
+    locationMapVector.push_back(locationMap);
+  }
+  // the constructor prints the server it built
+  std::streambuf *coutBuf = std::cout.rdbuf(NULL);
+  Server server(serversVector, serverConfigMap, locationMapVector);
+  std::cout.rdbuf(coutBuf);
+  return server;
+}
+
+/**
+ * @brief Random location sets, including the empty one and the ones without
+ * "/", looked up with random paths in both modes.
+ */
+static void testRandom() {
+  std::srand(42);
+  for (int n = 0; n < 2000; n++) {
+    Server original = makeServer(std::rand() % 20);
+    std::vector<Server> serversVector(1, original);
+    const Server &server = serversVector[0];
+
+    for (int i = 0; i < 50; i++) {
+      std::string path = randomPath(5);
+
+      check(findRoot(server, path, true) == scanLocations(server, path, true),
+            "whole segments: path", path);
+      check(findRoot(server, path, false) ==
+                scanLocations(server, path, false),
+            "any beginning: path", path);
+    }
+  }
+}
+
+int main() {
+  testRandom();
+  std::cout << "location trie: " << g_nbChecks << " checks, " << g_nbErrors
+            << " errors" << std::endl;
+  return (g_nbErrors == 0) ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+/**
+ * @file scanner_bench.cpp
+ * @brief Measures the throughput of each implementation of the scans on a
+ * corpus of real-world request headers.
+ *
+ * Each run does the scans of the request parser: the end of each line, the
+ * header name (token characters, then the colon) and the validation of the
+ * value. `std::string::find` is measured too, for the line ends.
+ *
+ * Usage: scanner_bench [headers_corpus.txt] [repetitions]
+ */
+
+#include "Scanner.hpp"
+
+static std::string readCorpus(const char *path) {
+  std::ifstream file(path);
+  std::string corpus;
+  std::string line;
+
+  while (std::getline(file, line))
+    corpus += line + "\r\n";
+  return corpus;
+}
+
+static double now() {
+  timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief The scans of the parser over the whole corpus.
+ * @return size_t a checksum of the results (so nothing is optimized away).
+ */
+static size_t parseHeaders(scanner_t const &scanner, std::string const &corpus) {
+  const char *data = corpus.data();
+  size_t size = corpus.size();
+  size_t checksum = 0;
+  size_t pos = 0;
+
+  while (pos < size) {
+    size_t lineEnd = pos + scanner.findByte(data + pos, size - pos, '\n');
+    size_t name = scanner.skipToken(data + pos, lineEnd - pos);
+
+    checksum += name;
+    if (data[pos + name] == ':')
+      checksum += scanner.skipFieldValue(data + pos + name + 1,
+                                         lineEnd - pos - name - 2);
+    pos = lineEnd + 1;
+  }
+  return checksum;
+}
+
+static size_t findLines(std::string const &corpus) {
+  size_t checksum = 0;
+  size_t pos = 0;
+
+  while ((pos = corpus.find('\n', pos)) != std::string::npos)
+    checksum += pos++;
+  return checksum;
+}
+
+static size_t findLines(scanner_t const &scanner, std::string const &corpus) {
+  size_t checksum = 0;
+  size_t pos = 0;
+
+  while (pos < corpus.size()) {
+    pos += scanner.findByte(corpus.data() + pos, corpus.size() - pos, '\n');
+    checksum += pos++;
+  }
+  return checksum - (pos > corpus.size() ? pos - 1 : 0);
+}
+
+static void report(const char *name, const char *what, double seconds,
+                   size_t bytes) {
+  std::cout << std::left << std::setw(8) << name << std::setw(14) << what
+            << std::right << std::fixed << std::setprecision(0)
+            << std::setw(8) << bytes / seconds / (1024 * 1024) << " MB/s"
+            << std::endl;
+}
+
+int main(int argc, char **argv) {
+  std::string corpus = readCorpus(argc > 1 ? argv[1]
+                                           : "tests/scanner/headers_corpus.txt");
+  int repetitions = (argc > 2) ? std::atoi(argv[2]) : 20000;
+  std::vector<const scanner_t *> scanners;
+  size_t checksum = 0;
+
+  if (corpus.empty()) {
+    std::cerr << "empty or missing corpus" << std::endl;
+    return 1;
+  }
+  scanners.push_back(&getScalarScanner());
+  if (getSse2Scanner())
+    scanners.push_back(getSse2Scanner());
+  if (getAvx2Scanner())
+    scanners.push_back(getAvx2Scanner());
+
+  size_t bytes = corpus.size() * repetitions;
+  std::cout << corpus.size() << " bytes of headers x " << repetitions
+            << std::endl;
+
+  double start = now();
+  for (int r = 0; r < repetitions; r++)
+    checksum += findLines(corpus);
+  report("string", "line ends", now() - start, bytes);
+
+  for (size_t i = 0; i < scanners.size(); i++) {
+    start = now();
+    for (int r = 0; r < repetitions; r++)
+      checksum += findLines(*scanners[i], corpus);
+    report(scanners[i]->name, "line ends", now() - start, bytes);
+
+    start = now();
+    for (int r = 0; r < repetitions; r++)
+      checksum += parseHeaders(*scanners[i], corpus);
+    report(scanners[i]->name, "header lines", now() - start, bytes);
+  }
+  std::cout << "(checksum " << checksum << ")" << std::endl;
+  return 0;
+}
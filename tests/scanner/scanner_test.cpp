@@ -0,0 +1,134 @@
+/**
+ * @file scanner_test.cpp
+ * @brief Checks that the vectorized scans (SSE2, AVX2) give the same results
+ * as the scalar ones.
+ *
+ * The scans are compared on a corpus of real-world request headers (from
+ * every position of every line), then on every byte value at every position
+ * of a vector, and on random data of random lengths and alignments.
+ *
+ * Usage: scanner_test [headers_corpus.txt]
+ */
+
+#include "Scanner.hpp"
+
+static size_t g_nbChecks = 0;
+static size_t g_nbErrors = 0;
+
+/**
+ * @brief Reads the corpus, with CRLF line ends (as received).
+ */
+static std::string readCorpus(const char *path) {
+  std::ifstream file(path);
+  std::string corpus;
+  std::string line;
+
+  while (std::getline(file, line))
+    corpus += line + "\r\n";
+  return corpus;
+}
+
+static void check(scanner_t const &scanner, const char *scan, size_t expected,
+                  size_t result, std::string const &data) {
+  g_nbChecks++;
+  if (result == expected)
+    return;
+  if (g_nbErrors++ < 10)
+    std::cerr << scanner.name << "." << scan << ": " << result
+              << " instead of " << expected << " on \"" << data << "\""
+              << std::endl;
+}
+
+/**
+ * @brief Runs every scan of an implementation on data and compares them to
+ * the scalar scans.
+ */
+static void compare(scanner_t const &scanner, const char *data, size_t size) {
+  scanner_t const &scalar = getScalarScanner();
+  std::string const copy(data, size);
+  const char delimiters[] = {'\n', '\r', ':', ' ', ';', ',', '\0', '\xff'};
+
+  for (size_t i = 0; i < sizeof(delimiters); i++)
+    check(scanner, "findByte", scalar.findByte(data, size, delimiters[i]),
+          scanner.findByte(data, size, delimiters[i]), copy);
+  check(scanner, "skipToken", scalar.skipToken(data, size),
+        scanner.skipToken(data, size), copy);
+  check(scanner, "skipFieldValue", scalar.skipFieldValue(data, size),
+        scanner.skipFieldValue(data, size), copy);
+}
+
+/**
+ * @brief The corpus, scanned from every position, to the end of the line and
+ * to the end of the corpus.
+ */
+static void testCorpus(scanner_t const &scanner, std::string const &corpus) {
+  for (size_t pos = 0; pos < corpus.size(); pos++) {
+    size_t lineEnd = corpus.find('\n', pos);
+
+    compare(scanner, corpus.data() + pos, lineEnd - pos);
+    compare(scanner, corpus.data() + pos, corpus.size() - pos);
+  }
+}
+
+/**
+ * @brief Every byte value, at every position of 64 bytes of token
+ * characters, then of field value characters.
+ */
+static void testEveryByte(scanner_t const &scanner) {
+  const char fills[] = {'a', ' '};
+
+  for (size_t f = 0; f < sizeof(fills); f++) {
+    for (int c = 0; c < 256; c++) {
+      for (size_t pos = 0; pos < 64; pos++) {
+        std::string data(64, fills[f]);
+
+        data[pos] = static_cast<char>(c);
+        compare(scanner, data.data(), data.size());
+      }
+    }
+  }
+}
+
+/**
+ * @brief Random data (mostly printable, with some delimiters and control
+ * characters) of random lengths, at random alignments.
+ */
+static void testRandom(scanner_t const &scanner) {
+  std::srand(42);
+  for (int n = 0; n < 20000; n++) {
+    std::string data(std::rand() % 200 + 32, 'x');
+    size_t offset = std::rand() % 32;
+
+    for (size_t i = 0; i < data.size(); i++) {
+      int r = std::rand() % 100;
+
+      data[i] = (r < 90) ? static_cast<char>(0x20 + std::rand() % 0x5f)
+                         : static_cast<char>(std::rand() % 256);
+    }
+    compare(scanner, data.data() + offset, data.size() - offset);
+  }
+}
+
+int main(int argc, char **argv) {
+  std::string corpus = readCorpus(argc > 1 ? argv[1]
+                                           : "tests/scanner/headers_corpus.txt");
+  std::vector<const scanner_t *> scanners;
+
+  if (corpus.empty()) {
+    std::cerr << "empty or missing corpus" << std::endl;
+    return 1;
+  }
+  if (getSse2Scanner())
+    scanners.push_back(getSse2Scanner());
+  if (getAvx2Scanner())
+    scanners.push_back(getAvx2Scanner());
+  for (size_t i = 0; i < scanners.size(); i++) {
+    testCorpus(*scanners[i], corpus);
+    testEveryByte(*scanners[i]);
+    testRandom(*scanners[i]);
+    std::cout << scanners[i]->name << ": checked against scalar" << std::endl;
+  }
+  std::cout << "selected: " << getScanner().name << ", " << g_nbChecks
+            << " checks, " << g_nbErrors << " errors" << std::endl;
+  return (g_nbErrors == 0) ? 0 : 1;
+}
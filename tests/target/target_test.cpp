@@ -0,0 +1,141 @@
+/**
+ * @file target_test.cpp
+ * @brief Checks the parser of the request target on known targets.
+ *
+ * The valid targets check the percent-decoding of the path, the removal of
+ * its "." and ".." segments, and the split of the query (which keeps its
+ * '?' and encoding, and ends at a '#'). The rejected targets check each
+ * reason: invalid characters, invalid encodings and ".." above the root.
+ * The same target is reused from one parse to the next, as by a keep-alive
+ * connection.
+ *
+ * Usage: target_test
+ */
+
+#include "RequestTarget.hpp"
+
+static size_t g_nbChecks = 0;
+static size_t g_nbErrors = 0;
+
+static void check(bool isOk, std::string const &what,
+                  std::string const &value) {
+  g_nbChecks++;
+  if (isOk)
+    return;
+  if (g_nbErrors++ < 10)
+    std::cerr << what << " (" << value << ")" << std::endl;
+}
+
+/**
+ * @struct validCase_s
+ * @brief A valid target and its expected path and query.
+ */
+typedef struct validCase_s {
+  const char *raw;
+  const char *path;
+  const char *query;
+} validCase_t;
+
+/**
+ * @struct invalidCase_s
+ * @brief A rejected target and the reason expected.
+ */
+typedef struct invalidCase_s {
+  const char *raw;
+  targetStatus_e status;
+} invalidCase_t;
+
+static const validCase_t g_validCases[] = {
+    {"/", "/", ""},
+    {"/index.html", "/index.html", ""},
+    // percent-decoding
+    {"/a%20b", "/a b", ""},
+    {"/%41%62c", "/Abc", ""},
+    {"/%c3%a9t%C3%A9", "/\xc3\xa9t\xc3\xa9", ""},
+    {"/a%2fb", "/a/b", ""},
+    {"/%25", "/%", ""},
+    // dot segments and empty segments
+    {"/a/./b/../c", "/a/c", ""},
+    {"/a/b/..", "/a/", ""},
+    {"/a/.", "/a/", ""},
+    {"/./a", "/a", ""},
+    {"/a/%2e%2e/b", "/b", ""},
+    {"/a/%2E/b", "/a/b", ""},
+    {"/a//b///c", "/a/b/c", ""},
+    {"/a/.../b", "/a/.../b", ""},
+    {"/a/..b/.c", "/a/..b/.c", ""},
+    // query
+    {"/x?", "/x", ""},
+    {"/x?a=1&b=2", "/x", "a=1&b=2"},
+    {"/x?a=1?b=2", "/x", "a=1?b=2"},
+    {"/x?a=%3F%23", "/x", "a=%3F%23"},
+    {"/x?a=/../b", "/x", "a=/../b"},
+    {"/x?id[]=1", "/x", "id[]=1"},
+    // fragment
+    {"/x?a=1#frag?b=2", "/x", "a=1"},
+    {"/x#frag?b=2", "/x", ""},
+    {"/a/..#frag", "/", ""},
+};
+
+static const invalidCase_t g_invalidCases[] = {
+    {"", TARGET_INVALID_CHARACTER},
+    {"index.html", TARGET_INVALID_CHARACTER},
+    {"http://localhost/", TARGET_INVALID_CHARACTER},
+    {"/a b", TARGET_INVALID_CHARACTER},
+    {"/a\"b", TARGET_INVALID_CHARACTER},
+    {"/a\\b", TARGET_INVALID_CHARACTER},
+    {"/[a]", TARGET_INVALID_CHARACTER},
+    {"/\xc3\xa9", TARGET_INVALID_CHARACTER},
+    {"/a\x7f", TARGET_INVALID_CHARACTER},
+    {"/x?a b", TARGET_INVALID_CHARACTER},
+    {"/x?a=\"b\"", TARGET_INVALID_CHARACTER},
+    {"/%", TARGET_INVALID_ENCODING},
+    {"/%4", TARGET_INVALID_ENCODING},
+    {"/%4g", TARGET_INVALID_ENCODING},
+    {"/%zz", TARGET_INVALID_ENCODING},
+    {"/%00", TARGET_INVALID_ENCODING},
+    {"/a%0d%0a", TARGET_INVALID_ENCODING},
+    {"/%7F", TARGET_INVALID_ENCODING},
+    {"/x?a=%", TARGET_INVALID_ENCODING},
+    {"/x?a=%2", TARGET_INVALID_ENCODING},
+    {"/..", TARGET_OUTSIDE_ROOT},
+    {"/../a", TARGET_OUTSIDE_ROOT},
+    {"/a/../..", TARGET_OUTSIDE_ROOT},
+    {"/a/./../../b", TARGET_OUTSIDE_ROOT},
+    {"/%2e%2e/etc/passwd", TARGET_OUTSIDE_ROOT},
+    {"/a/..%2f..%2f", TARGET_OUTSIDE_ROOT},
+};
+
+/**
+ * @brief The valid targets give their path and query, the rejected ones
+ * their reason.
+ */
+static void testCases() {
+  requestTarget_t target;
+
+  for (size_t i = 0; i < sizeof(g_validCases) / sizeof(g_validCases[0]);
+       i++) {
+    const validCase_t &validCase = g_validCases[i];
+
+    check(parseRequestTarget(validCase.raw, target) == TARGET_OK,
+          "rejected: target", validCase.raw);
+    check(target.path == validCase.path, "path of target " +
+          std::string(validCase.raw), target.path);
+    check(target.query == validCase.query, "query of target " +
+          std::string(validCase.raw), target.query);
+  }
+  for (size_t i = 0; i < sizeof(g_invalidCases) / sizeof(g_invalidCases[0]);
+       i++) {
+    const invalidCase_t &invalidCase = g_invalidCases[i];
+
+    check(parseRequestTarget(invalidCase.raw, target) == invalidCase.status,
+          "wrong status: target", invalidCase.raw);
+  }
+}
+
+int main() {
+  testCases();
+  std::cout << "request target: " << g_nbChecks << " checks, " << g_nbErrors
+            << " errors" << std::endl;
+  return (g_nbErrors == 0) ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file timer_test.cpp
+ * @brief Checks the timer wheel against a plain map of deadlines.
+ *
+ * The timers are armed, moved (as after each request of a keep-alive
+ * connection) and cancelled, then the wheel is advanced: each timer must
+ * expire once, not before its deadline and within a tick after it, and the
+ * number of armed timers must follow, back to 0 once they are all gone.
+ *
+ * Usage: timer_test
+ */
+
+#include "TimerWheel.hpp"
+
+static size_t g_nbChecks = 0;
+static size_t g_nbErrors = 0;
+
+static void check(bool isOk, std::string const &what, long value) {
+  g_nbChecks++;
+  if (isOk)
+    return;
+  if (g_nbErrors++ < 10)
+    std::cerr << what << " (" << value << ")" << std::endl;
+}
+
+/**
+ * @brief Advances the wheel to `now` and checks the expired timers against
+ * the reference, then the number of timers still armed.
+ */
+static void advance(TimerWheel &wheel, std::map<int, long> &deadlines,
+                    long now) {
+  std::vector<int> expiredVector;
+
+  wheel.advance(now, expiredVector);
+  for (size_t i = 0; i < expiredVector.size(); i++) {
+    std::map<int, long>::iterator it = deadlines.find(expiredVector[i]);
+
+    check(it != deadlines.end(), "expired twice or never armed: fd",
+          expiredVector[i]);
+    if (it == deadlines.end())
+      continue;
+    check(it->second <= now, "expired early: fd", it->first);
+    deadlines.erase(it);
+  }
+  for (std::map<int, long>::iterator it = deadlines.begin();
+       it != deadlines.end(); ++it)
+    check(it->second + TIMER_TICK > now, "expired late: fd", it->first);
+  check(wheel.getNbTimers() == deadlines.size(), "timers counted",
+        wheel.getNbTimers());
+}
+
+/**
+ * @brief Schedules, moves and cancels timers: the count goes back to 0, and
+ * the wheel waits the whole timeout again.
+ */
+static void testCount() {
+  long now = 1000000;
+  TimerWheel wheel(now);
+  std::map<int, long> deadlines;
+
+  for (int fd = 0; fd < 100; fd++) {
+    wheel.schedule(fd, now + 5000);
+    wheel.schedule(fd, now + 5000); // same deadline
+    wheel.schedule(fd, now + 1000 + fd * 10); // moved
+    wheel.schedule(fd, now + 2000 + fd * 10); // moved again
+    deadlines[fd] = now + 2000 + fd * 10;
+  }
+  check(wheel.getNbTimers() == 100, "timers after schedule",
+        wheel.getNbTimers());
+  for (int fd = 0; fd < 100; fd += 2) {
+    wheel.cancel(fd);
+    wheel.cancel(fd); // not armed anymore
+    deadlines.erase(fd);
+  }
+  check(wheel.getNbTimers() == 50, "timers after cancel", wheel.getNbTimers());
+  for (long t = now; t <= now + 4000; t += 50)
+    advance(wheel, deadlines, t);
+  check(deadlines.empty(), "timers never expired", deadlines.size());
+  check(wheel.getNbTimers() == 0, "timers at the end", wheel.getNbTimers());
+  check(wheel.getTimeout(now + 4000, 200) == 200, "timeout with no timer",
+        wheel.getTimeout(now + 4000, 200));
+}
+
+/**
+ * @brief Random schedules, moves (including beyond the first wheel) and
+ * cancels, while the clock moves by random steps.
+ */
+static void testRandom() {
+  long now = 42;
+  TimerWheel wheel(now);
+  std::map<int, long> deadlines;
+
+  std::srand(42);
+  for (int n = 0; n < 200000; n++) {
+    int fd = std::rand() % 500;
+    int r = std::rand() % 100;
+
+    if (r < 60) {
+      long deadline = now + std::rand() % (3 * TIMER_TICK * TIMER_SLOTS);
+
+      wheel.schedule(fd, deadline);
+      deadlines[fd] = deadline;
+    } else if (r < 75) {
+      wheel.cancel(fd);
+      deadlines.erase(fd);
+    } else {
+      now += std::rand() % (2 * TIMER_TICK);
+      advance(wheel, deadlines, now);
+    }
+  }
+  for (int fd = 0; fd < 500; fd++)
+    wheel.cancel(fd);
+  check(wheel.getNbTimers() == 0, "timers after cancelling all",
+        wheel.getNbTimers());
+}
+
+int main() {
+  testCount();
+  testRandom();
+  std::cout << "timer wheel: " << g_nbChecks << " checks, " << g_nbErrors
+            << " errors" << std::endl;
+  return (g_nbErrors == 0) ? 0 : 1;
+}